@@ -468,26 +468,10 @@ void step4_v4_write_function(auto &result_changed) {
               return false;
             }
 
-            if (!picklejar::deep_copy_vector_to_stream<1>(
-                    object.new_map, _ofs_output_file,
-                    [](auto &map_elem) {
-                      return picklejar::sizeof_unversioned(map_elem.first) +
-                             picklejar::sizeof_unversioned(map_elem.second);
-                    },
-                    [](auto &_map_ofs_output_file, auto &map_elem,
-                       size_t map_element_size) {
-                      // write the string into the file
-                      if (!picklejar::write_string_to_stream(
-                              map_elem.first, _map_ofs_output_file)) {
-                        return false;
-                      }
-                      // next we write the map value
-                      if (!picklejar::write_object_to_stream(
-                              map_elem.second, _map_ofs_output_file)) {
-                        return false;
-                      }
-                      return true;
-                    })) {
+            // write_map_to_stream writes each key with write_string and each
+            // value with write_object_to_stream, in sorted key order
+            if (!picklejar::write_map_to_stream<1>(object.new_map,
+                                                   _ofs_output_file)) {
               return false;
             }
             // and then we write the 'new_important_pair_vector' into the file
@@ -524,29 +508,12 @@ auto step4_v4_read_function(Container &result_changed_v4)
               return false;
 
             // START CHANGES we read a map, otherwise this is just a copy of the
-            // step2_v2_read_function
+            // step2_v2_read_function. read_map_from_buffer reads each map entry
+            // straight out of byte_vector_with_counter and inserts it at the
+            // end of the map since the keys were written in order
             New_Map read_new_map{};
-            auto optional_new_map{picklejar::deep_read_vector_from_buffer<1>(
-                read_new_map, byte_vector_with_counter,
-                [](auto &map_result, picklejar::ByteVectorWithCounter
-                                         &_map_byte_vector_with_counter) {
-                  auto optional_map_key_size =
-                      _map_byte_vector_with_counter.read<size_t>();
-                  if (!optional_map_key_size) return false;
-                  std::string _map_key(
-                      _map_byte_vector_with_counter.current_iterator(),
-                      _map_byte_vector_with_counter.offset_iterator(
-                          optional_map_key_size.value()));
-                  if (!_map_byte_vector_with_counter.advance_counter(
-                          optional_map_key_size.value()))
-                    return false;
-
-                  auto optional_map_value =
-                      _map_byte_vector_with_counter.read<TrivialStructForMap>();
-                  if (!optional_map_value) return false;
-                  map_result[_map_key] = optional_map_value.value();
-                  return true;
-                })};
+            auto optional_new_map{picklejar::read_map_from_buffer<1>(
+                read_new_map, byte_vector_with_counter)};
             if (!optional_new_map) return false;
             // END CHANGES
 
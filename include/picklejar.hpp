@@ -1,18 +1,56 @@
 #ifndef PICKLEJAR_HPP  // This is the include guard macro
 #define PICKLEJAR_HPP 1
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <filesystem>
 #include <fstream>
+#include <future>
 #include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <numeric>
 #include <optional>
 #include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+// POSIX file descriptor backend, see POSIX FD BACKEND
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// SIMD kernels used to byte swap arrays when the portable encoding order is
+// different from the host order, see PORTABLE_ENCODING
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 // if you want to use this header file only and not have to include the
 // type_safe thirdparty library you can define DISABLE_TYPESAFE_OPTIONAL from
 // the command line or your header file or cmake.
@@ -393,17 +431,19 @@ struct ByteContainerOrViewWithCounter {
     return false;
   }
 
+  // after would_it_be_full_if_so_invalidate returns false the counter is
+  // known to be valid, so we dereference it directly instead of calling
+  // .value() which adds a second (throwing) check
   [[nodiscard]] auto advance_counter(size_t size_to_advance) -> bool {
     if (would_it_be_full_if_so_invalidate(size_to_advance)) return false;
-    byte_counter.value() += size_to_advance;
+    *byte_counter += size_to_advance;
     return true;
   }
 
   auto write(const char *object_ptr, size_t object_size) -> bool {
     if (would_it_be_full_if_so_invalidate(object_size)) return false;
-    std::memcpy(byte_data.data() + byte_counter.value(), object_ptr,
-                object_size);
-    byte_counter.value() += object_size;
+    std::memcpy(byte_data.data() + *byte_counter, object_ptr, object_size);
+    *byte_counter += object_size;
     return true;
   }
 
@@ -429,8 +469,8 @@ struct ByteContainerOrViewWithCounter {
     if (would_it_be_full_if_so_invalidate(size_to_read)) return false;
     // NOLINTNEXTLINE
     std::memcpy(reinterpret_cast<char *>(destination_to_copy_to),
-                current_data_pos(), size_to_read);
-    byte_counter.value() += size_to_read;
+                byte_data.data() + *byte_counter, size_to_read);
+    *byte_counter += size_to_read;
     return true;
   }
 
@@ -449,7 +489,9 @@ struct ByteContainerOrViewWithCounter {
         "Object needs to be trivially copiable, you can use the "
         "read_object_from_buffer API if you want to copy non-trivial types.");
     ManagedAlignedCopy copy{};
-    return *(read<Type>(copy)).get_pointer_to_copy();
+    // nothing was copied when the read fails, so there is no value to return
+    if (!read(copy.get_pointer_to_copy(), sizeof(Type))) return {};
+    return *copy.get_pointer_to_copy();
   }
   auto begin() { return std::begin(byte_data); }
   auto end() { return std::end(byte_data); }
@@ -514,6 +556,186 @@ struct ByteVectorWithCounter
 };
 // END BYTEVECTORWITHCOUNTER
 
+// START BYTECURSOR
+// ByteCursor is the unchecked counterpart of ByteContainerOrViewWithCounter,
+// it is just a raw pointer and an end pointer. It is meant for tight decode
+// loops: call .check(n) once for a whole batch or element frame and then use
+// the *_unchecked members which compile down to a memcpy. A failed check sets a
+// sticky error flag instead of resetting a std::optional counter, so you can
+// test .invalid() once at the end. Use .commit() to write the position (or the
+// error) back into the ByteVectorWithCounter/ByteSpanWithCounter it came from.
+// Ex: inside a 'vector_insert_element_lambda':
+//   picklejar::ByteCursor cursor{byte_vector_with_counter};
+//   if (!cursor.check(sizeof(int) + sizeof(double))) return false;
+//   auto id = cursor.read_unchecked<int>();
+//   auto value = cursor.read_unchecked<double>();
+//   return cursor.commit(byte_vector_with_counter);
+struct ByteCursor {
+  char *current{nullptr};
+  char *end_pos{nullptr};
+  bool error{false};
+
+  ByteCursor() = default;
+  ByteCursor(char *begin_pos, char *_end_pos)
+      : current{begin_pos}, end_pos{_end_pos} {}
+  template <class ContainerOrViewType>
+  explicit ByteCursor(ByteContainerOrViewWithCounter<ContainerOrViewType>
+                          &byte_vector_with_counter)
+      : error{byte_vector_with_counter.invalid()} {
+    if (!error) {
+      current = byte_vector_with_counter.byte_data.data() +
+                *byte_vector_with_counter.byte_counter;
+      end_pos = byte_vector_with_counter.byte_data.data() +
+                byte_vector_with_counter.size();
+    }
+  }
+
+  [[nodiscard]] auto size_remaining() const -> size_t {
+    return size_t(end_pos - current);
+  }
+  [[nodiscard]] auto invalid() const -> bool { return error; }
+  [[nodiscard]] auto data() const -> char * { return current; }
+
+  // the only bounds check, once it fails the cursor stays invalid
+  [[nodiscard]] auto check(size_t size_to_check) -> bool {
+    error = error || size_to_check > size_remaining();
+    return !error;
+  }
+
+  void skip_unchecked(size_t size_to_skip) {
+    PICKLEJAR_ASSERT(size_to_skip <= size_remaining(),
+                     "ByteCursor skipped past the end of its bytes");
+    current += size_to_skip;
+  }
+  void read_unchecked(char *destination_to_copy_to, size_t size_to_read) {
+    PICKLEJAR_ASSERT(size_to_read <= size_remaining(),
+                     "ByteCursor read past the end of its bytes");
+    std::memcpy(destination_to_copy_to, current, size_to_read);
+    current += size_to_read;
+  }
+  template <class Type>
+  [[nodiscard]] auto read_unchecked() -> Type {
+    static_assert(std::is_trivially_copyable_v<Type>,
+                  "ByteCursor can only read trivially copiable types");
+    Type object;
+    read_unchecked(reinterpret_cast<char *>(&object),  // NOLINT
+                   sizeof(Type));
+    return object;
+  }
+  void write_unchecked(const char *object_ptr, size_t object_size) {
+    PICKLEJAR_ASSERT(object_size <= size_remaining(),
+                     "ByteCursor wrote past the end of its bytes");
+    std::memcpy(current, object_ptr, object_size);
+    current += object_size;
+  }
+  template <class Type>
+  void write_unchecked(const Type &object) {
+    write_unchecked(reinterpret_cast<const char *>(&object),  // NOLINT
+                    sizeof(Type));
+  }
+
+  // checked per element versions, for when the batch size is not known
+  template <class Type>
+  [[nodiscard]] auto read(Type &destination) -> bool {
+    if (!check(sizeof(Type))) return false;
+    read_unchecked(reinterpret_cast<char *>(&destination),  // NOLINT
+                   sizeof(Type));
+    return true;
+  }
+  template <class Type>
+  [[nodiscard]] auto write(const Type &object) -> bool {
+    if (!check(sizeof(Type))) return false;
+    write_unchecked(object);
+    return true;
+  }
+
+  // write the position back into the counter type this cursor was created
+  // from, invalidates its counter if the cursor is invalid
+  template <class ContainerOrViewType>
+  auto commit(ByteContainerOrViewWithCounter<ContainerOrViewType>
+                  &byte_vector_with_counter) const -> bool {
+    if (error) {
+      byte_vector_with_counter.byte_counter.reset();
+      return false;
+    }
+    byte_vector_with_counter.set_counter(
+        size_t(current - byte_vector_with_counter.byte_data.data()));
+    return true;
+  }
+};
+// END BYTECURSOR
+
+// START BYTEFRAMEREADER
+template <class... FieldTypes>
+constexpr auto frame_size() -> size_t {
+  return (size_t{0} + ... + sizeof(FieldTypes));
+}
+
+// ByteFrameReader checks once that a fixed layout prefix of frame_size bytes
+// fits in the remaining bytes of a ByteVectorWithCounter/ByteSpanWithCounter,
+// after that every .read<Type>() is an unchecked load. Reading past the frame
+// is caught by a PICKLEJAR_ASSERT in debug builds only. Call .commit() to
+// advance the original counter by the bytes that were read, or to invalidate
+// it if the frame didn't fit.
+// Ex: inside a 'vector_insert_element_lambda':
+//   picklejar::ByteFrameReader frame{
+//       byte_vector_with_counter, picklejar::frame_size<int, double>()};
+//   if (!frame.valid()) return false;
+//   auto id = frame.read<int>();
+//   auto value = frame.read<double>();
+//   if (!frame.commit()) return false;
+template <class ContainerOrViewType>
+class ByteFrameReader {
+  ByteContainerOrViewWithCounter<ContainerOrViewType> &byte_vector_with_counter;
+  ByteCursor cursor;
+
+ public:
+  ByteFrameReader(ByteContainerOrViewWithCounter<ContainerOrViewType>
+                      &_byte_vector_with_counter,
+                  size_t frame_size)
+      : byte_vector_with_counter{_byte_vector_with_counter},
+        cursor{_byte_vector_with_counter} {
+    // we shrink the cursor to the frame so debug asserts catch overruns
+    if (cursor.check(frame_size)) cursor.end_pos = cursor.current + frame_size;
+  }
+
+  [[nodiscard]] auto valid() const -> bool { return !cursor.invalid(); }
+  [[nodiscard]] auto size_remaining() const -> size_t {
+    return cursor.size_remaining();
+  }
+
+  template <class Type>
+  [[nodiscard]] auto read() -> Type {
+    PICKLEJAR_ASSERT(valid(), "ByteFrameReader read from an invalid frame");
+    return cursor.template read_unchecked<Type>();
+  }
+  void read(char *destination_to_copy_to, size_t size_to_read) {
+    PICKLEJAR_ASSERT(valid(), "ByteFrameReader read from an invalid frame");
+    cursor.read_unchecked(destination_to_copy_to, size_to_read);
+  }
+  void skip(size_t size_to_skip) { cursor.skip_unchecked(size_to_skip); }
+
+  auto commit() -> bool { return cursor.commit(byte_vector_with_counter); }
+};
+
+// reads a tuple of trivially copiable FieldTypes with a single bounds check,
+// returns an empty optional and invalidates the counter if they don't fit
+template <class... FieldTypes, class ContainerOrViewType>
+[[nodiscard]] auto read_frame(
+    ByteContainerOrViewWithCounter<ContainerOrViewType>
+        &byte_vector_with_counter) -> std::optional<std::tuple<FieldTypes...>> {
+  ByteFrameReader frame{byte_vector_with_counter, frame_size<FieldTypes...>()};
+  if (!frame.valid()) {
+    frame.commit();
+    return {};
+  }
+  // braced initialization guarantees the fields are read in order
+  std::tuple<FieldTypes...> fields{frame.template read<FieldTypes>()...};
+  frame.commit();
+  return fields;
+}
+// END BYTEFRAMEREADER
+
 // START buffer_v1
 template <typename Type>
 auto write_vector_to_buffer(const std::vector<Type> &container_of_type,
@@ -554,6 +776,44 @@ ifstream_is_sizeof_type_larger_than_remaining_readbytes(
   return size_t(ifstream_input_file.tellg()) + sizeof(Type) > file_size or
          ifstream_input_file.eof();
 }
+
+namespace util {
+inline auto ifstream_remaining_bytes(std::ifstream &ifstream_input_file)
+    -> size_t {
+  const auto current_pos = ifstream_input_file.tellg();
+  ifstream_input_file.seekg(0, std::ios_base::end);
+  const auto end_pos = ifstream_input_file.tellg();
+  ifstream_input_file.seekg(current_pos, std::ios_base::beg);
+  return current_pos < 0 || end_pos < current_pos
+             ? 0
+             : size_t(end_pos - current_pos);
+}
+
+// the element count of a deep copied vector comes from the file, every
+// element takes at least its size header so a corrupt count can't make
+// reserve ask for more than that. Sources that can't tell how many bytes are
+// left don't reserve
+template <class BufferOrStreamObject>
+[[nodiscard]] auto reservable_element_count(
+    BufferOrStreamObject &buffer_or_stream_object, size_t element_count)
+    -> size_t {
+  if constexpr (std::same_as<BufferOrStreamObject, std::ifstream>) {
+    return std::min(element_count,
+                    ifstream_remaining_bytes(buffer_or_stream_object) /
+                        sizeof(size_t));
+  } else if constexpr (requires {
+                         {
+                           buffer_or_stream_object.size_remaining()
+                         } -> std::convertible_to<size_t>;
+                       }) {
+    return std::min(element_count,
+                    size_t(buffer_or_stream_object.size_remaining()) /
+                        sizeof(size_t));
+  } else {
+    return 0;
+  }
+}
+}  // namespace util
 // END READ_API_HELPERS
 
 // START CONCEPTS
@@ -689,6 +949,21 @@ concept PickleJarVectorInsertElementLambdaRequirements =
              ByteVectorWithCounter byte_vector_with_counter) {
   { function(container, byte_vector_with_counter) } -> std::same_as<bool>;
 };
+// Concept 6 same as Concept 3 but takes a ByteSpanWithCounter that aliases
+// the parent buffer
+template <typename ByteSpanLambda>
+concept PickleJarByteSpanLambdaRequirements =
+    requires(ByteSpanLambda function, ByteSpanWithCounter byte_span_with_counter) {
+  { function(byte_span_with_counter) } -> std::same_as<bool>;
+};
+// Concept 7 same as Concept 4 but takes a ByteSpanWithCounter that aliases
+// the parent buffer
+template <typename VectorInsertElementLambda, typename Container>
+concept PickleJarVectorInsertElementSpanLambdaRequirements =
+    requires(VectorInsertElementLambda function, Container container,
+             ByteSpanWithCounter byte_span_with_counter) {
+  { function(container, byte_span_with_counter) } -> std::same_as<bool>;
+};
 // Concept 5 container has size
 template <typename C>
 concept ContainerDeepCopyReadRequirements = requires(C a) {
@@ -718,6 +993,16 @@ concept ContainerDeepCopyReadRequirements = requires(C a) {
   "sure the lambda function takes a BufferOrStreamObject, and a "   \
   "ByteVectorWithCounter as a parameter and "                       \
   "returns true if reading operation was successful"
+#define BYTESPANLAMBDAREQUIREMENTS_MSG                                       \
+  "PICKLEJAR_HELP: malformed 'byte_span_lambda', make "                      \
+  "sure the lambda function takes a ByteSpanWithCounter as a parameter and " \
+  "returns true if reading operation was successful"
+
+#define VECTORINSERTELEMENTSPANLAMBDAREQUIREMENTS_MSG               \
+  "PICKLEJAR_HELP: malformed 'vector_insert_element_lambda', make " \
+  "sure the lambda function takes a Container, and a "              \
+  "ByteSpanWithCounter as a parameter and "                         \
+  "returns true if reading operation was successful"
 #define CONTAINERDEEPCOPYREADREQUIREMENTS_MSG                               \
   "PICKLEJAR_HELP: You need to pass a container<Type> as first param that " \
   "has .size() and is iterable Ex: std::vector or std::array"
@@ -734,7 +1019,7 @@ template <typename C>
 concept ContainerHasReserve = requires(C a) {
   { C() } -> std::same_as<C>;
   { a.size() } -> std::same_as<typename C::size_type>;
-  { a.reserve() } -> std::same_as<void>;
+  { a.reserve(typename C::size_type{}) } -> std::same_as<void>;
   { a.empty() } -> std::same_as<bool>;
 };
 
@@ -1020,7 +1305,7 @@ auto read_object_from_file(
 // START object_buffer_v2
 template <class Type,
           class ManagedAlignedCopy = ManagedAlignedCopyDefault<Type>,
-          class ManipulateBytesLambda, class ByteContainerOrViewType>
+          class ByteContainerOrViewType, class ManipulateBytesLambda>
 auto operation_specific_read_object_from_buffer(
     ManagedAlignedCopy &copy, ByteContainerOrViewType &buffer_with_input_bytes,
     ManipulateBytesLambda
@@ -1220,17 +1505,19 @@ template <class Type,
   if (file_size < 1) {
     return {};
   }
-  // create a REFERENCE so we don't have to type this twice
-  size_t &bytes_read_so_far = buffer_with_input_bytes.byte_counter.value();
-  while (bytes_read_so_far < file_size) {
-    if (bytes_read_so_far + sizeof(Type) > file_size) break;
+  // we check the size once for all the elements and then copy them without
+  // going through the counter checks for each one
+  ByteCursor cursor{buffer_with_input_bytes};
+  const size_t number_of_elements = cursor.size_remaining() / sizeof(Type);
+  if (!cursor.check(number_of_elements * sizeof(Type))) return {};
+  for (size_t i{0}; i < number_of_elements; ++i) {
     ManagedAlignedCopy copy{};
-    vector_input_data.push_back(std::move(
-        *(operation_specific_read_object_from_buffer<Type, ManagedAlignedCopy,
-                                                     ByteContainerOrViewType>(
-              copy, buffer_with_input_bytes))
-             .get_pointer_to_copy()));
+    cursor.read_unchecked(
+        reinterpret_cast<char *>(copy.get_pointer_to_copy()),  // NOLINT
+        sizeof(Type));
+    vector_input_data.push_back(std::move(*copy.get_pointer_to_copy()));
   }
+  cursor.commit(buffer_with_input_bytes);
   if (vector_input_data.size() > initial_vector_size) {
     return PICKLEJAR_MAKE_OPTIONAL(vector_input_data);
   }
@@ -1454,8 +1741,12 @@ constexpr auto get_buffer_or_stream_byte_counter(
     return size_t(buffer_or_stream_object.tellp());
   } else if constexpr (std::same_as<BufferOrStreamObject, std::ifstream>) {
     return size_t(buffer_or_stream_object.tellg());
-  } else {
+  } else if constexpr (PickleJarValidByteContainerOrViewType<
+                           BufferOrStreamObject>) {
     return buffer_or_stream_object.byte_counter.value();
+  } else {
+    // a sink or source of your own, see SINK SOURCE
+    return size_t(buffer_or_stream_object.position());
   }
 }
 
@@ -1539,6 +1830,102 @@ auto write_vector_deep_copy(
   return false;
 }
 
+template <size_t Version = 0>
+constexpr auto versioned_size() -> size_t {
+  if constexpr (Version > 0) {
+    // version + size as header
+    return sizeof(size_t) * 2;
+  } else {
+    // just the size as header
+    return sizeof(size_t);
+  }
+}
+
+// START DEEP COPY PLAN
+// A DeepCopyPlan is the result of a sizing pass over a container: every
+// element_size_getter_lambda result is computed once and kept in
+// element_sizes, so the exact number of bytes of the deep copy is known before
+// writing anything. write_vector_deep_copy_with_plan then writes the size
+// headers from the plan instead of calling the getter again, and
+// element_offsets gives the position of every element for building an index.
+struct DeepCopyPlan {
+  std::vector<size_t> element_sizes{};
+  size_t header_size{0};
+  size_t byte_size{0};
+
+  // offset from the start of the deep copy to the size header of each element
+  [[nodiscard]] auto element_offsets() const -> std::vector<size_t> {
+    std::vector<size_t> offsets(element_sizes.size());
+    size_t current_offset{header_size};
+    for (size_t i{0}; i < element_sizes.size(); ++i) {
+      offsets[i] = current_offset;
+      current_offset += versioned_size<0>() + element_sizes[i];
+    }
+    return offsets;
+  }
+};
+
+template <size_t Version = 0, class Container,
+          class Type = typename Container::value_type,
+          class ElementSizeGetterLambda>
+[[nodiscard]] auto make_deep_copy_plan(
+    const Container &vector_input_data,
+    ElementSizeGetterLambda &&element_size_getter_lambda) -> DeepCopyPlan {
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(
+      (PickleJarElementSizeGetterRequirements<ElementSizeGetterLambda, Type>),
+      SIZEGETTERLAMBDAREQUIREMENTS_MSG);
+  DeepCopyPlan plan{};
+  plan.header_size = versioned_size<Version>();
+  plan.element_sizes.reserve(vector_input_data.size());
+  plan.byte_size = plan.header_size;
+  for (const Type &object : vector_input_data) {
+    const size_t object_size{element_size_getter_lambda(object)};
+    plan.element_sizes.push_back(object_size);
+    plan.byte_size += versioned_size<0>() + object_size;
+  }
+  return plan;
+}
+
+// same as write_vector_deep_copy but the element sizes come from the plan
+template <size_t Version = 0, class BufferOrStreamObject,
+          bool WriteSizeFunction(const size_t &, BufferOrStreamObject &) =
+              picklejar::write_object_to_stream<size_t>,
+          class Container, class Type = typename Container::value_type,
+          class WriteElementLambda>
+auto write_vector_deep_copy_with_plan(
+    const Container &vector_input_data, const DeepCopyPlan &plan,
+    BufferOrStreamObject &buffer_or_stream_object,
+    WriteElementLambda &&write_element_lambda) -> bool {
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(
+      (PickleJarWriteLambdaRequirements<WriteElementLambda,
+                                        BufferOrStreamObject, Type>),
+      WRITELAMBDAREQUIREMENTS_MSG);
+  PICKLEJAR_ASSERT(plan.element_sizes.size() == vector_input_data.size(),
+                   "PICKLEJAR_RUNTIME_HELP: The DeepCopyPlan was made for a "
+                   "container with a different number of elements");
+
+  if (vector_input_data.empty()) return false;
+  if constexpr (Version > 0) {
+    if (!WriteSizeFunction(Version, buffer_or_stream_object)) return false;
+  }
+  if (!WriteSizeFunction(vector_input_data.size(), buffer_or_stream_object))
+    return false;
+  auto element_size = plan.element_sizes.cbegin();
+  for (const Type &object : vector_input_data) {
+    if (!write_object_deep_copy<0, BufferOrStreamObject, WriteSizeFunction>(
+            object, *element_size++, buffer_or_stream_object,
+            write_element_lambda)) {
+      return false;
+    }
+  }
+  return true;
+}
+// END DEEP COPY PLAN
+
 template <class PointerType>
 auto basic_stream_read(std::ifstream &ifstream_input_file,
                        PointerType *destination_to_copy_to,
@@ -1630,7 +2017,9 @@ auto read_vector_deep_copy(
   }
   if (auto optional_size = ReadSizeFunction(buffer_or_stream_object)) {
     if constexpr (ContainerHasReserve<Container>) {
-      result.reserve(optional_size.value());
+      result.reserve(result.size() +
+                     util::reservable_element_count(buffer_or_stream_object,
+                                                    optional_size.value()));
     }
     for (size_t i{0}; i < optional_size.value(); ++i) {
       if (!read_object_deep_copy<0, BufferOrStreamObject, ReadSizeFunction,
@@ -1821,14 +2210,16 @@ auto deep_copy_vector_to_buffer(
       (PickleJarElementSizeGetterRequirements<ElementSizeGetterLambda, Type>),
       SIZEGETTERLAMBDAREQUIREMENTS_MSG);
 
-  const size_t vector_byte_size = vector_input_data.size() * sizeof(Type);
+  // size every element once, allocate the exact size and write from the plan
+  const DeepCopyPlan plan =
+      make_deep_copy_plan<Version>(vector_input_data, element_size_getter_lambda);
 
   if (std::optional<ByteVectorWithCounter> optional_output_buffer_of_bytes{
-          vector_byte_size};
-      write_vector_deep_copy<Version, ByteVectorWithCounter,
-                             picklejar::write_object_to_buffer>(
-          vector_input_data, optional_output_buffer_of_bytes.value(),
-          element_size_getter_lambda, write_element_lambda))
+          plan.byte_size};
+      write_vector_deep_copy_with_plan<Version, ByteVectorWithCounter,
+                                       picklejar::write_object_to_buffer>(
+          vector_input_data, plan, optional_output_buffer_of_bytes.value(),
+          write_element_lambda))
     return optional_output_buffer_of_bytes;
   return {};
 }
@@ -1910,6 +2301,296 @@ auto deep_read_object_to_buffer(BufferOrStreamObject &buffer_or_stream_object,
       buffer_or_stream_object, byte_buffer_lambda);
 }
 
+// START DEEP VIEW FUNCTIONS
+// Zero-copy versions of the deep read buffer functions. Instead of copying
+// every element into a new ByteVectorWithCounter the lambda gets a
+// ByteSpanWithCounter that aliases the element bytes inside the parent buffer.
+// Because the parent can itself be a ByteSpanWithCounter, nested deep reads
+// (Ex: a map inside each element of a vector) don't copy or allocate at any
+// level. The span is only valid while the parent buffer is alive and
+// unchanged, copy what you need out of it inside the lambda.
+template <size_t Version = 0, class ByteContainerOrViewType,
+          class ByteSpanLambda>
+auto deep_read_object_from_buffer_view(
+    ByteContainerOrViewType &buffer_with_input_bytes,
+    ByteSpanLambda &&byte_span_lambda) -> bool {
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  PICKLEJAR_CONCEPT((PickleJarByteSpanLambdaRequirements<ByteSpanLambda>),
+                    BYTESPANLAMBDAREQUIREMENTS_MSG);
+
+  if constexpr (Version > 0) {
+    auto optional_version =
+        read_object_from_buffer<size_t>(buffer_with_input_bytes);
+    if (buffer_with_input_bytes.invalid() or !optional_version or
+        optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and
+          !buffer_with_input_bytes.invalid() and optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return false;
+    }
+  }
+
+  auto optional_size = read_object_from_buffer<size_t>(buffer_with_input_bytes);
+  if (buffer_with_input_bytes.invalid() or !optional_size) return false;
+  auto element_iterator = buffer_with_input_bytes.current_iterator();
+  if (!buffer_with_input_bytes.advance_counter(optional_size.value()))
+    return false;
+
+  ByteSpanWithCounter byte_buffer{element_iterator, optional_size.value()};
+  bool return_value = byte_span_lambda(byte_buffer);
+  if (return_value && !byte_buffer.invalid() &&
+      optional_size.value() != byte_buffer.byte_counter.value()) {
+    PICKLEJAR_ASSERT(optional_size.value() == byte_buffer.byte_counter.value(),
+                     PICKLEJAR_RUNTIME_READSIZE_MISSMATCH);
+  }
+  return return_value;
+}
+
+template <size_t Version = 0, class Container,
+          class ByteContainerOrViewType, class VectorInsertElementLambda>
+auto deep_read_vector_from_buffer_view(
+    Container &result, ByteContainerOrViewType &buffer_with_input_bytes,
+    VectorInsertElementLambda &&vector_insert_element_lambda)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  PICKLEJAR_CONCEPT((PickleJarVectorInsertElementSpanLambdaRequirements<
+                        VectorInsertElementLambda, Container>),
+                    VECTORINSERTELEMENTSPANLAMBDAREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+
+  size_t result_initial_size{result.size()};
+  if constexpr (Version > 0) {
+    auto optional_version =
+        read_object_from_buffer<size_t>(buffer_with_input_bytes);
+    if (buffer_with_input_bytes.invalid() or !optional_version or
+        optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and
+          !buffer_with_input_bytes.invalid() and optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return {};
+    }
+  }
+  auto optional_size = read_object_from_buffer<size_t>(buffer_with_input_bytes);
+  if (buffer_with_input_bytes.invalid() or !optional_size) return {};
+  if constexpr (ContainerHasReserve<Container>) {
+    result.reserve(result.size() +
+                   util::reservable_element_count(buffer_with_input_bytes,
+                                                  optional_size.value()));
+  }
+  for (size_t i{0}; i < optional_size.value(); ++i) {
+    if (!deep_read_object_from_buffer_view<0>(
+            buffer_with_input_bytes, [&](ByteSpanWithCounter &byte_span) {
+              return vector_insert_element_lambda(result, byte_span);
+            }))
+      return {};
+  }
+  if (result.size() > result_initial_size) {
+    return PICKLEJAR_MAKE_OPTIONAL(result);
+  }
+  return {};
+}
+// END DEEP VIEW FUNCTIONS
+
+// START DEEP PROJECTION FUNCTIONS
+// Projection reads for deep copied vectors, for when only the leading fields
+// of each element are needed (Ex: the id of a record that also holds a nested
+// map). The caller passes how many leading bytes of every element it needs,
+// Ex: picklejar::frame_size<int, double>() for an int and a double read with
+// read_frame<int, double>, and the lambda gets a ByteSpanWithCounter over at
+// most that many bytes. The rest of each element is skipped using its size
+// header without copying it: buffers just move their counter, so over a
+// memory mapped file only the pages holding the projected bytes are touched,
+// and streams ignore short skips and seek over long ones. The lambda doesn't
+// have to read every byte of its span.
+// Inside the span, nested objects written with a size header (write_string,
+// deep copy elements) can be skipped with skip_sized_object or viewed with
+// read_sized_object_view, and nested deep copied vectors and maps can be
+// skipped with skip_deep_copy_vector.
+namespace util {
+// skips shorter than this are read through the stream buffer with ignore(),
+// longer ones seek so the skipped bytes are never read from the file
+constexpr size_t projection_seek_threshold = 64 * 1024;
+}  // namespace util
+
+template <class ByteContainerOrViewType>
+[[nodiscard]] auto skip_sized_object(
+    ByteContainerOrViewType &buffer_with_input_bytes) -> bool {
+  auto optional_size = read_object_from_buffer<size_t>(buffer_with_input_bytes);
+  return !buffer_with_input_bytes.invalid() and optional_size and
+         buffer_with_input_bytes.advance_counter(optional_size.value());
+}
+
+// a view of the bytes of a nested object written with a size header, the
+// counter is moved past them
+template <class ByteContainerOrViewType>
+[[nodiscard]] auto read_sized_object_view(
+    ByteContainerOrViewType &buffer_with_input_bytes)
+    -> std::optional<ByteSpanWithCounter> {
+  auto optional_size = read_object_from_buffer<size_t>(buffer_with_input_bytes);
+  if (buffer_with_input_bytes.invalid() or !optional_size) return {};
+  auto object_iterator = buffer_with_input_bytes.current_iterator();
+  if (!buffer_with_input_bytes.advance_counter(optional_size.value())) return {};
+  return std::make_optional<ByteSpanWithCounter>(object_iterator,
+                                                 optional_size.value());
+}
+
+// skips [Version][count] and count sized elements, one counter move per element
+template <size_t Version = 0, class ByteContainerOrViewType>
+[[nodiscard]] auto skip_deep_copy_vector(
+    ByteContainerOrViewType &buffer_with_input_bytes) -> bool {
+  if constexpr (Version > 0) {
+    auto optional_version =
+        read_object_from_buffer<size_t>(buffer_with_input_bytes);
+    if (buffer_with_input_bytes.invalid() or !optional_version or
+        optional_version.value() != Version)
+      return false;
+  }
+  auto optional_count = read_object_from_buffer<size_t>(buffer_with_input_bytes);
+  if (buffer_with_input_bytes.invalid() or !optional_count) return false;
+  for (size_t i{0}; i < optional_count.value(); ++i) {
+    if (!skip_sized_object(buffer_with_input_bytes)) return false;
+  }
+  return true;
+}
+
+template <size_t Version = 0, class Container, class ByteContainerOrViewType,
+          class VectorInsertElementLambda>
+auto deep_read_vector_projection_from_buffer(
+    Container &result, ByteContainerOrViewType &buffer_with_input_bytes,
+    const size_t projection_size,
+    VectorInsertElementLambda &&vector_insert_element_lambda)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  PICKLEJAR_CONCEPT((PickleJarVectorInsertElementSpanLambdaRequirements<
+                        VectorInsertElementLambda, Container>),
+                    VECTORINSERTELEMENTSPANLAMBDAREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+
+  size_t result_initial_size{result.size()};
+  if constexpr (Version > 0) {
+    auto optional_version =
+        read_object_from_buffer<size_t>(buffer_with_input_bytes);
+    if (buffer_with_input_bytes.invalid() or !optional_version or
+        optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and
+          !buffer_with_input_bytes.invalid() and optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return {};
+    }
+  }
+  auto optional_count = read_object_from_buffer<size_t>(buffer_with_input_bytes);
+  if (buffer_with_input_bytes.invalid() or !optional_count) return {};
+  if constexpr (ContainerHasReserve<Container>) {
+    result.reserve(result.size() +
+                   util::reservable_element_count(buffer_with_input_bytes,
+                                                  optional_count.value()));
+  }
+  for (size_t i{0}; i < optional_count.value(); ++i) {
+    auto optional_size =
+        read_object_from_buffer<size_t>(buffer_with_input_bytes);
+    if (buffer_with_input_bytes.invalid() or !optional_size) return {};
+    auto element_iterator = buffer_with_input_bytes.current_iterator();
+    if (!buffer_with_input_bytes.advance_counter(optional_size.value()))
+      return {};
+    ByteSpanWithCounter projected_bytes{
+        element_iterator, std::min(projection_size, optional_size.value())};
+    if (!vector_insert_element_lambda(result, projected_bytes)) return {};
+  }
+  if (result.size() > result_initial_size) {
+    return PICKLEJAR_MAKE_OPTIONAL(result);
+  }
+  return {};
+}
+
+// only the projected bytes of each element are copied out of the stream, into
+// a scratch buffer that is reused for every element
+template <size_t Version = 0, class Container, class VectorInsertElementLambda>
+auto deep_read_vector_projection_from_stream(
+    Container &result, std::ifstream &ifs_input_file,
+    const size_t projection_size,
+    VectorInsertElementLambda &&vector_insert_element_lambda)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT((PickleJarVectorInsertElementSpanLambdaRequirements<
+                        VectorInsertElementLambda, Container>),
+                    VECTORINSERTELEMENTSPANLAMBDAREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+
+  size_t result_initial_size{result.size()};
+  if constexpr (Version > 0) {
+    if (auto optional_version = read_object_from_stream<size_t>(ifs_input_file);
+        !optional_version or optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return {};
+    }
+  }
+  auto optional_count = read_object_from_stream<size_t>(ifs_input_file);
+  if (!optional_count) return {};
+  // seeking past the end of a file doesn't fail, so the skips are checked
+  // against the bytes left in the stream
+  size_t remaining_bytes{util::ifstream_remaining_bytes(ifs_input_file)};
+  if constexpr (ContainerHasReserve<Container>) {
+    result.reserve(result.size() +
+                   std::min(optional_count.value(),
+                            remaining_bytes / sizeof(size_t)));
+  }
+  std::vector<char> scratch_bytes{};
+  for (size_t i{0}; i < optional_count.value(); ++i) {
+    auto optional_size = read_object_from_stream<size_t>(ifs_input_file);
+    if (!optional_size or
+        optional_size.value() > remaining_bytes - sizeof(size_t))
+      return {};
+    remaining_bytes -= sizeof(size_t) + optional_size.value();
+    const size_t projected_size =
+        std::min(projection_size, optional_size.value());
+    const size_t skipped_size = optional_size.value() - projected_size;
+    scratch_bytes.resize(projected_size);
+    if (!basic_stream_read(ifs_input_file, scratch_bytes.data(),
+                           projected_size))
+      return {};
+    if (skipped_size > util::projection_seek_threshold) {
+      ifs_input_file.seekg(std::streamoff(skipped_size), std::ios_base::cur);
+    } else if (skipped_size > 0) {
+      ifs_input_file.ignore(std::streamsize(skipped_size));
+    }
+    ByteSpanWithCounter projected_bytes{std::span<char>{scratch_bytes}};
+    if (!vector_insert_element_lambda(result, projected_bytes)) return {};
+  }
+  if (result.size() > result_initial_size) {
+    return PICKLEJAR_MAKE_OPTIONAL(result);
+  }
+  return {};
+}
+
+template <size_t Version = 0, class Container, class VectorInsertElementLambda>
+auto deep_read_vector_projection_from_file(
+    Container &result, const std::string file_name,
+    const size_t projection_size,
+    VectorInsertElementLambda &&vector_insert_element_lambda)
+    -> picklejar::optional<Container> {
+  std::ifstream ifs_input_file(file_name, std::ios::in | std::ios::binary);
+  return deep_read_vector_projection_from_stream<Version>(
+      result, ifs_input_file, projection_size, vector_insert_element_lambda);
+}
+// END DEEP PROJECTION FUNCTIONS
+
 // END DEEP COPY FUNCTIONS
 
 // functions we needed after for convenience
@@ -1948,143 +2629,5396 @@ auto read_version_from_buffer(ByteContainerOrViewType &byte_vector_with_counter)
   return picklejar::read_object_from_buffer<size_t>(byte_vector_with_counter);
 }
 
-template <size_t Version = 0>
-constexpr auto versioned_size() -> size_t {
-  if constexpr (Version > 0) {
-    // version + size as header
-    return sizeof(size_t) * 2;
+// START SINK SOURCE
+// Every write function takes a "sink" and every read function a "source", the
+// library has three kinds of each: std::ofstream/std::ifstream, the
+// ByteVectorWithCounter/ByteSpanWithCounter buffers and any type of yours that
+// has these members:
+//   sink:   auto write(const char *bytes, size_t size) -> bool;
+//           auto position() const -> size_t;  // bytes written so far
+//   source: auto read(char *destination, size_t size) -> bool;
+//           auto position() const -> size_t;  // bytes read so far
+//   and optionally for a source:
+//           auto size_remaining() const -> size_t;  // a PickleJarSizedSource
+//           // a view of the next size bytes that is then skipped, for sources
+//           // backed by memory, a PickleJarContiguousSource
+//           auto view(size_t size) -> std::optional<std::span<char>>;
+// The sink_*/source_* functions below dispatch to the right one, so the generic
+// functions (write_string, read_string, the string column, map, columnar and
+// integer encoding functions...) work with any of them. CFileSink/CFileSource
+// are a FILE* backend with a configurable stdio buffer. For the deep copy
+// functions pass write_size_to_sink/read_size_from_source/read_from_source
+// as the size and read template parameters, or use deep_copy_vector_to_sink
+// and deep_read_vector_from_source which do it for you.
+template <typename C>
+concept PickleJarSink =
+    std::same_as<C, std::ofstream> ||
+    PickleJarValidByteContainerOrViewType<C> ||
+    requires(C c, const char *bytes, size_t size) {
+  { c.write(bytes, size) } -> std::same_as<bool>;
+  { c.position() } -> std::convertible_to<size_t>;
+};
+#define PICKLEJARSINK_MSG                                                      \
+  "PICKLEJAR_HELP: You need to pass a std::ofstream, a ByteVectorWithCounter, " \
+  "a ByteSpanWithCounter or a type with write(const char *, size_t) -> bool "  \
+  "and position() members"
+
+template <typename C>
+concept PickleJarSource =
+    std::same_as<C, std::ifstream> ||
+    PickleJarValidByteContainerOrViewType<C> ||
+    requires(C c, char *destination, size_t size) {
+  { c.read(destination, size) } -> std::same_as<bool>;
+  { c.position() } -> std::convertible_to<size_t>;
+};
+#define PICKLEJARSOURCE_MSG                                                   \
+  "PICKLEJAR_HELP: You need to pass a std::ifstream, a ByteVectorWithCounter, " \
+  "a ByteSpanWithCounter or a type with read(char *, size_t) -> bool and "     \
+  "position() members"
+
+// sources that know how many bytes are left
+template <typename C>
+concept PickleJarSizedSource =
+    PickleJarSource<C> &&
+    (std::same_as<C, std::ifstream> ||
+     PickleJarValidByteContainerOrViewType<C> || requires(C c) {
+       { c.size_remaining() } -> std::convertible_to<size_t>;
+     });
+#define PICKLEJARSIZEDSOURCE_MSG                                     \
+  "PICKLEJAR_HELP: This function needs a source that knows how many " \
+  "bytes are left, add a size_remaining() member to your source"
+
+// sources backed by memory, bytes can be used in place instead of copied
+template <typename C>
+concept PickleJarContiguousSource =
+    PickleJarSource<C> &&
+    (PickleJarValidByteContainerOrViewType<C> ||
+     requires(C c, size_t size) {
+       { c.view(size) } -> std::same_as<std::optional<std::span<char>>>;
+     });
+
+template <class Sink>
+[[nodiscard]] auto sink_write(Sink &sink, const char *bytes, size_t size)
+    -> bool {
+  PICKLEJAR_CONCEPT(PickleJarSink<Sink>, PICKLEJARSINK_MSG);
+  if constexpr (std::same_as<Sink, std::ofstream>) {
+    return basic_stream_write(sink, bytes, size);
   } else {
-    // just the size as header
-    return sizeof(size_t);
+    return sink.write(bytes, size);
   }
 }
 
-template <typename C>
-concept IsIterable = requires(C c) {
-  { c.cbegin() } -> std::same_as<typename C::const_iterator>;
-  { c.cend() } -> std::same_as<typename C::const_iterator>;
-  { c.size() } -> std::same_as<size_t>;
+template <class Sink>
+[[nodiscard]] auto sink_position(Sink &sink) -> size_t {
+  PICKLEJAR_CONCEPT(PickleJarSink<Sink>, PICKLEJARSINK_MSG);
+  if constexpr (std::same_as<Sink, std::ofstream>) {
+    return size_t(sink.tellp());
+  } else if constexpr (PickleJarValidByteContainerOrViewType<Sink>) {
+    return sink.byte_counter.value();
+  } else {
+    return size_t(sink.position());
+  }
+}
+
+template <class Source>
+[[nodiscard]] auto source_read(Source &source, char *destination, size_t size)
+    -> bool {
+  PICKLEJAR_CONCEPT(PickleJarSource<Source>, PICKLEJARSOURCE_MSG);
+  if constexpr (std::same_as<Source, std::ifstream>) {
+    return basic_stream_read(source, destination, size);
+  } else if constexpr (PickleJarValidByteContainerOrViewType<Source>) {
+    // checked first so a short buffer fails instead of asserting
+    return !source.invalid() && size <= source.size_remaining() &&
+           source.read(destination, size);
+  } else {
+    return source.read(destination, size);
+  }
+}
+
+template <class Source>
+[[nodiscard]] auto source_position(Source &source) -> size_t {
+  PICKLEJAR_CONCEPT(PickleJarSource<Source>, PICKLEJARSOURCE_MSG);
+  if constexpr (std::same_as<Source, std::ifstream>) {
+    return size_t(source.tellg());
+  } else if constexpr (PickleJarValidByteContainerOrViewType<Source>) {
+    return source.byte_counter.value();
+  } else {
+    return size_t(source.position());
+  }
+}
+
+template <class Source>
+[[nodiscard]] auto source_size_remaining(Source &source) -> size_t {
+  PICKLEJAR_CONCEPT(PickleJarSizedSource<Source>, PICKLEJARSIZEDSOURCE_MSG);
+  if constexpr (std::same_as<Source, std::ifstream>) {
+    return util::ifstream_remaining_bytes(source);
+  } else {
+    return size_t(source.size_remaining());
+  }
+}
+
+// a view of the next size bytes of a contiguous source, which skips them
+template <class Source>
+[[nodiscard]] auto source_view(Source &source, size_t size)
+    -> std::optional<std::span<char>> {
+  static_assert(PickleJarContiguousSource<Source>,
+                "PICKLEJAR_HELP: source_view needs a source backed by memory");
+  if constexpr (PickleJarValidByteContainerOrViewType<Source>) {
+    if (source.invalid() || size > source.size_remaining()) return {};
+    std::span<char> bytes{source.current_data_pos(), size};
+    *source.byte_counter += size;
+    return bytes;
+  } else {
+    return source.view(size);
+  }
+}
+
+// same signatures as the WriteSizeFunction/ReadSizeFunction/
+// ReadBufferOrStreamFunction template parameters of the deep copy functions
+template <class Sink>
+auto write_size_to_sink(const size_t &size, Sink &sink) -> bool {
+  return sink_write(sink, reinterpret_cast<const char *>(&size),  // NOLINT
+                    sizeof(size_t));
+}
+
+template <class Source>
+auto read_size_from_source(Source &source) -> std::optional<size_t> {
+  size_t size{0};
+  if (!source_read(source, reinterpret_cast<char *>(&size),  // NOLINT
+                   sizeof(size_t)))
+    return {};
+  return size;
+}
+
+template <class Source>
+auto read_from_source(Source &source, char *destination, const size_t size)
+    -> bool {
+  return source_read(source, destination, size);
+}
+
+// FILE* sink, buffer_size sets a stdio buffer of that many bytes, a big one
+// (Ex: 1 MiB) turns many small element writes into a few large write calls.
+// The sink owns and closes the files it opens.
+class CFileSink {
+  std::unique_ptr<char[]> stdio_buffer{};
+  std::FILE *file{nullptr};
+  size_t bytes_written{0};
+  bool owns_file{false};
+  bool failed{false};
+
+ public:
+  explicit CFileSink(std::FILE *_file, size_t buffer_size = 0) : file{_file} {
+    set_buffer(buffer_size);
+  }
+  explicit CFileSink(const std::string file_name, size_t buffer_size = 0)
+      : file{std::fopen(file_name.c_str(), "wb")}, owns_file{true} {
+    set_buffer(buffer_size);
+  }
+  CFileSink(const CFileSink &) = delete;
+  auto operator=(const CFileSink &) -> CFileSink & = delete;
+  ~CFileSink() { close(); }
+
+  void set_buffer(size_t buffer_size) {
+    if (file == nullptr || buffer_size == 0) return;
+    stdio_buffer = std::make_unique<char[]>(buffer_size);
+    failed = std::setvbuf(file, stdio_buffer.get(), _IOFBF, buffer_size) != 0;
+  }
+  auto write(const char *bytes, size_t size) -> bool {
+    if (!good()) return false;
+    failed = std::fwrite(bytes, 1, size, file) != size;
+    bytes_written += failed ? 0 : size;
+    return !failed;
+  }
+  [[nodiscard]] auto position() const -> size_t { return bytes_written; }
+  [[nodiscard]] auto good() const -> bool { return file != nullptr && !failed; }
+  // hands the stdio buffer to the OS
+  auto flush() -> bool {
+    if (!good()) return false;
+    failed = std::fflush(file) != 0;
+    return !failed;
+  }
+  // flushes the stdio buffer, and closes the file if the sink opened it
+  auto close() -> bool {
+    if (file == nullptr) return false;
+    bool result{std::fflush(file) == 0 && !failed};
+    if (owns_file) result = std::fclose(file) == 0 && result;
+    file = nullptr;
+    return result;
+  }
 };
-template <typename C>
-concept NotIterable = requires(C c) {
-  requires !IsIterable<C>;
+
+// FILE* source, the size of the file is read once when it is opened
+class CFileSource {
+  std::unique_ptr<char[]> stdio_buffer{};
+  std::FILE *file{nullptr};
+  size_t bytes_read{0};
+  size_t file_size{0};
+  bool owns_file{false};
+
+  void init(size_t buffer_size) {
+    if (file == nullptr) return;
+    if (buffer_size > 0) {
+      stdio_buffer = std::make_unique<char[]>(buffer_size);
+      std::setvbuf(file, stdio_buffer.get(), _IOFBF, buffer_size);
+    }
+    const long start_pos = std::ftell(file);
+    if (start_pos >= 0 && std::fseek(file, 0, SEEK_END) == 0) {
+      const long end_pos = std::ftell(file);
+      file_size = end_pos > start_pos ? size_t(end_pos - start_pos) : 0;
+      std::fseek(file, start_pos, SEEK_SET);
+    }
+  }
+
+ public:
+  explicit CFileSource(std::FILE *_file, size_t buffer_size = 0)
+      : file{_file} {
+    init(buffer_size);
+  }
+  explicit CFileSource(const std::string file_name, size_t buffer_size = 0)
+      : file{std::fopen(file_name.c_str(), "rb")}, owns_file{true} {
+    init(buffer_size);
+  }
+  CFileSource(const CFileSource &) = delete;
+  auto operator=(const CFileSource &) -> CFileSource & = delete;
+  ~CFileSource() {
+    if (owns_file && file != nullptr) std::fclose(file);
+  }
+
+  auto read(char *destination, size_t size) -> bool {
+    if (file == nullptr || size > size_remaining()) return false;
+    if (std::fread(destination, 1, size, file) != size) return false;
+    bytes_read += size;
+    return true;
+  }
+  [[nodiscard]] auto position() const -> size_t { return bytes_read; }
+  [[nodiscard]] auto size_remaining() const -> size_t {
+    return file_size - bytes_read;
+  }
+  [[nodiscard]] auto good() const -> bool { return file != nullptr; }
 };
 
-template <typename C>
-concept IsMapType = requires(C c) {
-  requires !std::same_as<typename C::key_type, void>;
-  requires !std::same_as<typename C::mapped_type, void>;
+template <class Type, class Sink>
+auto write_vector_to_sink(const std::vector<Type> &container_of_type,
+                          Sink &sink) -> bool {
+  PICKLEJAR_CONCEPT(TriviallyCopiable<Type>, TRIVIALLYCOPIABLE_MSG);
+  return sink_write(sink,
+                    reinterpret_cast<const char *>(  // NOLINT
+                        container_of_type.data()),
+                    sizeof(Type) * container_of_type.size());
+}
+
+// reads every remaining element of the source with a single read
+template <class Type, class Container, class Source>
+[[nodiscard]] auto read_vector_from_source(Container &vector_input_data,
+                                           Source &source)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(PickleJarSizedSource<Source>, PICKLEJARSIZEDSOURCE_MSG);
+  PICKLEJAR_CONCEPT(TriviallyCopiable<Type>, TRIVIALLYCOPIABLE_MSG);
+  PICKLEJAR_CONCEPT(ContainerHasDataAndSize<Container>,
+                    CONTAINERWITHHASDATAANDSIZE_MSG);
+  const size_t number_of_elements = source_size_remaining(source) / sizeof(Type);
+  if (number_of_elements < 1) return {};
+  const size_t initial_vector_size = vector_input_data.size();
+  vector_input_data.resize(initial_vector_size + number_of_elements);
+  if (!source_read(source,
+                   reinterpret_cast<char *>(  // NOLINT
+                       vector_input_data.data() + initial_vector_size),
+                   number_of_elements * sizeof(Type))) {
+    vector_input_data.resize(initial_vector_size);
+    return {};
+  }
+  return PICKLEJAR_MAKE_OPTIONAL(vector_input_data);
+}
+
+template <size_t Version = 0, class Container, class Sink,
+          class WriteElementLambda, class ElementSizeGetterLambda>
+auto deep_copy_vector_to_sink(
+    const Container &vector_input_data, Sink &sink,
+    ElementSizeGetterLambda &&element_size_getter_lambda,
+    WriteElementLambda &&write_element_lambda) -> bool {
+  PICKLEJAR_CONCEPT(PickleJarSink<Sink>, PICKLEJARSINK_MSG);
+  return write_vector_deep_copy<Version, Sink, write_size_to_sink<Sink>>(
+      vector_input_data, sink, element_size_getter_lambda,
+      write_element_lambda);
+}
+
+template <size_t Version = 0, class Container, class Source,
+          class VectorInsertElementLambda>
+auto deep_read_vector_from_source(
+    Container &result, Source &source,
+    VectorInsertElementLambda &&vector_insert_element_lambda)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(PickleJarSource<Source>, PICKLEJARSOURCE_MSG);
+  return read_vector_deep_copy<Version, Source, read_size_from_source<Source>,
+                               read_from_source<Source>>(
+      result, source, vector_insert_element_lambda);
+}
+// END SINK SOURCE
+
+// START POSIX FD BACKEND
+// FdSink/FdSource write and read a file descriptor with pwrite/pread through
+// one large aligned buffer, skipping the iostream layers (sentries, locale,
+// virtual streambuf calls). Use them anywhere a sink or source is accepted.
+// Every FdSource keeps its own offset and only uses pread, so several threads
+// can each read a disjoint range of the same file through one descriptor:
+//   int fd = ::open("data", O_RDONLY);
+//   picklejar::FdSource first_half{fd, buffer_size, 0, half};
+//   picklejar::FdSource second_half{fd, buffer_size, half, file_size - half};
+// Reads as big as the buffer go straight into the destination. Sources ask
+// the kernel for sequential readahead over their range with posix_fadvise.
+#if defined(__unix__) || defined(__APPLE__)
+#define PICKLEJAR_HAS_POSIX_IO 1
+namespace util {
+constexpr size_t fd_buffer_alignment = 4096;
+constexpr size_t fd_min_buffer_size = size_t{1} << 20;
+constexpr size_t fd_max_buffer_size = size_t{16} << 20;
+
+struct aligned_free {
+  void operator()(char *pointer) const { std::free(pointer); }  // NOLINT
 };
+using aligned_buffer = std::unique_ptr<char[], aligned_free>;
+
+// size is rounded up to a multiple of alignment, which aligned_alloc needs
+inline auto make_aligned_buffer(size_t size,
+                                size_t alignment = fd_buffer_alignment)
+    -> aligned_buffer {
+  size = (size + alignment - 1) / alignment * alignment;
+  return aligned_buffer{
+      static_cast<char *>(std::aligned_alloc(alignment, size))};
+}
 
-template <size_t Version = 0, NotIterable Object>
-constexpr auto sizeof_versioned(Object object) -> size_t {
-  return picklejar::versioned_size<Version>() + sizeof(object);
+inline auto clamp_fd_buffer_size(size_t buffer_size) -> size_t {
+  return std::clamp(buffer_size, fd_min_buffer_size, fd_max_buffer_size);
 }
-template <size_t Version = 0, IsIterable Container>
-constexpr auto sizeof_versioned(Container container) -> size_t {
-  if constexpr (IsMapType<Container>) {
-    if constexpr (std::same_as<std::string, typename Container::key_type>) {
-      // if you get a trivially_copiable warning here is because when I wrote
-      // this I assumed the value_type of the map would be trivially copiable,
-      // if that is not the case you will have to copy this function and make it
-      // return the size of what you are writting
-      PICKLEJAR_CONCEPT(CanBeCopiedEasily<typename Container::value_type>,
-                        TRIVIALLYCOPIABLE_MSG);
-      return versioned_size<Version>() +
-             std::transform_reduce(
-                 std::cbegin(container), std::cend(container), size_t{0},
-                 std::plus<>(), [](auto &map_elem) {
-                   return versioned_size<0>() + sizeof(size_t) +
-                          map_elem.first.size() + sizeof(map_elem.second);
-                 });
-    } else {
-      PICKLEJAR_CONCEPT(CanBeCopiedEasily<typename Container::key_type>,
-                        TRIVIALLYCOPIABLE_MSG);
-      PICKLEJAR_CONCEPT(CanBeCopiedEasily<typename Container::value_type>,
-                        TRIVIALLYCOPIABLE_MSG);
-      return versioned_size<Version>() +
-             std::transform_reduce(
-                 std::cbegin(container), std::cend(container), size_t{0},
-                 std::plus<>(), [](auto &map_elem) {
-                   return versioned_size<0>() + sizeof(map_elem.first) +
-                          sizeof(map_elem.second);
-                 });
-    }
-  } else {
-    PICKLEJAR_CONCEPT(CanBeCopiedEasily<typename Container::value_type>,
-                      TRIVIALLYCOPIABLE_MSG);
-    return picklejar::versioned_size<Version>() +
-           (container.size() *
-            (versioned_size<0>() + sizeof(typename Container::value_type)));
+
+// retries short writes and EINTR
+inline auto pwrite_all(int fd, const char *bytes, size_t size, off_t offset)
+    -> bool {
+  while (size > 0) {
+    const ssize_t written = ::pwrite(fd, bytes, size, offset);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return false;
+    bytes += written;
+    size -= size_t(written);
+    offset += off_t(written);
   }
+  return true;
 }
 
-template <class BufferOrStreamObject>
-auto string_write_generic(const std::string string_to_write,
-                          BufferOrStreamObject &buffer_or_stream_object)
+// retries short reads and EINTR, fails at the end of the file
+inline auto pread_all(int fd, char *destination, size_t size, off_t offset)
     -> bool {
-  if constexpr (std::same_as<BufferOrStreamObject, std::ofstream>) {
-    // write the actual size of our string into the file
-    if (!write_object_to_stream(string_to_write.size(),
-                                buffer_or_stream_object))
-      return false;
+  while (size > 0) {
+    const ssize_t bytes_read = ::pread(fd, destination, size, offset);
+    if (bytes_read < 0 && errno == EINTR) continue;
+    if (bytes_read <= 0) return false;
+    destination += bytes_read;
+    size -= size_t(bytes_read);
+    offset += off_t(bytes_read);
+  }
+  return true;
+}
+}  // namespace util
 
-    // next we write the string data into the file
-    if (!basic_stream_write(buffer_or_stream_object, string_to_write.data(),
-                            string_to_write.size()))
-      return false;
-  } else {
-    // write the actual size of our string into the file
-    if (!write_object_to_buffer(string_to_write.size(),
-                                buffer_or_stream_object))
-      return false;
+class FdSink {
+  util::aligned_buffer buffer{};
+  size_t buffer_size{0};
+  size_t buffered_bytes{0};
+  int fd{-1};
+  off_t file_offset{0};  // where the buffer starts in the file
+  size_t bytes_written{0};
+  bool owns_fd{false};
+  bool failed{false};
+
+ public:
+  // buffer_size is clamped to 1-16 MiB
+  explicit FdSink(const std::string file_name,
+                  size_t _buffer_size = util::fd_min_buffer_size)
+      : FdSink(::open(file_name.c_str(),
+                      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644),
+               _buffer_size) {
+    owns_fd = true;
+  }
+  // writes start at offset, the descriptor is not closed
+  explicit FdSink(int _fd, size_t _buffer_size = util::fd_min_buffer_size,
+                  off_t offset = 0)
+      : buffer_size{util::clamp_fd_buffer_size(_buffer_size)},
+        fd{_fd},
+        file_offset{offset} {
+    if (fd >= 0) buffer = util::make_aligned_buffer(buffer_size);
+    failed = fd < 0 || !buffer;
+  }
+  FdSink(const FdSink &) = delete;
+  auto operator=(const FdSink &) -> FdSink & = delete;
+  ~FdSink() { close(); }
+
+  auto flush() -> bool {
+    if (failed) return false;
+    failed = !util::pwrite_all(fd, buffer.get(), buffered_bytes, file_offset);
+    file_offset += off_t(buffered_bytes);
+    buffered_bytes = 0;
+    return !failed;
+  }
+  auto write(const char *bytes, size_t size) -> bool {
+    if (failed) return false;
+    if (buffered_bytes + size > buffer_size && !flush()) return false;
+    if (size >= buffer_size) {
+      // nothing to gain from copying it into the buffer first
+      failed = !util::pwrite_all(fd, bytes, size, file_offset);
+      file_offset += off_t(size);
+    } else {
+      std::memcpy(buffer.get() + buffered_bytes, bytes, size);
+      buffered_bytes += size;
+    }
+    bytes_written += failed ? 0 : size;
+    return !failed;
+  }
+  [[nodiscard]] auto position() const -> size_t { return bytes_written; }
+  [[nodiscard]] auto good() const -> bool { return !failed; }
+  // flushes the buffer, and closes the descriptor if the sink opened it
+  auto close() -> bool {
+    if (fd < 0) return false;
+    bool result{flush()};
+    if (owns_fd) result = ::close(fd) == 0 && result;
+    fd = -1;
+    return result;
+  }
+};
 
-    // next we write the string data into the file
-    if (!basic_buffer_write(buffer_or_stream_object, string_to_write.data(),
-                            string_to_write.size()))
+class FdSource {
+  util::aligned_buffer buffer{};
+  size_t buffer_size{0};
+  size_t buffer_begin{0};  // the unread bytes of the buffer
+  size_t buffer_end{0};
+  int fd{-1};
+  off_t range_begin{0};
+  off_t file_offset{0};  // where the next refill starts
+  size_t range_size{0};
+  size_t bytes_read{0};
+  size_t readahead_window{0};
+  off_t readahead_end{0};  // where the last WILLNEED hint ended
+  bool owns_fd{false};
+
+  auto refill() -> bool {
+    const size_t size_to_read =
+        std::min(buffer_size, range_size - size_t(file_offset - range_begin));
+    advise_readahead(size_to_read);
+    if (!util::pread_all(fd, buffer.get(), size_to_read, file_offset))
       return false;
+    file_offset += off_t(size_to_read);
+    buffer_begin = 0;
+    buffer_end = size_to_read;
+    return true;
   }
-  return true;
+
+  // asks the kernel to start reading the window after the next refill, once
+  // the previous hint is half used
+  auto advise_readahead([[maybe_unused]] size_t size_to_read) -> void {
+#if defined(POSIX_FADV_WILLNEED)
+    if (readahead_window == 0) return;
+    const off_t window_end = file_offset + off_t(readahead_window);
+    if (file_offset + off_t(readahead_window / 2) < readahead_end) return;
+    const off_t hint_begin =
+        std::max(file_offset + off_t(size_to_read), readahead_end);
+    if (window_end > hint_begin)
+      ::posix_fadvise(fd, hint_begin, window_end - hint_begin,
+                      POSIX_FADV_WILLNEED);
+    readahead_end = window_end;
+#endif
+  }
+
+ public:
+  explicit FdSource(const std::string file_name,
+                    size_t _buffer_size = util::fd_min_buffer_size)
+      : FdSource(::open(file_name.c_str(), O_RDONLY | O_CLOEXEC), _buffer_size,
+                 0, std::numeric_limits<size_t>::max()) {
+    owns_fd = true;
+  }
+  // reads range_size bytes starting at offset (up to the end of the file),
+  // the descriptor is not closed
+  explicit FdSource(int _fd, size_t _buffer_size = util::fd_min_buffer_size,
+                    off_t offset = 0,
+                    size_t _range_size = std::numeric_limits<size_t>::max())
+      : buffer_size{util::clamp_fd_buffer_size(_buffer_size)},
+        fd{_fd},
+        range_begin{offset},
+        file_offset{offset} {
+    struct stat file_status {};
+    if (fd < 0 || ::fstat(fd, &file_status) != 0) return;
+    const auto file_size = size_t(file_status.st_size);
+    range_size = size_t(offset) > file_size
+                     ? 0
+                     : std::min(_range_size, file_size - size_t(offset));
+    buffer = util::make_aligned_buffer(buffer_size);
+#if defined(POSIX_FADV_SEQUENTIAL)
+    ::posix_fadvise(fd, offset, off_t(range_size), POSIX_FADV_SEQUENTIAL);
+#endif
+  }
+  FdSource(const FdSource &) = delete;
+  auto operator=(const FdSource &) -> FdSource & = delete;
+  ~FdSource() {
+    if (owns_fd && fd >= 0) ::close(fd);
+  }
+
+  auto read(char *destination, size_t size) -> bool {
+    if (!good() || size > size_remaining()) return false;
+    const size_t buffered_size = std::min(size, buffer_end - buffer_begin);
+    std::memcpy(destination, buffer.get() + buffer_begin, buffered_size);
+    buffer_begin += buffered_size;
+    bytes_read += buffered_size;
+    destination += buffered_size;
+    size -= buffered_size;
+    if (size >= buffer_size) {
+      // big reads skip the buffer
+      if (!util::pread_all(fd, destination, size, file_offset)) return false;
+      file_offset += off_t(size);
+      bytes_read += size;
+    } else if (size > 0) {
+      if (!refill()) return false;
+      std::memcpy(destination, buffer.get(), size);
+      buffer_begin = size;
+      bytes_read += size;
+    }
+    return true;
+  }
+  [[nodiscard]] auto position() const -> size_t { return bytes_read; }
+  [[nodiscard]] auto size_remaining() const -> size_t {
+    return range_size - bytes_read;
+  }
+  [[nodiscard]] auto good() const -> bool { return fd >= 0 && buffer; }
+  // bytes the kernel is asked to read ahead of every refill with
+  // POSIX_FADV_WILLNEED, 0 (the default) leaves it to the SEQUENTIAL hint
+  auto set_readahead_window(size_t window_size) -> void {
+    readahead_window = window_size;
+  }
+};
+#endif
+// END POSIX FD BACKEND
+
+// START DIRECT IO
+// DirectFileSource reads a whole file with O_DIRECT (F_NOCACHE on macOS) so
+// cold loads of big snapshots neither evict the page cache nor keep a second
+// copy of the file in it. Chunks are read into two aligned buffers: while the
+// caller copies out of one, the next chunk is already being read into the
+// other on a std::async task. When the filesystem rejects O_DIRECT (tmpfs,
+// some network filesystems) it falls back to regular reads and drops every
+// consumed chunk from the page cache with POSIX_FADV_DONTNEED.
+//   auto optional_result =
+//       picklejar::read_vector_from_file_direct<Type>(result, "snapshot");
+#if defined(PICKLEJAR_HAS_POSIX_IO)
+struct DirectReadOptions {
+  // rounded up to a multiple of util::fd_buffer_alignment
+  size_t chunk_size{size_t{4} << 20};
+  // false skips O_DIRECT and goes straight to the fallback
+  bool use_direct_io{true};
+};
+
+namespace util {
+// O_DIRECT needs the file offset, the size and the buffer address aligned to
+// the logical block size of the device, fd_buffer_alignment covers it
+inline auto open_direct(const std::string &file_name, bool use_direct_io)
+    -> std::pair<int, bool> {
+#if defined(O_DIRECT)
+  if (use_direct_io) {
+    const int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+    if (fd >= 0 || errno != EINVAL) return {fd, fd >= 0};
+  }
+#endif
+  const int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+  if (fd >= 0 && use_direct_io) return {fd, ::fcntl(fd, F_NOCACHE, 1) == 0};
+#endif
+  return {fd, false};
 }
+}  // namespace util
 
-inline auto write_string_to_stream(const std::string string_to_write,
-                                   std::ofstream &_ofs_output_file) -> bool {
-  return string_write_generic(string_to_write, _ofs_output_file);
+class DirectFileSource {
+  std::array<util::aligned_buffer, 2> buffers{};
+  std::future<bool> pending_chunk{};
+  size_t chunk_size{0};
+  size_t chunk_count{0};
+  size_t next_chunk_index{0};  // the chunk pending_chunk is reading
+  const char *chunk_begin{nullptr};
+  size_t chunk_remaining{0};
+  size_t file_size{0};
+  size_t bytes_read{0};
+  int fd{-1};
+  std::atomic<bool> direct_io{false};
+  bool failed{true};
+
+  [[nodiscard]] auto chunk_bytes(size_t chunk_index) const -> size_t {
+    return std::min(chunk_size, file_size - chunk_index * chunk_size);
+  }
+
+  // runs on the async task, only touches the buffer of its own chunk
+  auto read_chunk(size_t chunk_index) -> bool {
+    char *destination = buffers[chunk_index % 2].get();
+    const auto offset = off_t(chunk_index * chunk_size);
+    const size_t wanted = chunk_bytes(chunk_index);
+    size_t received{0};
+    while (received < wanted) {
+      // direct reads have to ask for whole blocks, the last one comes back
+      // short at the end of the file
+      const size_t request =
+          direct_io ? (wanted - received + util::fd_buffer_alignment - 1) /
+                          util::fd_buffer_alignment *
+                          util::fd_buffer_alignment
+                    : wanted - received;
+      const ssize_t bytes = ::pread(fd, destination + received, request,
+                                    offset + off_t(received));
+      if (bytes < 0 && errno == EINTR) continue;
+#if defined(O_DIRECT)
+      if (bytes < 0 && errno == EINVAL && direct_io && received == 0) {
+        // some filesystems accept the flag on open and only fail the read
+        const int flags = ::fcntl(fd, F_GETFL);
+        if (flags < 0 || ::fcntl(fd, F_SETFL, flags & ~O_DIRECT) != 0)
+          return false;
+        direct_io = false;
+        continue;
+      }
+#endif
+      if (bytes <= 0) return false;
+      received += size_t(bytes);
+    }
+#if defined(POSIX_FADV_DONTNEED)
+    if (!direct_io)
+      ::posix_fadvise(fd, offset, off_t(wanted), POSIX_FADV_DONTNEED);
+#endif
+    return true;
+  }
+
+  auto submit_next_chunk() -> void {
+    if (next_chunk_index >= chunk_count) return;
+    pending_chunk = std::async(std::launch::async, &DirectFileSource::read_chunk,
+                               this, next_chunk_index);
+  }
+
+  auto next_chunk() -> bool {
+    if (failed || !pending_chunk.valid()) return false;
+    failed = !pending_chunk.get();
+    if (failed) return false;
+    chunk_begin = buffers[next_chunk_index % 2].get();
+    chunk_remaining = chunk_bytes(next_chunk_index);
+    ++next_chunk_index;
+    // the other buffer was fully consumed before this call
+    submit_next_chunk();
+    return true;
+  }
+
+ public:
+  explicit DirectFileSource(const std::string file_name,
+                            DirectReadOptions options = {})
+      : chunk_size{(std::max(options.chunk_size, size_t{1}) +
+                    util::fd_buffer_alignment - 1) /
+                   util::fd_buffer_alignment * util::fd_buffer_alignment} {
+    auto [_fd, _direct_io] = util::open_direct(file_name, options.use_direct_io);
+    fd = _fd;
+    direct_io = _direct_io;
+    struct stat file_status {};
+    if (fd < 0 || ::fstat(fd, &file_status) != 0) return;
+    file_size = size_t(file_status.st_size);
+    chunk_count = (file_size + chunk_size - 1) / chunk_size;
+    for (auto &buffer : buffers) {
+      buffer = util::make_aligned_buffer(chunk_size);
+      if (!buffer) return;
+    }
+    failed = false;
+    submit_next_chunk();
+  }
+  DirectFileSource(const DirectFileSource &) = delete;
+  auto operator=(const DirectFileSource &) -> DirectFileSource & = delete;
+  ~DirectFileSource() {
+    if (pending_chunk.valid()) pending_chunk.wait();
+    if (fd >= 0) ::close(fd);
+  }
+
+  auto read(char *destination, size_t size) -> bool {
+    if (failed || size > size_remaining()) return false;
+    while (size > 0) {
+      if (chunk_remaining == 0 && !next_chunk()) return false;
+      const size_t bytes = std::min(size, chunk_remaining);
+      std::memcpy(destination, chunk_begin, bytes);
+      chunk_begin += bytes;
+      chunk_remaining -= bytes;
+      destination += bytes;
+      size -= bytes;
+      bytes_read += bytes;
+    }
+    return true;
+  }
+  [[nodiscard]] auto position() const -> size_t { return bytes_read; }
+  [[nodiscard]] auto size_remaining() const -> size_t {
+    return file_size - bytes_read;
+  }
+  [[nodiscard]] auto good() const -> bool { return !failed; }
+  // false when the fallback is in use
+  [[nodiscard]] auto used_direct_io() const -> bool { return direct_io; }
+};
+
+template <class Type, class Container>
+[[nodiscard]] auto read_vector_from_file_direct(
+    Container &vector_input_data, const std::string file_name,
+    DirectReadOptions options = {}) -> picklejar::optional<Container> {
+  DirectFileSource source{file_name, options};
+  if (!source.good()) return {};
+  return read_vector_from_source<Type>(vector_input_data, source);
 }
-inline auto write_string_to_file(const std::string string_to_write,
-                                 const std::string file_name) -> bool {
-  std::ofstream _ofs_output_file(file_name);
-  return string_write_generic(string_to_write, _ofs_output_file);
+
+template <size_t Version = 0, class Container,
+          class VectorInsertElementLambda>
+auto deep_read_vector_from_file_direct(
+    Container &result, const std::string file_name,
+    VectorInsertElementLambda &&vector_insert_element_lambda,
+    DirectReadOptions options = {}) -> picklejar::optional<Container> {
+  DirectFileSource source{file_name, options};
+  if (!source.good()) return {};
+  return deep_read_vector_from_source<Version>(result, source,
+                                               vector_insert_element_lambda);
 }
+#endif
+// END DIRECT IO
+
+// START READAHEAD
+// Readers that walk big deep copied vectors in place stall on page faults and
+// cold cache lines once per element. ReadaheadOptions turns on two hints:
+// - prefetch_distance: while the lambda of element i runs, the bytes of
+//   element i + prefetch_distance are prefetched with __builtin_prefetch (at
+//   most util::prefetch_max_bytes of each). A cursor walks the size headers
+//   ahead of the reader, so it works with elements of any size.
+// - readahead_window: for memory mapped files, madvise(MADV_WILLNEED) is
+//   issued for this many bytes ahead of the reader every time half of the
+//   previous window has been used (on top of MADV_SEQUENTIAL for the whole
+//   file). FdSource::set_readahead_window does the same for descriptors.
+// Ex:
+//   auto optional_result = picklejar::deep_read_vector_from_mapped_file<1>(
+//       result, "snapshot", vector_insert_element_lambda, {16, 32 << 20});
+struct ReadaheadOptions {
+  size_t prefetch_distance{8};  // in elements, 0 disables it
+  size_t readahead_window{size_t{8} << 20};  // in bytes, 0 disables it
+};
 
-inline auto write_string_to_buffer(
-    const std::string string_to_write,
-    ByteVectorWithCounter &byte_vector_with_counter) -> bool {
-  return string_write_generic(string_to_write, byte_vector_with_counter);
+namespace util {
+constexpr size_t prefetch_cache_line_size = 64;
+constexpr size_t prefetch_max_bytes = 256;
+
+inline auto prefetch_bytes([[maybe_unused]] const char *bytes,
+                           [[maybe_unused]] size_t size) -> void {
+#if defined(__GNUC__) || defined(__clang__)
+  size = std::min(size, prefetch_max_bytes);
+  for (size_t offset{0}; offset < size; offset += prefetch_cache_line_size)
+    __builtin_prefetch(bytes + offset, 0, 3);
+#endif
 }
 
-template <NotIterable Object>
-constexpr auto sizeof_unversioned(Object object) -> size_t {
-  PICKLEJAR_CONCEPT(CanBeCopiedEasily<Object>, TRIVIALLYCOPIABLE_MSG);
-  return sizeof(Object);
+// walks the [size][bytes] elements of a deep copied vector ahead of the
+// reader, prefetching each element and the header after it
+struct element_prefetcher {
+  const char *cursor{nullptr};
+  const char *end{nullptr};
+
+  auto step() -> void {
+    if (size_t(end - cursor) < sizeof(size_t)) {
+      cursor = end;
+      return;
+    }
+    size_t element_size{0};
+    std::memcpy(&element_size, cursor, sizeof(size_t));
+    cursor += sizeof(size_t);
+    if (element_size > size_t(end - cursor)) {
+      cursor = end;
+      return;
+    }
+    prefetch_bytes(cursor, element_size);
+    cursor += element_size;
+    prefetch_bytes(cursor, sizeof(size_t));
+  }
+};
+
+// progress_lambda gets the buffer counter before every element lambda call
+template <size_t Version = 0, class Container,
+          class ByteContainerOrViewType, class VectorInsertElementLambda,
+          class ProgressLambda>
+auto deep_read_vector_from_buffer_view_with_readahead(
+    Container &result, ByteContainerOrViewType &buffer_with_input_bytes,
+    VectorInsertElementLambda &&vector_insert_element_lambda,
+    const ReadaheadOptions &options, ProgressLambda &&progress_lambda)
+    -> picklejar::optional<Container> {
+  element_prefetcher prefetcher{};
+  bool prefetcher_started{false};
+  return deep_read_vector_from_buffer_view<Version>(
+      result, buffer_with_input_bytes,
+      [&](Container &_result, ByteSpanWithCounter &byte_span) {
+        // the counter is already past the element the lambda gets
+        const size_t counter = buffer_with_input_bytes.byte_counter.value();
+        if (options.prefetch_distance > 0) {
+          if (!prefetcher_started) {
+            const char *begin = buffer_with_input_bytes.byte_data.data();
+            prefetcher = {begin + counter,
+                          begin + buffer_with_input_bytes.size()};
+            for (size_t i{1}; i < options.prefetch_distance; ++i)
+              prefetcher.step();
+            prefetcher_started = true;
+          }
+          prefetcher.step();
+        }
+        progress_lambda(counter);
+        return vector_insert_element_lambda(_result, byte_span);
+      });
 }
+}  // namespace util
 
-template <IsIterable Container>
-constexpr auto sizeof_unversioned(Container container) -> size_t {
-  static_assert(
-      !IsMapType<Container>,
-      "PICKLEJAR_HELP: You need to use deep_copy functions for map types");
-  PICKLEJAR_CONCEPT(CanBeCopiedEasily<typename Container::value_type>,
-                    TRIVIALLYCOPIABLE_MSG);
-  return container.size() * sizeof(typename Container::value_type);
+// deep_read_vector_from_buffer_view with prefetching, readahead_window is
+// ignored since the buffer is already in memory
+template <size_t Version = 0, class Container,
+          class ByteContainerOrViewType, class VectorInsertElementLambda>
+auto deep_read_vector_from_buffer_view(
+    Container &result, ByteContainerOrViewType &buffer_with_input_bytes,
+    VectorInsertElementLambda &&vector_insert_element_lambda,
+    const ReadaheadOptions &options) -> picklejar::optional<Container> {
+  return util::deep_read_vector_from_buffer_view_with_readahead<Version>(
+      result, buffer_with_input_bytes, vector_insert_element_lambda, options,
+      [](size_t) {});
 }
 
-inline auto sizeof_unversioned(std::string string_to_get_size_of) -> size_t {
-  return /*count bytes to store result of .size() */
-      sizeof(size_t) +
-      /*followed by how many characters our string has*/
-      string_to_get_size_of.size();
+#if defined(PICKLEJAR_HAS_POSIX_IO)
+// A read only private mapping of a whole file, view() can be read with any
+// of the buffer functions. Pages are copy on write, so lambdas that modify
+// their span don't change the file. With copy_on_write false the pages are
+// mapped PROT_READ and writing to them crashes instead.
+class MappedFile {
+  char *mapped_bytes{nullptr};
+  size_t mapped_size{0};
+
+ public:
+  explicit MappedFile(const std::string file_name,
+                      bool copy_on_write = true) {
+    const int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat file_status {};
+    if (fd < 0) return;
+    if (::fstat(fd, &file_status) == 0 && file_status.st_size > 0) {
+      void *address = ::mmap(nullptr, size_t(file_status.st_size),
+                             copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ,
+                             MAP_PRIVATE, fd, 0);
+      if (address != MAP_FAILED) {
+        mapped_bytes = static_cast<char *>(address);
+        mapped_size = size_t(file_status.st_size);
+      }
+    }
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+  }
+  MappedFile(MappedFile &&rhs) noexcept
+      : mapped_bytes{std::exchange(rhs.mapped_bytes, nullptr)},
+        mapped_size{std::exchange(rhs.mapped_size, 0)} {}
+  auto operator=(MappedFile &&rhs) noexcept -> MappedFile & {
+    std::swap(mapped_bytes, rhs.mapped_bytes);
+    std::swap(mapped_size, rhs.mapped_size);
+    return *this;
+  }
+  MappedFile(const MappedFile &) = delete;
+  auto operator=(const MappedFile &) -> MappedFile & = delete;
+  ~MappedFile() {
+    if (mapped_bytes != nullptr) ::munmap(mapped_bytes, mapped_size);
+  }
+
+  [[nodiscard]] auto good() const -> bool { return mapped_bytes != nullptr; }
+  [[nodiscard]] auto data() const -> char * { return mapped_bytes; }
+  [[nodiscard]] auto size() const -> size_t { return mapped_size; }
+  [[nodiscard]] auto view() const -> ByteSpanWithCounter {
+    return ByteSpanWithCounter{mapped_bytes, mapped_size};
+  }
+  // madvise over [offset, offset + size), offset is rounded down to a page
+  auto advise(size_t offset, size_t size, int advice) const -> bool {
+    if (!good() || offset >= mapped_size) return false;
+    static const auto page_size = size_t(::sysconf(_SC_PAGESIZE));
+    const size_t page_offset = offset / page_size * page_size;
+    size = std::min(size + (offset - page_offset), mapped_size - page_offset);
+    return ::madvise(mapped_bytes + page_offset, size, advice) == 0;
+  }
+};
+
+// maps the file and reads it in place with the ReadaheadOptions hints, the
+// spans given to the lambda point into the mapping, which is gone once this
+// returns
+template <size_t Version = 0, class Container,
+          class VectorInsertElementLambda>
+auto deep_read_vector_from_mapped_file(
+    Container &result, const std::string file_name,
+    VectorInsertElementLambda &&vector_insert_element_lambda,
+    const ReadaheadOptions &options = {}) -> picklejar::optional<Container> {
+  const MappedFile mapped_file{file_name};
+  if (!mapped_file.good()) return {};
+  mapped_file.advise(0, mapped_file.size(), MADV_SEQUENTIAL);
+  size_t advised_end{0};
+  auto &&readahead_lambda = [&](size_t offset) {
+    if (options.readahead_window == 0 ||
+        offset + options.readahead_window / 2 < advised_end)
+      return;
+    mapped_file.advise(offset, options.readahead_window, MADV_WILLNEED);
+    advised_end = offset + options.readahead_window;
+  };
+  readahead_lambda(0);
+  auto buffer = mapped_file.view();
+  return util::deep_read_vector_from_buffer_view_with_readahead<Version>(
+      result, buffer, vector_insert_element_lambda, options, readahead_lambda);
+}
+#endif
+// END READAHEAD
+
+// START BACKGROUND WRITER
+// BackgroundSink<Sink> is a sink that hands full buffers to its own I/O
+// thread, which writes them to the wrapped Sink, so the caller keeps encoding
+// the next buffer while the previous one is written. At most
+// max_queued_buffers full buffers wait for the I/O thread, past that write()
+// blocks until one is written (backpressure), so memory stays bounded to
+// (max_queued_buffers + 2) * buffer_size. The I/O thread is the only one that
+// touches the wrapped sink, which is closed once every buffer is written.
+// Ex:
+//   auto writer = picklejar::deep_copy_vector_to_file_in_background<1>(
+//       vec, "snapshot", size_getter_lambda, write_element_lambda);
+//   ... serve requests, writer.bytes_written() tells how far the dump is
+//   bool success = writer.wait();
+struct BackgroundWriteOptions {
+  size_t buffer_size{size_t{4} << 20};
+  size_t max_queued_buffers{2};
+};
+
+template <class Sink>
+class BackgroundSink {
+  struct shared_state {
+    Sink sink;
+    BackgroundWriteOptions options;
+    std::mutex mutex{};
+    std::condition_variable condition{};
+    std::deque<std::vector<char>> queued_buffers{};
+    std::vector<std::vector<char>> free_buffers{};
+    std::vector<char> current_buffer{};
+    std::atomic<size_t> bytes_encoded{0};
+    std::atomic<size_t> bytes_written{0};
+    std::atomic<bool> failed{false};
+    bool finished{false};
+    std::thread io_thread{};
+
+    template <class... SinkArguments>
+    explicit shared_state(BackgroundWriteOptions _options,
+                          SinkArguments &&...sink_arguments)
+        : sink(std::forward<SinkArguments>(sink_arguments)...),
+          options{_options} {}
+  };
+  std::unique_ptr<shared_state> state{};
+
+  static auto io_loop(shared_state &shared) -> void {
+    std::unique_lock lock{shared.mutex};
+    while (true) {
+      shared.condition.wait(lock, [&] {
+        return !shared.queued_buffers.empty() || shared.finished;
+      });
+      if (shared.queued_buffers.empty()) break;
+      std::vector<char> buffer = std::move(shared.queued_buffers.front());
+      shared.queued_buffers.pop_front();
+      lock.unlock();
+      shared.condition.notify_all();
+      if (!shared.failed &&
+          sink_write(shared.sink, buffer.data(), buffer.size())) {
+        shared.bytes_written += buffer.size();
+      } else {
+        shared.failed = true;
+      }
+      buffer.clear();
+      lock.lock();
+      shared.free_buffers.push_back(std::move(buffer));
+    }
+    lock.unlock();
+    if constexpr (requires { shared.sink.close(); }) {
+      if (!shared.sink.close()) shared.failed = true;
+    }
+  }
+
+  // queues the current buffer, waiting while the queue is full
+  auto submit_current_buffer() -> bool {
+    std::unique_lock lock{state->mutex};
+    state->condition.wait(lock, [&] {
+      return state->queued_buffers.size() < state->options.max_queued_buffers ||
+             state->failed;
+    });
+    if (state->failed) return false;
+    state->queued_buffers.push_back(std::move(state->current_buffer));
+    if (state->free_buffers.empty()) {
+      state->current_buffer = {};
+    } else {
+      state->current_buffer = std::move(state->free_buffers.back());
+      state->free_buffers.pop_back();
+    }
+    lock.unlock();
+    state->condition.notify_all();
+    state->current_buffer.reserve(state->options.buffer_size);
+    return true;
+  }
+
+ public:
+  // the rest of the arguments construct the wrapped sink in place
+  template <class... SinkArguments>
+  explicit BackgroundSink(BackgroundWriteOptions options,
+                          SinkArguments &&...sink_arguments)
+      : state{std::make_unique<shared_state>(
+            options, std::forward<SinkArguments>(sink_arguments)...)} {
+    PICKLEJAR_CONCEPT(PickleJarSink<Sink>, PICKLEJARSINK_MSG);
+    state->options.buffer_size = std::max(options.buffer_size, size_t{1});
+    state->options.max_queued_buffers =
+        std::max(options.max_queued_buffers, size_t{1});
+    if constexpr (requires { state->sink.good(); }) {
+      state->failed = !state->sink.good();
+    }
+    state->current_buffer.reserve(state->options.buffer_size);
+    state->io_thread = std::thread{io_loop, std::ref(*state)};
+  }
+  BackgroundSink(BackgroundSink &&) noexcept = default;
+  auto operator=(BackgroundSink &&rhs) noexcept -> BackgroundSink & {
+    wait();
+    state = std::move(rhs.state);
+    return *this;
+  }
+  BackgroundSink(const BackgroundSink &) = delete;
+  auto operator=(const BackgroundSink &) -> BackgroundSink & = delete;
+  ~BackgroundSink() { wait(); }
+
+  auto write(const char *bytes, size_t size) -> bool {
+    if (!state || state->finished || state->failed) return false;
+    state->bytes_encoded += size;
+    while (size > 0) {
+      const size_t bytes_to_copy = std::min(
+          size, state->options.buffer_size - state->current_buffer.size());
+      state->current_buffer.insert(state->current_buffer.end(), bytes,
+                                   bytes + bytes_to_copy);
+      bytes += bytes_to_copy;
+      size -= bytes_to_copy;
+      if (state->current_buffer.size() == state->options.buffer_size &&
+          !submit_current_buffer())
+        return false;
+    }
+    return true;
+  }
+  // bytes given to write(), which is the sink position
+  [[nodiscard]] auto position() const -> size_t {
+    return state ? state->bytes_encoded.load() : 0;
+  }
+  [[nodiscard]] auto bytes_encoded() const -> size_t { return position(); }
+  // bytes the I/O thread has written to the wrapped sink so far
+  [[nodiscard]] auto bytes_written() const -> size_t {
+    return state ? state->bytes_written.load() : 0;
+  }
+  [[nodiscard]] auto good() const -> bool { return state && !state->failed; }
+  // queues what is left in the current buffer and lets the I/O thread finish
+  // without waiting for it, further writes fail
+  auto finish() -> void {
+    if (!state || state->finished) return;
+    if (!state->current_buffer.empty()) submit_current_buffer();
+    {
+      std::lock_guard lock{state->mutex};
+      state->finished = true;
+    }
+    state->condition.notify_all();
+  }
+  // the queued buffers are dropped instead of written and wait() fails
+  auto cancel() -> void {
+    if (!state) return;
+    {
+      std::lock_guard lock{state->mutex};
+      state->failed = true;
+    }
+    state->condition.notify_all();
+  }
+  // finishes and joins the I/O thread, true if every byte was written and the
+  // wrapped sink closed without errors
+  auto wait() -> bool {
+    if (!state) return false;
+    finish();
+    if (state->io_thread.joinable()) state->io_thread.join();
+    return !state->failed;
+  }
+};
+
+#if defined(PICKLEJAR_HAS_POSIX_IO)
+using BackgroundFileSink = BackgroundSink<FdSink>;
+#else
+using BackgroundFileSink = BackgroundSink<CFileSink>;
+#endif
+
+// encodes on the calling thread while the I/O thread writes, the returned
+// writer is already finished, call wait() on it before using the file
+template <size_t Version = 0, class Container, class WriteElementLambda,
+          class ElementSizeGetterLambda>
+auto deep_copy_vector_to_file_in_background(
+    const Container &vector_input_data, const std::string file_name,
+    ElementSizeGetterLambda &&element_size_getter_lambda,
+    WriteElementLambda &&write_element_lambda,
+    BackgroundWriteOptions options = {}) -> BackgroundFileSink {
+  BackgroundFileSink background_sink{options, file_name};
+  if (!deep_copy_vector_to_sink<Version>(vector_input_data, background_sink,
+                                         element_size_getter_lambda,
+                                         write_element_lambda))
+    background_sink.cancel();
+  background_sink.finish();
+  return background_sink;
+}
+// END BACKGROUND WRITER
+
+// START PIPELINED READER
+// deep_read_vector_pipelined_from_file/_from_source split a deep read into
+// stages on their own threads, connected by lock-free single producer single
+// consumer rings (util::spsc_ring):
+// 1. I/O: reads block_size blocks from the source, blocks are recycled
+// 2. framing: splits the blocks into elements using their size headers and
+//    packs them into batches of about batch_size bytes
+// 3. decode: runs vector_insert_element_lambda on every element of a batch.
+//    With decode_workers == 0 it runs on the calling thread straight into
+//    result. With N workers the framing stage deals batches round robin to
+//    them, each worker decodes into a container of its own and the calling
+//    thread appends those containers in the same round robin order, so the
+//    result is in file order. The lambda is then called from several threads
+//    at once, each time with a different container.
+// The lambda can take a ByteSpanWithCounter (no copy) or a
+// ByteVectorWithCounter like the one given to deep_read_vector_from_file.
+// Bytes after the deep copied vector are ignored, the I/O stage stops once
+// the framing stage is done, but it may have read some of them already so
+// the position of the source afterwards is not specified.
+struct PipelineOptions {
+  size_t block_size{size_t{4} << 20};
+  size_t batch_size{size_t{256} << 10};
+  size_t decode_workers{0};
+  size_t ring_capacity{8};  // slots of every ring, rounded to a power of 2
+};
+
+namespace util {
+// waits a little longer every time a stage finds its ring full or empty
+struct pipeline_backoff {
+  size_t rounds{0};
+  auto pause() -> void {
+    if (++rounds < 64) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(
+          std::chrono::microseconds(std::min(rounds, size_t{200})));
+    }
+  }
+};
+
+template <class Type>
+class spsc_ring {
+  std::vector<Type> slots;
+  size_t mask;
+  alignas(64) std::atomic<size_t> head{0};  // only written by the consumer
+  alignas(64) std::atomic<size_t> tail{0};  // only written by the producer
+  std::atomic<bool> closed{false};
+  std::atomic<bool> abandoned{false};
+
+ public:
+  explicit spsc_ring(size_t capacity)
+      : slots(std::bit_ceil(std::max(capacity, size_t{2}))),
+        mask{slots.size() - 1} {}
+
+  // value is only moved from when it returns true
+  auto try_push(Type &value) -> bool {
+    const size_t current_tail = tail.load(std::memory_order_relaxed);
+    if (current_tail - head.load(std::memory_order_acquire) == slots.size())
+      return false;
+    slots[current_tail & mask] = std::move(value);
+    tail.store(current_tail + 1, std::memory_order_release);
+    return true;
+  }
+  auto try_pop(Type &value) -> bool {
+    const size_t current_head = head.load(std::memory_order_relaxed);
+    if (current_head == tail.load(std::memory_order_acquire)) return false;
+    value = std::move(slots[current_head & mask]);
+    head.store(current_head + 1, std::memory_order_release);
+    return true;
+  }
+  // the blocking versions give up once failed is set, push also returns
+  // false when the consumer abandoned the ring and pop when the producer
+  // closed it and it is empty
+  auto push(Type &value, const std::atomic<bool> &failed) -> bool {
+    pipeline_backoff backoff{};
+    while (!try_push(value)) {
+      if (failed || abandoned.load(std::memory_order_acquire)) return false;
+      backoff.pause();
+    }
+    return true;
+  }
+  auto pop(Type &value, const std::atomic<bool> &failed) -> bool {
+    pipeline_backoff backoff{};
+    while (!try_pop(value)) {
+      if (failed) return false;
+      if (closed.load(std::memory_order_acquire)) return try_pop(value);
+      backoff.pause();
+    }
+    return true;
+  }
+  auto close() -> void { closed.store(true, std::memory_order_release); }
+  // the consumer won't pop anymore
+  auto abandon() -> void { abandoned.store(true, std::memory_order_release); }
+  [[nodiscard]] auto is_abandoned() const -> bool {
+    return abandoned.load(std::memory_order_acquire);
+  }
+};
+
+// joins the stages on every way out of the calling thread, if it leaves
+// early (Ex: an exception from reserve or the lambda) failed is set first so
+// no stage keeps waiting on a ring
+struct pipeline_threads {
+  std::atomic<bool> &failed;
+  std::vector<std::thread> threads{};
+
+  explicit pipeline_threads(std::atomic<bool> &_failed) : failed{_failed} {}
+  pipeline_threads(const pipeline_threads &) = delete;
+  auto operator=(const pipeline_threads &) -> pipeline_threads & = delete;
+  ~pipeline_threads() {
+    for (const auto &thread : threads)
+      if (thread.joinable()) failed = true;
+    join();
+  }
+  auto join() -> void {
+    for (auto &thread : threads)
+      if (thread.joinable()) thread.join();
+  }
+};
+
+struct pipeline_block {
+  std::unique_ptr<char[]> bytes{};  // NOLINT
+  size_t size{0};
+};
+
+struct pipeline_batch {
+  std::unique_ptr<char[]> bytes{};  // NOLINT
+  size_t capacity{0};
+  size_t size{0};
+  std::vector<size_t> element_ends{};
+};
+
+// lets the framing stage read the block stream like a source
+struct pipeline_block_reader {
+  spsc_ring<pipeline_block> &blocks;
+  spsc_ring<pipeline_block> &free_blocks;
+  const std::atomic<bool> &failed;
+  pipeline_block block{};
+  size_t position{0};
+
+  auto read(char *destination, size_t size) -> bool {
+    while (size > 0) {
+      if (position == block.size) {
+        // give the block back to the I/O stage, or drop it if its ring is full
+        if (block.bytes) free_blocks.try_push(block);
+        if (!blocks.pop(block, failed)) return false;
+        position = 0;
+        continue;
+      }
+      const size_t bytes_to_copy = std::min(size, block.size - position);
+      std::memcpy(destination, block.bytes.get() + position, bytes_to_copy);
+      position += bytes_to_copy;
+      destination += bytes_to_copy;
+      size -= bytes_to_copy;
+    }
+    return true;
+  }
+};
+
+template <class Container, class VectorInsertElementLambda>
+auto decode_pipeline_batch(
+    Container &result, pipeline_batch &batch,
+    VectorInsertElementLambda &vector_insert_element_lambda) -> bool {
+  size_t element_begin{0};
+  for (const size_t element_end : batch.element_ends) {
+    // named like in read_object_deep_copy for the runtime message
+    const std::optional<size_t> optional_size{element_end - element_begin};
+    char *element_bytes = batch.bytes.get() + element_begin;
+    element_begin = element_end;
+    auto &&insert_element = [&](auto &byte_buffer) {
+      if (!vector_insert_element_lambda(result, byte_buffer)) return false;
+      if (!byte_buffer.invalid() &&
+          optional_size.value() != byte_buffer.byte_counter.value()) {
+        PICKLEJAR_ASSERT(
+            optional_size.value() == byte_buffer.byte_counter.value(),
+            PICKLEJAR_RUNTIME_READSIZE_MISSMATCH);
+      }
+      return true;
+    };
+    if constexpr (PickleJarVectorInsertElementSpanLambdaRequirements<
+                      VectorInsertElementLambda, Container>) {
+      ByteSpanWithCounter byte_span{element_bytes, optional_size.value()};
+      if (!insert_element(byte_span)) return false;
+    } else {
+      ByteVectorWithCounter byte_buffer{
+          element_bytes, element_bytes + optional_size.value()};
+      if (!insert_element(byte_buffer)) return false;
+    }
+  }
+  return true;
+}
+
+template <class Container>
+auto append_container(Container &result, Container &&elements) -> void {
+  if constexpr (requires {
+                  result.insert(result.end(),
+                                std::make_move_iterator(elements.begin()),
+                                std::make_move_iterator(elements.end()));
+                }) {
+    result.insert(result.end(), std::make_move_iterator(elements.begin()),
+                  std::make_move_iterator(elements.end()));
+  } else {
+    result.insert(std::make_move_iterator(elements.begin()),
+                  std::make_move_iterator(elements.end()));
+  }
+}
+}  // namespace util
+
+template <size_t Version = 0, class Container, class Source,
+          class VectorInsertElementLambda>
+auto deep_read_vector_pipelined_from_source(
+    Container &result, Source &source,
+    VectorInsertElementLambda &&vector_insert_element_lambda,
+    PipelineOptions options = {}) -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(PickleJarSizedSource<Source>, PICKLEJARSIZEDSOURCE_MSG);
+  PICKLEJAR_CONCEPT(
+      (PickleJarVectorInsertElementSpanLambdaRequirements<
+           VectorInsertElementLambda, Container> ||
+       PickleJarVectorInsertElementLambdaRequirements<VectorInsertElementLambda,
+                                                      Container>),
+      VECTORINSERTELEMENTSPANLAMBDAREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+  options.block_size = std::max(options.block_size, size_t{1});
+  const size_t source_size = source_size_remaining(source);
+  const size_t worker_count = options.decode_workers;
+  const size_t result_initial_size{result.size()};
+
+  std::atomic<bool> failed{false};
+  std::atomic<size_t> element_count{0};
+  util::spsc_ring<util::pipeline_block> blocks{options.ring_capacity};
+  util::spsc_ring<util::pipeline_block> free_blocks{options.ring_capacity};
+  std::deque<util::spsc_ring<util::pipeline_batch>> batch_rings{};
+  std::deque<util::spsc_ring<Container>> decoded_rings{};
+  for (size_t i{0}; i < std::max(worker_count, size_t{1}); ++i)
+    batch_rings.emplace_back(options.ring_capacity);
+  for (size_t i{0}; i < worker_count; ++i)
+    decoded_rings.emplace_back(options.ring_capacity);
+
+  util::pipeline_threads stages{failed};
+  stages.threads.reserve(worker_count + 2);
+  stages.threads.emplace_back([&] {
+    size_t remaining_bytes{source_size};
+    while (remaining_bytes > 0 && !failed && !blocks.is_abandoned()) {
+      util::pipeline_block block{};
+      if (!free_blocks.try_pop(block))
+        block.bytes.reset(new char[options.block_size]);  // NOLINT
+      block.size = std::min(options.block_size, remaining_bytes);
+      if (!source_read(source, block.bytes.get(), block.size)) {
+        failed = true;
+        break;
+      }
+      remaining_bytes -= block.size;
+      if (!blocks.push(block, failed)) break;
+    }
+    blocks.close();
+  });
+
+  stages.threads.emplace_back([&] {
+    util::pipeline_block_reader reader{blocks, free_blocks, failed};
+    auto &&read_size = [&](size_t &value) {
+      return reader.read(reinterpret_cast<char *>(&value),  // NOLINT
+                         sizeof(size_t));
+    };
+    size_t next_ring{0};
+    util::pipeline_batch batch{};
+    auto &&publish_batch = [&] {
+      if (batch.element_ends.empty()) return true;
+      const bool pushed = batch_rings[next_ring].push(batch, failed);
+      next_ring = (next_ring + 1) % batch_rings.size();
+      batch = {};
+      return pushed;
+    };
+    auto &&frame_elements = [&] {
+      if constexpr (Version > 0) {
+        std::optional<size_t> optional_version{0};
+        if (!read_size(optional_version.value())) return false;
+        if (optional_version.value() != Version) {
+          if (PICKLEJAR_ENABLE_VERBOSE_MODE) {
+            PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                              PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+          }
+          return false;
+        }
+      }
+      size_t count{0};
+      if (!read_size(count)) return false;
+      // only used to reserve, a corrupt count fails below when the bytes run
+      // out instead of reserving all the memory it asks for
+      element_count = std::min(count, source_size / sizeof(size_t));
+      for (size_t i{0}; i < count; ++i) {
+        size_t element_size{0};
+        if (!read_size(element_size) || element_size > source_size)
+          return false;
+        if (batch.size + element_size > batch.capacity) {
+          if (!publish_batch()) return false;
+          batch.capacity = std::max(options.batch_size, element_size);
+          batch.bytes.reset(new char[batch.capacity]);  // NOLINT
+        }
+        if (!reader.read(batch.bytes.get() + batch.size, element_size))
+          return false;
+        batch.size += element_size;
+        batch.element_ends.push_back(batch.size);
+      }
+      return publish_batch();
+    };
+    if (!frame_elements()) failed = true;
+    // anything after the vector is left to the I/O stage to drop
+    blocks.abandon();
+    for (auto &batch_ring : batch_rings) batch_ring.close();
+  });
+
+  for (size_t worker{0}; worker < worker_count; ++worker) {
+    stages.threads.emplace_back([&, worker] {
+      util::pipeline_batch batch{};
+      while (batch_rings[worker].pop(batch, failed)) {
+        Container decoded{};
+        if constexpr (requires { Container(result.get_allocator()); }) {
+          decoded = Container(result.get_allocator());
+        }
+        if (!util::decode_pipeline_batch(decoded, batch,
+                                         vector_insert_element_lambda) ||
+            !decoded_rings[worker].push(decoded, failed)) {
+          failed = true;
+          break;
+        }
+      }
+      decoded_rings[worker].close();
+    });
+  }
+
+  bool reserved{false};
+  auto &&reserve_result = [&] {
+    if constexpr (ContainerHasReserve<Container>) {
+      // the framing stage stores the count before publishing any batch
+      if (!reserved) result.reserve(result.size() + element_count.load());
+    }
+    reserved = true;
+  };
+  if (worker_count == 0) {
+    util::pipeline_batch batch{};
+    while (batch_rings[0].pop(batch, failed)) {
+      reserve_result();
+      if (!util::decode_pipeline_batch(result, batch,
+                                       vector_insert_element_lambda)) {
+        failed = true;
+        break;
+      }
+    }
+  } else {
+    Container decoded{};
+    for (size_t worker{0}; decoded_rings[worker].pop(decoded, failed);
+         worker = (worker + 1) % worker_count) {
+      reserve_result();
+      util::append_container(result, std::move(decoded));
+    }
+  }
+
+  stages.join();
+  if (!failed && result.size() > result_initial_size) {
+    return PICKLEJAR_MAKE_OPTIONAL(result);
+  }
+  return {};
+}
+
+template <size_t Version = 0, class Container,
+          class VectorInsertElementLambda>
+auto deep_read_vector_pipelined_from_file(
+    Container &result, const std::string file_name,
+    VectorInsertElementLambda &&vector_insert_element_lambda,
+    PipelineOptions options = {}) -> picklejar::optional<Container> {
+#if defined(PICKLEJAR_HAS_POSIX_IO)
+  // the blocks are bigger than its buffer, so reads go straight to pread
+  FdSource source{file_name};
+  if (!source.good()) return {};
+#else
+  std::ifstream source(file_name, std::ios::binary);
+  if (!source.is_open()) return {};
+#endif
+  return deep_read_vector_pipelined_from_source<Version>(
+      result, source, vector_insert_element_lambda, options);
+}
+// END PIPELINED READER
+
+// START PARALLEL READ
+// read_vector_from_file_parallel<Type> reads a file written with
+// write_vector_to_file using several threads. The destination is sized once,
+// the file is cut into chunks of whole elements and every thread claims the
+// next unread chunk with an atomic counter, so faster threads simply take more
+// chunks, and preads it straight into its final place in the container.
+// The v2 overload applies a ManipulateBytesLambda to every element, in
+// parallel too: each thread preads its chunk into a scratch buffer and calls
+// the lambda on the already default constructed elements of its chunk, so
+// the lambda has to be safe to call from several threads at once.
+// thread_count 0 uses std::thread::hardware_concurrency().
+#if defined(PICKLEJAR_HAS_POSIX_IO)
+namespace util {
+constexpr size_t parallel_read_chunk_size = size_t{4} << 20;
+
+// chunk_lambda(first_element, element_count) runs on thread_count threads
+// until every chunk is claimed or one of them returns false
+template <class Type, class ChunkLambda>
+auto run_parallel_chunks(size_t element_count, size_t thread_count,
+                         ChunkLambda &&chunk_lambda) -> bool {
+  const size_t elements_per_chunk =
+      std::max(parallel_read_chunk_size / sizeof(Type), size_t{1});
+  const size_t chunk_count =
+      (element_count + elements_per_chunk - 1) / elements_per_chunk;
+  if (thread_count == 0)
+    thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+  thread_count = std::min(thread_count, chunk_count);
+  std::atomic<size_t> next_chunk{0};
+  std::atomic<bool> failed{false};
+  auto &&worker = [&] {
+    for (size_t chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+         chunk < chunk_count && !failed;
+         chunk = next_chunk.fetch_add(1, std::memory_order_relaxed)) {
+      const size_t first_element = chunk * elements_per_chunk;
+      if (!chunk_lambda(first_element,
+                        std::min(elements_per_chunk,
+                                 element_count - first_element)))
+        failed = true;
+    }
+  };
+  std::vector<std::thread> threads{};
+  for (size_t i{1}; i < thread_count; ++i) threads.emplace_back(worker);
+  worker();  // the calling thread is one of them
+  for (auto &thread : threads) thread.join();
+  return !failed;
+}
+
+// number of whole elements in the file, 0 if it can't be read
+template <class Type>
+auto file_element_count(int fd) -> size_t {
+  struct stat file_status {};
+  if (fd < 0 || ::fstat(fd, &file_status) != 0) return 0;
+  return size_t(file_status.st_size) / sizeof(Type);
+}
+}  // namespace util
+
+template <class Type, class Container = std::vector<Type>>
+[[nodiscard]] auto read_vector_from_file_parallel(const std::string file_name,
+                                                  size_t thread_count = 0)
+    -> std::optional<Container> {
+  PICKLEJAR_CONCEPT(TriviallyCopiable<Type>, TRIVIALLYCOPIABLE_MSG);
+  PICKLEJAR_CONCEPT(ContainerHasDataAndSize<Container>,
+                    CONTAINERWITHHASDATAANDSIZE_MSG);
+  const int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+  const size_t element_count = util::file_element_count<Type>(fd);
+  std::optional<Container> result{};
+  if (element_count > 0) {
+    result.emplace();
+    result->resize(element_count);
+    char *destination = reinterpret_cast<char *>(result->data());  // NOLINT
+    if (!util::run_parallel_chunks<Type>(
+            element_count, thread_count,
+            [&](size_t first_element, size_t chunk_element_count) {
+              return util::pread_all(
+                  fd, destination + first_element * sizeof(Type),
+                  chunk_element_count * sizeof(Type),
+                  off_t(first_element * sizeof(Type)));
+            }))
+      result.reset();
+  }
+  if (fd >= 0) ::close(fd);
+  return result;
+}
+
+template <class Type, class Container = std::vector<Type>,
+          class ManipulateBytesLambda>
+[[nodiscard]] auto read_vector_from_file_parallel(
+    const std::string file_name, size_t thread_count,
+    ManipulateBytesLambda
+        &&manipulate_bytes_from_file_before_writing_to_instance_lambda)
+    -> std::optional<Container> {
+  PICKLEJAR_CONCEPT(
+      (PickleJarManipulateBytesLambdaRequirements<ManipulateBytesLambda, Type>),
+      MANIPULATEBYTESLAMBDAREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(DefaultConstructible<Type>, DEFAULTCONSTRUCTIBLE_MSG);
+  const int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+  const size_t element_count = util::file_element_count<Type>(fd);
+  std::optional<Container> result{};
+  if (element_count > 0) {
+    result.emplace();
+    result->resize(element_count);
+    Type *elements = result->data();
+    if (!util::run_parallel_chunks<Type>(
+            element_count, thread_count,
+            [&](size_t first_element, size_t chunk_element_count) {
+              // one scratch buffer per chunk, only the lambda sees these bytes
+              const size_t chunk_bytes = chunk_element_count * sizeof(Type);
+              const auto scratch = std::make_unique<char[]>(chunk_bytes);
+              if (!util::pread_all(fd, scratch.get(), chunk_bytes,
+                                   off_t(first_element * sizeof(Type))))
+                return false;
+              std::array<char, sizeof(Type)> valid_bytes_blank_instance_copy{};
+              std::array<char, sizeof(Type)> bytes_from_file{};
+              for (size_t i{0}; i < chunk_element_count; ++i) {
+                Type &instance = elements[first_element + i];
+                std::memcpy(valid_bytes_blank_instance_copy.data(),
+                            std::addressof(instance), sizeof(Type));
+                std::memcpy(bytes_from_file.data(),
+                            scratch.get() + i * sizeof(Type), sizeof(Type));
+                manipulate_bytes_from_file_before_writing_to_instance_lambda(
+                    instance, valid_bytes_blank_instance_copy,
+                    bytes_from_file);
+              }
+              return true;
+            }))
+      result.reset();
+  }
+  if (fd >= 0) ::close(fd);
+  return result;
+}
+#endif
+// END PARALLEL READ
+
+// START CONCURRENT APPENDER
+// ConcurrentAppender<Version, Sink> lets many threads append deep copied
+// records ([Version][size][bytes], like write_object_deep_copy) to one sink
+// without a lock. The appender owns segment_count segments of segment_size
+// bytes that form one logical byte stream: append() reserves the bytes of its
+// record with a single fetch_add on the stream position, encodes the record in
+// place and adds its size to the segment's committed bytes. A flusher thread
+// writes the segments to the sink in order, each one once all of its records
+// are committed, then recycles it.
+// A record never spans two segments: the one record that crosses the end of a
+// segment seals it where it started and reserves again, and the bytes it
+// wasted are skipped by the flusher, so the sink gets the records back to
+// back. Records bigger than segment_size are rejected.
+// Producers never wait on each other or on the sink, they only wait when all
+// the segments are still waiting for the flusher. Records from different
+// threads are interleaved in reservation order, records from one thread keep
+// their order. Read them back with deep_read_records_from_source.
+// Durability: the flusher sleeps on a condition variable until a segment
+// fills or flush_interval passes. On a timeout it writes the records of the
+// open segment that are complete so far, up to the first one still being
+// encoded, and flushes the sink (Ex: FdSink::flush). So a record is handed to
+// the OS at most about flush_interval after append() returns, even with a
+// slow trickle of records, and a crash of the process loses at most the
+// records of the last interval. Syncing to the disk is left to the sink.
+// Ex:
+//   picklejar::ConcurrentAppender<1, picklejar::FdSink> appender{{}, "log"};
+//   // from any thread
+//   appender.append(event, event_size, write_element_lambda);
+//   // once every producer is done
+//   bool success = appender.close();
+struct ConcurrentAppenderOptions {
+  size_t segment_size{size_t{1} << 20};
+  size_t segment_count{8};  // rounded up to a power of 2
+  std::chrono::milliseconds flush_interval{10};
+};
+
+template <size_t Version, class Sink>
+class ConcurrentAppender {
+  static constexpr size_t not_sealed = std::numeric_limits<size_t>::max();
+
+  struct segment {
+    std::unique_ptr<char[]> bytes{};  // NOLINT
+    // set by the record that crosses into this segment, where data starts
+    std::atomic<size_t> begin{0};
+    // set by the record that reaches or crosses the end, where data ends
+    std::atomic<size_t> end{not_sealed};
+    std::atomic<size_t> committed{0};
+  };
+
+  Sink sink;
+  size_t segment_size;
+  std::chrono::milliseconds flush_interval;
+  std::vector<segment> segments;
+  size_t segment_mask;
+  alignas(64) std::atomic<size_t> stream_position{0};
+  alignas(64) std::atomic<size_t> flushed_segments{0};
+  std::atomic<size_t> appended_records{0};
+  std::atomic<size_t> written_bytes{0};
+  std::atomic<size_t> final_position{not_sealed};
+  std::atomic<bool> failed{false};
+  // only the flusher locks it, producers notify without it and a wakeup
+  // lost that way only delays the flush until the next interval
+  std::mutex flusher_mutex{};
+  std::condition_variable flusher_wakeup{};
+  std::thread flusher_thread{};
+
+  // waits until the segment of this generation is no longer being flushed
+  auto segment_for(size_t generation) -> segment & {
+    util::pipeline_backoff backoff{};
+    while (generation >=
+           flushed_segments.load(std::memory_order_acquire) + segments.size())
+      backoff.pause();
+    return segments[generation & segment_mask];
+  }
+
+  // returns the segment and where the record goes in it
+  auto reserve(size_t record_size) -> std::pair<segment &, char *> {
+    while (true) {
+      const size_t position =
+          stream_position.fetch_add(record_size, std::memory_order_relaxed);
+      const size_t generation = position / segment_size;
+      const size_t offset = position % segment_size;
+      segment &current = segment_for(generation);
+      if (offset + record_size <= segment_size) {
+        if (offset + record_size == segment_size) {
+          current.end.store(segment_size, std::memory_order_release);
+          flusher_wakeup.notify_one();
+        }
+        return {current, current.bytes.get() + offset};
+      }
+      // this record crosses the end of the segment, the next segment starts
+      // after it and this one ends where it began, then try again
+      segment_for(generation + 1)
+          .begin.store(offset + record_size - segment_size,
+                       std::memory_order_relaxed);
+      current.end.store(offset, std::memory_order_release);
+      flusher_wakeup.notify_one();
+    }
+  }
+
+  auto write_to_sink(const char *bytes, size_t size) -> void {
+    if (size == 0 || failed) return;
+    if (sink_write(sink, bytes, size)) {
+      written_bytes += size;
+    } else {
+      failed = true;
+    }
+  }
+
+  // writes the records of the open segment that are complete, flushed is
+  // where the bytes not written yet start
+  auto write_committed_records(segment &current, size_t generation,
+                               size_t begin, size_t &flushed) -> void {
+    // every committed record reserved its bytes before position was read, so
+    // when the committed bytes add up to everything reserved so far there is
+    // no gap left by a record still being encoded
+    const size_t committed = current.committed.load(std::memory_order_acquire);
+    const size_t position = stream_position.load(std::memory_order_acquire);
+    // reserved past the end, the segment is about to be sealed
+    if (position / segment_size != generation) return;
+    const size_t reserved_end = position % segment_size;
+    if (reserved_end <= flushed || committed != reserved_end - begin) return;
+    write_to_sink(current.bytes.get() + flushed, reserved_end - flushed);
+    flushed = reserved_end;
+    if constexpr (requires { sink.flush(); }) {
+      if (!failed && !bool(sink.flush())) failed = true;
+    }
+  }
+
+  auto flush_loop() -> void {
+    std::unique_lock<std::mutex> lock{flusher_mutex};
+    for (size_t generation{0};; ++generation) {
+      segment &current = segments[generation & segment_mask];
+      const size_t begin = current.begin.load(std::memory_order_relaxed);
+      size_t flushed{begin};
+      size_t end{not_sealed};
+      auto &&sealed_or_closing = [&] {
+        return current.end.load(std::memory_order_acquire) != not_sealed ||
+               final_position.load(std::memory_order_acquire) != not_sealed;
+      };
+      while ((end = current.end.load(std::memory_order_acquire)) ==
+             not_sealed) {
+        const size_t last = final_position.load(std::memory_order_acquire);
+        if (last != not_sealed && last / segment_size <= generation) {
+          end = last / segment_size == generation ? last % segment_size : 0;
+          break;
+        }
+        if (!flusher_wakeup.wait_for(lock, flush_interval, sealed_or_closing))
+          write_committed_records(current, generation, begin, flushed);
+      }
+      util::pipeline_backoff backoff{};
+      while (current.committed.load(std::memory_order_acquire) <
+             (end > begin ? end - begin : 0))
+        backoff.pause();
+      if (end > flushed)
+        write_to_sink(current.bytes.get() + flushed, end - flushed);
+      const size_t last = final_position.load(std::memory_order_acquire);
+      current.begin.store(0, std::memory_order_relaxed);
+      current.end.store(not_sealed, std::memory_order_relaxed);
+      current.committed.store(0, std::memory_order_relaxed);
+      flushed_segments.store(generation + 1, std::memory_order_release);
+      if (last != not_sealed && last / segment_size <= generation) break;
+    }
+    if constexpr (requires { sink.close(); }) {
+      if (!sink.close()) failed = true;
+    }
+  }
+
+ public:
+  // the rest of the arguments construct the sink in place, only the flusher
+  // thread uses it
+  template <class... SinkArguments>
+  explicit ConcurrentAppender(ConcurrentAppenderOptions options,
+                              SinkArguments &&...sink_arguments)
+      : sink(std::forward<SinkArguments>(sink_arguments)...),
+        segment_size{std::max(options.segment_size, versioned_size<Version>())},
+        flush_interval{std::max(options.flush_interval,
+                                std::chrono::milliseconds{1})},
+        segments(std::bit_ceil(std::max(options.segment_count, size_t{2}))),
+        segment_mask{segments.size() - 1} {
+    PICKLEJAR_CONCEPT(PickleJarSink<Sink>, PICKLEJARSINK_MSG);
+    for (auto &current : segments)
+      current.bytes.reset(new char[segment_size]);  // NOLINT
+    if constexpr (requires { sink.good(); }) {
+      failed = !sink.good();
+    }
+    flusher_thread = std::thread{[this] { flush_loop(); }};
+  }
+  ConcurrentAppender(const ConcurrentAppender &) = delete;
+  auto operator=(const ConcurrentAppender &) -> ConcurrentAppender & = delete;
+  ~ConcurrentAppender() { close(); }
+
+  // safe to call from any number of threads, but not together with close()
+  template <class Type, class WriteElementLambda>
+  auto append(const Type &object, const size_t object_size,
+              WriteElementLambda &&write_element_lambda) -> bool {
+    PICKLEJAR_CONCEPT((PickleJarWriteLambdaRequirements<
+                          WriteElementLambda, ByteSpanWithCounter, Type>),
+                      WRITELAMBDAREQUIREMENTS_MSG);
+    const size_t record_size = versioned_size<Version>() + object_size;
+    if (failed || record_size > segment_size ||
+        final_position.load(std::memory_order_relaxed) != not_sealed)
+      return false;
+    auto [current, record_bytes] = reserve(record_size);
+    ByteSpanWithCounter record{record_bytes, record_size};
+    // a failed record still has to be committed so the flusher moves on, the
+    // whole appender is marked as failed instead
+    const bool written =
+        write_object_deep_copy<Version, ByteSpanWithCounter,
+                               write_size_to_sink<ByteSpanWithCounter>>(
+            object, object_size, record, write_element_lambda);
+    if (!written) failed = true;
+    current.committed.fetch_add(record_size, std::memory_order_release);
+    if (written) ++appended_records;
+    return written;
+  }
+
+  // waits for every record to be written and closes the sink, no append()
+  // can run at the same time
+  auto close() -> bool {
+    if (!flusher_thread.joinable()) return !failed;
+    final_position.store(stream_position.load(std::memory_order_acquire),
+                         std::memory_order_release);
+    flusher_wakeup.notify_one();
+    flusher_thread.join();
+    return !failed;
+  }
+  [[nodiscard]] auto good() const -> bool { return !failed; }
+  [[nodiscard]] auto records_appended() const -> size_t {
+    return appended_records;
+  }
+  // bytes the flusher has written to the sink so far
+  [[nodiscard]] auto bytes_written() const -> size_t { return written_bytes; }
+};
+
+// reads records written one after the other with write_object_deep_copy or
+// ConcurrentAppender until the source is empty
+template <size_t Version = 0, class Container, class Source,
+          class VectorInsertElementLambda>
+auto deep_read_records_from_source(
+    Container &result, Source &source,
+    VectorInsertElementLambda &&vector_insert_element_lambda)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(PickleJarSizedSource<Source>, PICKLEJARSIZEDSOURCE_MSG);
+  PICKLEJAR_CONCEPT(
+      (PickleJarVectorInsertElementLambdaRequirements<VectorInsertElementLambda,
+                                                      Container>),
+      VECTORINSERTELEMENTLAMBDAREQUIREMENTS_MSG);
+  const size_t result_initial_size{result.size()};
+  while (source_size_remaining(source) > 0) {
+    if (!read_object_deep_copy<Version, Source, read_size_from_source<Source>,
+                               read_from_source<Source>>(
+            source, [&](ByteVectorWithCounter &byte_buffer) {
+              return vector_insert_element_lambda(result, byte_buffer);
+            }))
+      return {};
+  }
+  if (result.size() > result_initial_size) {
+    return PICKLEJAR_MAKE_OPTIONAL(result);
+  }
+  return {};
+}
+// END CONCURRENT APPENDER
+
+// START SNAPSHOT
+// A Snapshot is a deep copied vector file mapped once (PROT_READ) and shared
+// by any number of reader threads. make_snapshot_from_file checks the
+// version and builds an index of where every element starts, after that
+// nothing in the snapshot changes, so copies of it (reference counted, they
+// share the mapping) and the cursors it hands out can be used from any
+// thread without locks: every read is a bounds check and a ByteSpanWithCounter
+// over the mapping, nothing is copied. The spans must only be read from.
+// Ex:
+//   auto optional_snapshot = picklejar::make_snapshot_from_file<1>("data");
+//   // in every reader thread
+//   auto cursor = optional_snapshot->cursor();
+//   while (auto optional_element = cursor.next()) { ... }
+//   auto optional_element = cursor.element(42);  // random access
+#if defined(PICKLEJAR_HAS_POSIX_IO)
+namespace util {
+struct snapshot_state {
+  MappedFile mapped_file;
+  std::vector<size_t> element_offsets{};  // where every size header starts
+};
+
+// takes the state by reference so element reads never touch the reference
+// count, which every reader thread would otherwise fight over
+[[nodiscard]] inline auto snapshot_element(const snapshot_state &state,
+                                           size_t index)
+    -> std::optional<ByteSpanWithCounter> {
+  if (index >= state.element_offsets.size()) return {};
+  char *header = state.mapped_file.data() + state.element_offsets[index];
+  size_t element_size{0};
+  std::memcpy(&element_size, header, sizeof(size_t));
+  return ByteSpanWithCounter{header + sizeof(size_t), element_size};
+}
+}  // namespace util
+
+class SnapshotCursor {
+  std::shared_ptr<const util::snapshot_state> state{};
+  size_t next_index{0};
+
+ public:
+  explicit SnapshotCursor(std::shared_ptr<const util::snapshot_state> _state,
+                          size_t first_index = 0)
+      : state{std::move(_state)}, next_index{first_index} {}
+
+  [[nodiscard]] auto size() const -> size_t {
+    return state->element_offsets.size();
+  }
+  // the bytes of element index, without moving the cursor
+  [[nodiscard]] auto element(size_t index) const
+      -> std::optional<ByteSpanWithCounter> {
+    return util::snapshot_element(*state, index);
+  }
+  // the bytes of the element at the cursor, then moves to the next one
+  auto next() -> std::optional<ByteSpanWithCounter> {
+    auto optional_element = element(next_index);
+    if (optional_element) ++next_index;
+    return optional_element;
+  }
+  auto seek(size_t index) -> void { next_index = index; }
+  [[nodiscard]] auto position() const -> size_t { return next_index; }
+};
+
+class Snapshot {
+  std::shared_ptr<const util::snapshot_state> state{};
+
+ public:
+  explicit Snapshot(std::shared_ptr<const util::snapshot_state> _state)
+      : state{std::move(_state)} {}
+
+  [[nodiscard]] auto size() const -> size_t {
+    return state->element_offsets.size();
+  }
+  [[nodiscard]] auto cursor(size_t first_index = 0) const -> SnapshotCursor {
+    return SnapshotCursor{state, first_index};
+  }
+  [[nodiscard]] auto element(size_t index) const
+      -> std::optional<ByteSpanWithCounter> {
+    return util::snapshot_element(*state, index);
+  }
+  // the whole mapped file
+  [[nodiscard]] auto mapped_file() const -> const MappedFile & {
+    return state->mapped_file;
+  }
+};
+
+template <size_t Version = 0>
+[[nodiscard]] auto make_snapshot_from_file(const std::string file_name)
+    -> std::optional<Snapshot> {
+  auto state = std::make_shared<util::snapshot_state>(
+      util::snapshot_state{MappedFile{file_name, false}});
+  if (!state->mapped_file.good()) return {};
+  // only reads the size headers, readers fault in the pages they use
+  auto buffer = state->mapped_file.view();
+  if constexpr (Version > 0) {
+    auto optional_version = read_object_from_buffer<size_t>(buffer);
+    if (buffer.invalid() or !optional_version or
+        optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and !buffer.invalid() and
+          optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return {};
+    }
+  }
+  auto optional_size = read_object_from_buffer<size_t>(buffer);
+  if (buffer.invalid() or !optional_size or
+      optional_size.value() > buffer.size_remaining() / sizeof(size_t))
+    return {};
+  state->element_offsets.reserve(optional_size.value());
+  for (size_t i{0}; i < optional_size.value(); ++i) {
+    state->element_offsets.push_back(buffer.byte_counter.value());
+    if (!skip_sized_object(buffer)) return {};
+  }
+  return Snapshot{std::move(state)};
+}
+
+// reads up to count elements from the cursor on, like
+// deep_read_vector_from_buffer_view
+template <class Container, class VectorInsertElementLambda>
+auto deep_read_vector_from_snapshot(
+    Container &result, SnapshotCursor &cursor, size_t count,
+    VectorInsertElementLambda &&vector_insert_element_lambda)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT((PickleJarVectorInsertElementSpanLambdaRequirements<
+                        VectorInsertElementLambda, Container>),
+                    VECTORINSERTELEMENTSPANLAMBDAREQUIREMENTS_MSG);
+  const size_t result_initial_size{result.size()};
+  for (size_t i{0}; i < count; ++i) {
+    auto optional_element = cursor.next();
+    if (!optional_element) break;
+    if (!vector_insert_element_lambda(result, optional_element.value()))
+      return {};
+  }
+  if (result.size() > result_initial_size) {
+    return PICKLEJAR_MAKE_OPTIONAL(result);
+  }
+  return {};
+}
+#endif
+// END SNAPSHOT
+
+template <typename C>
+concept IsIterable = requires(C c) {
+  { c.cbegin() } -> std::same_as<typename C::const_iterator>;
+  { c.cend() } -> std::same_as<typename C::const_iterator>;
+  { c.size() } -> std::same_as<size_t>;
+};
+template <typename C>
+concept NotIterable = requires(C c) {
+  requires !IsIterable<C>;
+};
+
+template <typename C>
+concept IsMapType = requires(C c) {
+  requires !std::same_as<typename C::key_type, void>;
+  requires !std::same_as<typename C::mapped_type, void>;
+};
+
+// std::string and std::pmr::string or any other char string with a custom
+// allocator
+template <typename C>
+concept PickleJarStringType = requires {
+  typename C::allocator_type;
+} && std::same_as<C, std::basic_string<char, std::char_traits<char>,
+                                       typename C::allocator_type>>;
+
+// START SIZE_OF
+// size_of<Type, Version> is the number of bytes sizeof_versioned<Version>
+// returns for a Type. For fixed width types (trivially copiable objects and
+// containers whose elements are fixed width) the size of each element is a
+// compile time constant so .get() is O(1), only maps with std::string keys
+// have to walk their elements. Everything is taken by const reference, so
+// measuring a container never copies it.
+template <class Type, size_t Version = 0>
+struct size_of {
+  static constexpr bool fixed_width = true;
+  static constexpr size_t value = versioned_size<Version>() + sizeof(Type);
+  [[nodiscard]] static constexpr auto get(const Type & /*object*/) -> size_t {
+    return value;
+  }
+};
+
+template <class Container, size_t Version>
+requires IsIterable<Container>
+struct size_of<Container, Version> {
+  static constexpr bool fixed_width = false;
+  // every element is deep copied with a size header
+  static constexpr size_t element_width =
+      versioned_size<0>() + sizeof(typename Container::value_type);
+  [[nodiscard]] static constexpr auto get(const Container &container)
+      -> size_t {
+    PICKLEJAR_CONCEPT(CanBeCopiedEasily<typename Container::value_type>,
+                      TRIVIALLYCOPIABLE_MSG);
+    return versioned_size<Version>() + container.size() * element_width;
+  }
+};
+
+template <class Container, size_t Version>
+requires IsIterable<Container> && IsMapType<Container>
+struct size_of<Container, Version> {
+  static constexpr bool fixed_width = false;
+  static constexpr bool fixed_width_elements =
+      !PickleJarStringType<typename Container::key_type>;
+  [[nodiscard]] static constexpr auto get(const Container &container)
+      -> size_t {
+    if constexpr (fixed_width_elements) {
+      PICKLEJAR_CONCEPT(CanBeCopiedEasily<typename Container::key_type>,
+                        TRIVIALLYCOPIABLE_MSG);
+      PICKLEJAR_CONCEPT(CanBeCopiedEasily<typename Container::value_type>,
+                        TRIVIALLYCOPIABLE_MSG);
+      constexpr size_t element_width =
+          versioned_size<0>() + sizeof(typename Container::key_type) +
+          sizeof(typename Container::mapped_type);
+      return versioned_size<Version>() + container.size() * element_width;
+    } else {
+      // if you get a trivially_copiable warning here is because when I wrote
+      // this I assumed the value_type of the map would be trivially copiable,
+      // if that is not the case you will have to copy this function and make
+      // it return the size of what you are writting
+      PICKLEJAR_CONCEPT(CanBeCopiedEasily<typename Container::value_type>,
+                        TRIVIALLYCOPIABLE_MSG);
+      return versioned_size<Version>() +
+             std::transform_reduce(
+                 std::cbegin(container), std::cend(container), size_t{0},
+                 std::plus<>(), [](const auto &map_elem) {
+                   return versioned_size<0>() + sizeof(size_t) +
+                          map_elem.first.size() + sizeof(map_elem.second);
+                 });
+    }
+  }
+};
+
+template <size_t Version = 0, class Object>
+constexpr auto sizeof_versioned(const Object &object) -> size_t {
+  return size_of<Object, Version>::get(object);
+}
+// END SIZE_OF
+
+// START STRING FUNCTIONS
+// Strings are stored as a size_t with the number of characters followed by the
+// characters without a null terminator. write_string takes a string_view so
+// nothing is copied before writing, read_string returns an owned std::string
+// and read_string_view returns a view that borrows the characters from the
+// buffer it was read from (it is only valid while that buffer is alive).
+template <class BufferOrStreamObject>
+auto write_string(std::string_view string_to_write,
+                  BufferOrStreamObject &buffer_or_stream_object) -> bool {
+  PICKLEJAR_CONCEPT(PickleJarSink<BufferOrStreamObject>, PICKLEJARSINK_MSG);
+  // the size of our string first and then the characters
+  return write_size_to_sink(string_to_write.size(), buffer_or_stream_object) &&
+         sink_write(buffer_or_stream_object, string_to_write.data(),
+                    string_to_write.size());
+}
+
+template <class BufferOrStreamObject>
+auto string_write_generic(std::string_view string_to_write,
+                          BufferOrStreamObject &buffer_or_stream_object)
+    -> bool {
+  return write_string(string_to_write, buffer_or_stream_object);
+}
+
+inline auto write_string_to_stream(std::string_view string_to_write,
+                                   std::ofstream &_ofs_output_file) -> bool {
+  return write_string(string_to_write, _ofs_output_file);
+}
+inline auto write_string_to_file(std::string_view string_to_write,
+                                 const std::string file_name) -> bool {
+  std::ofstream _ofs_output_file(file_name);
+  return write_string(string_to_write, _ofs_output_file);
+}
+
+inline auto write_string_to_buffer(
+    std::string_view string_to_write,
+    ByteVectorWithCounter &byte_vector_with_counter) -> bool {
+  return write_string(string_to_write, byte_vector_with_counter);
+}
+
+// borrows the characters from the buffer, no allocation or copy
+template <class ByteContainerOrViewType>
+[[nodiscard]] auto read_string_view(
+    ByteContainerOrViewType &buffer_with_input_bytes)
+    -> std::optional<std::string_view> {
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  ByteCursor cursor{buffer_with_input_bytes};
+  size_t string_size{0};
+  if (!cursor.read(string_size) || !cursor.check(string_size)) {
+    cursor.commit(buffer_with_input_bytes);
+    return {};
+  }
+  std::string_view string_view_result{cursor.data(), string_size};
+  cursor.skip_unchecked(string_size);
+  cursor.commit(buffer_with_input_bytes);
+  return string_view_result;
+}
+
+namespace util {
+// the size comes from the file, so sized sources check it against the bytes
+// left before the string is allocated. Asking a std::ifstream costs two seeks,
+// so short strings, which are cheap to allocate anyway, skip the check there
+template <class BufferOrStreamObject>
+[[nodiscard]] auto string_size_fits(
+    BufferOrStreamObject &buffer_or_stream_object, size_t string_size)
+    -> bool {
+  if constexpr (std::same_as<BufferOrStreamObject, std::ifstream>) {
+    return string_size <= (size_t{64} << 10) ||
+           string_size <= source_size_remaining(buffer_or_stream_object);
+  } else if constexpr (PickleJarSizedSource<BufferOrStreamObject>) {
+    return string_size <= source_size_remaining(buffer_or_stream_object);
+  } else {
+    return true;
+  }
+}
+}  // namespace util
+
+template <class BufferOrStreamObject>
+[[nodiscard]] auto read_string(BufferOrStreamObject &buffer_or_stream_object)
+    -> std::optional<std::string> {
+  PICKLEJAR_CONCEPT(PickleJarSource<BufferOrStreamObject>, PICKLEJARSOURCE_MSG);
+  if constexpr (PickleJarValidByteContainerOrViewType<BufferOrStreamObject>) {
+    auto optional_string_view = read_string_view(buffer_or_stream_object);
+    if (!optional_string_view) return {};
+    return std::string{optional_string_view.value()};
+  } else {
+    auto optional_string_size = read_size_from_source(buffer_or_stream_object);
+    if (!optional_string_size ||
+        !util::string_size_fits(buffer_or_stream_object,
+                                optional_string_size.value()))
+      return {};
+    std::string string_result(optional_string_size.value(), '\0');
+    if (!source_read(buffer_or_stream_object, string_result.data(),
+                     string_result.size()))
+      return {};
+    return string_result;
+  }
+}
+
+// same as read_string but the characters are allocated from memory_resource
+template <class BufferOrStreamObject>
+[[nodiscard]] auto read_string(BufferOrStreamObject &buffer_or_stream_object,
+                               std::pmr::memory_resource *memory_resource)
+    -> std::optional<std::pmr::string> {
+  PICKLEJAR_CONCEPT(PickleJarSource<BufferOrStreamObject>, PICKLEJARSOURCE_MSG);
+  if constexpr (PickleJarValidByteContainerOrViewType<BufferOrStreamObject>) {
+    auto optional_string_view = read_string_view(buffer_or_stream_object);
+    if (!optional_string_view) return {};
+    return std::pmr::string{optional_string_view.value(), memory_resource};
+  } else {
+    auto optional_string_size = read_size_from_source(buffer_or_stream_object);
+    if (!optional_string_size ||
+        !util::string_size_fits(buffer_or_stream_object,
+                                optional_string_size.value()))
+      return {};
+    std::pmr::string string_result(optional_string_size.value(), '\0',
+                                   memory_resource);
+    if (!source_read(buffer_or_stream_object, string_result.data(),
+                     string_result.size()))
+      return {};
+    return string_result;
+  }
+}
+
+inline auto read_string_from_stream(std::ifstream &ifs_input_file)
+    -> std::optional<std::string> {
+  return read_string(ifs_input_file);
+}
+inline auto read_string_from_file(const std::string file_name)
+    -> std::optional<std::string> {
+  std::ifstream ifs_input_file(file_name);
+  return read_string(ifs_input_file);
+}
+template <class ByteContainerOrViewType>
+auto read_string_from_buffer(ByteContainerOrViewType &buffer_with_input_bytes)
+    -> std::optional<std::string> {
+  return read_string(buffer_with_input_bytes);
+}
+// END STRING FUNCTIONS
+
+template <NotIterable Object>
+constexpr auto sizeof_unversioned(const Object & /*object*/) -> size_t {
+  PICKLEJAR_CONCEPT(CanBeCopiedEasily<Object>, TRIVIALLYCOPIABLE_MSG);
+  return sizeof(Object);
+}
+
+template <IsIterable Container>
+constexpr auto sizeof_unversioned(const Container &container) -> size_t {
+  static_assert(
+      !IsMapType<Container>,
+      "PICKLEJAR_HELP: You need to use deep_copy functions for map types");
+  PICKLEJAR_CONCEPT(CanBeCopiedEasily<typename Container::value_type>,
+                    TRIVIALLYCOPIABLE_MSG);
+  return container.size() * sizeof(typename Container::value_type);
+}
+
+inline auto sizeof_unversioned(std::string_view string_to_get_size_of)
+    -> size_t {
+  return /*count bytes to store result of .size() */
+      sizeof(size_t) +
+      /*followed by how many characters our string has*/
+      string_to_get_size_of.size();
+}
+
+inline auto sizeof_unversioned(const std::string &string_to_get_size_of)
+    -> size_t {
+  return sizeof_unversioned(std::string_view{string_to_get_size_of});
+}
+
+// START MAP FUNCTIONS
+// Built-in serializers for std::map, std::set, their unordered versions and
+// flat maps (a sorted std::vector<std::pair<Key, Value>>). They use the deep
+// copy layout: [Version][count] and for each element [size][key][value], so
+// sizeof_versioned gives the size of a map and maps written by hand with
+// write_vector_deep_copy like in versioning_example_2 can be read with them.
+// Keys and values have to be trivially copiable or strings (std::string,
+// std::pmr::string...), pmr containers build their strings with their own
+// memory resource. Keys are
+// always written in sorted order, which lets the read functions build the
+// container without searching: ordered containers insert with an end hint,
+// unordered containers reserve the element count up front, and flat maps are
+// filled with push_back and never need to be sorted. Reading into a non empty
+// map or set merges into it, but a flat map is cleared first because appending
+// to it would leave it unsorted.
+template <typename C>
+concept IsOrderedAssociativeType = requires(C c) {
+  typename C::key_type;
+  typename C::key_compare;
+};
+
+template <typename C>
+concept IsUnorderedAssociativeType = requires(C c) {
+  typename C::key_type;
+  typename C::hasher;
+};
+
+template <typename C>
+concept IsFlatMapType = requires(C c) {
+  requires !requires { typename C::key_type; };
+  typename C::value_type::first_type;
+  typename C::value_type::second_type;
+  c.push_back(std::declval<typename C::value_type>());
+};
+
+template <typename C>
+concept PickleJarMapContainer = IsOrderedAssociativeType<C> ||
+    IsUnorderedAssociativeType<C> || IsFlatMapType<C>;
+
+template <typename C>
+concept PickleJarMapField = TriviallyCopiable<C> || PickleJarStringType<C>;
+
+#define MAPCONTAINER_MSG                                                      \
+  "PICKLEJAR_HELP: The map functions take a std::map, std::set, their "      \
+  "unordered versions or a flat map (std::vector<std::pair<Key, Value>>), " \
+  "and their keys and values need to be trivially copiable or std::string"
+
+namespace util {
+template <class Field>
+constexpr bool map_field_fixed_width = !PickleJarStringType<Field>;
+
+template <class Container>
+struct map_traits {
+  using key_type = typename Container::key_type;
+  static constexpr bool has_mapped_type = IsMapType<Container>;
+  static constexpr bool fixed_width_elements = [] {
+    if constexpr (has_mapped_type) {
+      return map_field_fixed_width<key_type> &&
+             map_field_fixed_width<typename Container::mapped_type>;
+    } else {
+      return map_field_fixed_width<key_type>;
+    }
+  }();
+  static constexpr size_t element_width = [] {
+    if constexpr (has_mapped_type) {
+      return sizeof(key_type) + sizeof(typename Container::mapped_type);
+    } else {
+      return sizeof(key_type);
+    }
+  }();
+  static auto key(const typename Container::value_type &element)
+      -> const key_type & {
+    if constexpr (has_mapped_type) {
+      return element.first;
+    } else {
+      return element;
+    }
+  }
+};
+template <IsFlatMapType Container>
+struct map_traits<Container> {
+  using key_type = typename Container::value_type::first_type;
+  using mapped_type = typename Container::value_type::second_type;
+  static constexpr bool has_mapped_type = true;
+  static constexpr bool fixed_width_elements =
+      map_field_fixed_width<key_type> && map_field_fixed_width<mapped_type>;
+  static constexpr size_t element_width =
+      sizeof(key_type) + sizeof(mapped_type);
+  static auto key(const typename Container::value_type &element)
+      -> const key_type & {
+    return element.first;
+  }
+};
+
+template <class Field>
+constexpr auto map_field_size(const Field &field) -> size_t {
+  if constexpr (PickleJarStringType<Field>) {
+    return sizeof(size_t) + field.size();
+  } else {
+    return sizeof(Field);
+  }
+}
+
+template <class Container>
+constexpr auto map_element_size(
+    const typename Container::value_type &element) -> size_t {
+  if constexpr (map_traits<Container>::has_mapped_type) {
+    return map_field_size(element.first) + map_field_size(element.second);
+  } else {
+    return map_field_size(element);
+  }
+}
+
+template <class Field, class BufferOrStreamObject>
+auto write_map_field(const Field &field,
+                     BufferOrStreamObject &buffer_or_stream_object) -> bool {
+  if constexpr (PickleJarStringType<Field>) {
+    return write_string(field, buffer_or_stream_object);
+  } else {
+    return sink_write(buffer_or_stream_object,
+                      reinterpret_cast<const char *>(&field),  // NOLINT
+                      sizeof(Field));
+  }
+}
+
+// strings are returned as a string_view into element_bytes so the container
+// constructs them in place with its own allocator
+template <class Field, class ByteContainerOrViewType>
+auto read_map_field(ByteContainerOrViewType &element_bytes) {
+  if constexpr (PickleJarStringType<Field>) {
+    return read_string_view(element_bytes);
+  } else {
+    auto optional_field = read_object_from_buffer<Field>(element_bytes);
+    if (element_bytes.invalid()) return std::optional<Field>{};
+    return optional_field;
+  }
+}
+
+// calls element_lambda for every element of the container in key order
+template <class Container, class ElementLambda>
+auto for_each_in_key_order(const Container &container,
+                           ElementLambda &&element_lambda) -> bool {
+  using traits = map_traits<Container>;
+  if constexpr (IsOrderedAssociativeType<Container>) {
+    for (const auto &element : container) {
+      if (!element_lambda(element)) return false;
+    }
+    return true;
+  } else {
+    auto key_less = [](const auto *lhs, const auto *rhs) {
+      return traits::key(*lhs) < traits::key(*rhs);
+    };
+    std::vector<const typename Container::value_type *> sorted_elements{};
+    sorted_elements.reserve(container.size());
+    for (const auto &element : container) sorted_elements.push_back(&element);
+    if (!std::is_sorted(sorted_elements.begin(), sorted_elements.end(),
+                        key_less)) {
+      std::sort(sorted_elements.begin(), sorted_elements.end(), key_less);
+    }
+    for (const auto *element : sorted_elements) {
+      if (!element_lambda(*element)) return false;
+    }
+    return true;
+  }
+}
+
+// parses one [key][value] element and adds it at the end of the container
+template <class Container, class ByteContainerOrViewType>
+auto read_map_element(Container &result,
+                      ByteContainerOrViewType &element_bytes) -> bool {
+  using traits = map_traits<Container>;
+  auto optional_key =
+      read_map_field<typename traits::key_type>(element_bytes);
+  if (!optional_key) return false;
+  if constexpr (traits::has_mapped_type) {
+    using mapped_type = typename Container::value_type::second_type;
+    auto optional_mapped = read_map_field<mapped_type>(element_bytes);
+    if (!optional_mapped) return false;
+    if constexpr (IsOrderedAssociativeType<Container>) {
+      result.emplace_hint(result.end(), std::move(optional_key.value()),
+                          std::move(optional_mapped.value()));
+    } else if constexpr (IsUnorderedAssociativeType<Container>) {
+      result.emplace(std::move(optional_key.value()),
+                     std::move(optional_mapped.value()));
+    } else {
+      result.emplace_back(std::move(optional_key.value()),
+                          std::move(optional_mapped.value()));
+    }
+  } else if constexpr (IsOrderedAssociativeType<Container>) {
+    result.emplace_hint(result.end(), std::move(optional_key.value()));
+  } else {
+    result.emplace(std::move(optional_key.value()));
+  }
+  return true;
+}
+}  // namespace util
+
+template <size_t Version = 0, class Container>
+auto sizeof_map(const Container &map_input_data) -> size_t {
+  PICKLEJAR_CONCEPT(PickleJarMapContainer<Container>, MAPCONTAINER_MSG);
+  if constexpr (util::map_traits<Container>::fixed_width_elements) {
+    constexpr size_t element_width =
+        versioned_size<0>() + util::map_traits<Container>::element_width;
+    return versioned_size<Version>() + map_input_data.size() * element_width;
+  } else {
+    return versioned_size<Version>() +
+           std::transform_reduce(
+               std::cbegin(map_input_data), std::cend(map_input_data),
+               size_t{0}, std::plus<>(), [](const auto &element) {
+                 return versioned_size<0>() +
+                        util::map_element_size<Container>(element);
+               });
+  }
+}
+
+template <size_t Version = 0, class Container, class BufferOrStreamObject>
+auto write_map(const Container &map_input_data,
+               BufferOrStreamObject &buffer_or_stream_object) -> bool {
+  PICKLEJAR_CONCEPT(PickleJarMapContainer<Container>, MAPCONTAINER_MSG);
+  PICKLEJAR_CONCEPT(
+      PickleJarMapField<typename util::map_traits<Container>::key_type>,
+      MAPCONTAINER_MSG);
+  auto &&write_size = [&](size_t size_to_write) {
+    return util::write_map_field(size_to_write, buffer_or_stream_object);
+  };
+  if constexpr (Version > 0) {
+    if (!write_size(Version)) return false;
+  }
+  if (!write_size(map_input_data.size())) return false;
+  return util::for_each_in_key_order(
+      map_input_data, [&](const typename Container::value_type &element) {
+        if (!write_size(util::map_element_size<Container>(element)))
+          return false;
+        if constexpr (util::map_traits<Container>::has_mapped_type) {
+          return util::write_map_field(element.first,
+                                       buffer_or_stream_object) &&
+                 util::write_map_field(element.second,
+                                       buffer_or_stream_object);
+        } else {
+          return util::write_map_field(element, buffer_or_stream_object);
+        }
+      });
+}
+
+template <size_t Version = 0, class Container>
+auto write_map_to_stream(const Container &map_input_data,
+                         std::ofstream &ofs_output_file) -> bool {
+  return write_map<Version>(map_input_data, ofs_output_file);
+}
+
+template <size_t Version = 0, class Container>
+auto write_map_to_file(const Container &map_input_data,
+                       const std::string file_name) -> bool {
+  std::ofstream ofs_output_file(file_name, std::ios::binary);
+  return write_map<Version>(map_input_data, ofs_output_file);
+}
+
+// writes into an existing buffer, use sizeof_map to size it
+template <size_t Version = 0, class Container, class ByteContainerOrViewType>
+auto write_map_to_buffer(const Container &map_input_data,
+                         ByteContainerOrViewType &byte_vector_with_counter)
+    -> bool {
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  return write_map<Version>(map_input_data, byte_vector_with_counter);
+}
+
+// unlike the deep read functions an empty map is a valid result
+template <size_t Version = 0, class Container>
+auto read_map_from_stream(Container &result, std::ifstream &ifs_input_file)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(PickleJarMapContainer<Container>, MAPCONTAINER_MSG);
+  if constexpr (Version > 0) {
+    if (auto optional_version = read_object_from_stream<size_t>(ifs_input_file);
+        !optional_version or optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return {};
+    }
+  }
+  if constexpr (IsFlatMapType<Container>) result.clear();
+  auto optional_count = read_object_from_stream<size_t>(ifs_input_file);
+  if (!optional_count) return {};
+  // the sizes come from the file, so they are checked against the bytes left
+  // before anything is allocated
+  size_t remaining_bytes{util::ifstream_remaining_bytes(ifs_input_file)};
+  if constexpr (ContainerHasReserve<Container>) {
+    result.reserve(result.size() + std::min(optional_count.value(),
+                                            remaining_bytes / sizeof(size_t)));
+  }
+  // one scratch buffer reused for every element
+  ByteVectorWithCounter element_bytes{size_t{0}};
+  for (size_t i{0}; i < optional_count.value(); ++i) {
+    auto optional_size = read_object_from_stream<size_t>(ifs_input_file);
+    if (!optional_size || remaining_bytes < sizeof(size_t) ||
+        optional_size.value() > remaining_bytes - sizeof(size_t))
+      return {};
+    remaining_bytes -= sizeof(size_t) + optional_size.value();
+    element_bytes.byte_data.resize(optional_size.value());
+    element_bytes.set_counter(0);
+    if (!basic_stream_read(ifs_input_file, element_bytes.byte_data.data(),
+                           optional_size.value()) ||
+        !util::read_map_element(result, element_bytes))
+      return {};
+  }
+  return PICKLEJAR_MAKE_OPTIONAL(result);
+}
+
+template <size_t Version = 0, class Container>
+auto read_map_from_file(Container &result, const std::string file_name)
+    -> picklejar::optional<Container> {
+  std::ifstream ifs_input_file(file_name, std::ios::binary);
+  return read_map_from_stream<Version>(result, ifs_input_file);
+}
+
+// reads each element in place through a ByteSpanWithCounter, no copies
+template <size_t Version = 0, class Container, class ByteContainerOrViewType>
+auto read_map_from_buffer(Container &result,
+                          ByteContainerOrViewType &buffer_with_input_bytes)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(PickleJarMapContainer<Container>, MAPCONTAINER_MSG);
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  if constexpr (Version > 0) {
+    auto optional_version =
+        read_object_from_buffer<size_t>(buffer_with_input_bytes);
+    if (buffer_with_input_bytes.invalid() or !optional_version or
+        optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and
+          !buffer_with_input_bytes.invalid() and optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return {};
+    }
+  }
+  if constexpr (IsFlatMapType<Container>) result.clear();
+  auto optional_count =
+      read_object_from_buffer<size_t>(buffer_with_input_bytes);
+  if (buffer_with_input_bytes.invalid() or !optional_count) return {};
+  if constexpr (ContainerHasReserve<Container>) {
+    result.reserve(result.size() +
+                   util::reservable_element_count(buffer_with_input_bytes,
+                                                  optional_count.value()));
+  }
+  for (size_t i{0}; i < optional_count.value(); ++i) {
+    if (!deep_read_object_from_buffer_view<0>(
+            buffer_with_input_bytes, [&](ByteSpanWithCounter &element_bytes) {
+              return util::read_map_element(result, element_bytes);
+            }))
+      return {};
+  }
+  return PICKLEJAR_MAKE_OPTIONAL(result);
+}
+// END MAP FUNCTIONS
+
+// START STRING COLUMN FUNCTIONS
+// Dictionary encoded string columns for containers of strings that repeat a
+// few values many times (status codes, symbol names...). Every distinct string
+// is written once into a dictionary and each element only stores its index in
+// the dictionary as a varint. Layout:
+// [Version][dictionary count][dictionary strings written with write_string]
+// [element count][byte size of the indices][varint indices]
+// Reading from a buffer gives string_views into the dictionary inside the
+// buffer, so equal elements share the same characters and nothing is
+// allocated per element. Reading from a stream or file interns the dictionary
+// into a StringPool you provide and returns string_views into it.
+namespace util {
+// LEB128 varints, 7 bits per byte with the high bit set if more bytes follow
+constexpr size_t max_varint_size = (sizeof(std::uint64_t) * 8 + 6) / 7;
+
+[[nodiscard]] constexpr auto varint_size(std::uint64_t value) -> size_t {
+  size_t varint_bytes{1};
+  while (value >= 0x80) {
+    value >>= 7;
+    ++varint_bytes;
+  }
+  return varint_bytes;
+}
+
+inline auto encode_varint(std::uint64_t value, char *destination) -> size_t {
+  size_t varint_bytes{0};
+  while (value >= 0x80) {
+    destination[varint_bytes++] = char((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  destination[varint_bytes++] = char(value);
+  return varint_bytes;
+}
+
+// advances current past the varint, returns an empty optional if the varint is
+// truncated or longer than max_varint_size
+inline auto decode_varint(const char *&current, const char *end_pos)
+    -> std::optional<std::uint64_t> {
+  std::uint64_t value{0};
+  for (size_t shift{0}; shift < max_varint_size * 7 && current != end_pos;
+       shift += 7) {
+    const auto byte = static_cast<unsigned char>(*current++);
+    value |= std::uint64_t(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+  return {};
+}
+}  // namespace util
+
+// Owns the characters of interned strings, the string_views it returns stay
+// valid for as long as the pool is alive. The same pool can be shared between
+// reads so equal strings from different files share one allocation. Pass a
+// memory resource (Ex: the arena from make_arena_for_file) to allocate the
+// strings from it instead of the default resource.
+class StringPool {
+  std::pmr::deque<std::pmr::string> pooled_strings;
+  std::pmr::unordered_set<std::string_view> pooled_views;
+
+ public:
+  explicit StringPool(std::pmr::memory_resource *memory_resource =
+                          std::pmr::get_default_resource())
+      : pooled_strings{memory_resource}, pooled_views{memory_resource} {}
+
+  auto intern(std::string_view string_to_intern) -> std::string_view {
+    if (auto found = pooled_views.find(string_to_intern);
+        found != pooled_views.end())
+      return *found;
+    // deque never moves its elements, so views into them stay valid
+    std::string_view pooled_view{
+        pooled_strings.emplace_back(string_to_intern)};
+    pooled_views.insert(pooled_view);
+    return pooled_view;
+  }
+  [[nodiscard]] auto size() const -> size_t { return pooled_strings.size(); }
+};
+
+template <typename C>
+concept StringColumnContainer = requires(C c) {
+  requires std::convertible_to<typename C::value_type, std::string_view>;
+  { c.size() } -> std::same_as<typename C::size_type>;
+};
+#define STRINGCOLUMNCONTAINER_MSG                                        \
+  "PICKLEJAR_HELP: string columns need a container of std::string or " \
+  "std::string_view"
+
+// the dictionary and the encoded indices of a string column, computed once
+// so the exact size is known before writing
+struct StringColumnPlan {
+  std::vector<std::string_view> dictionary{};
+  std::vector<char> encoded_indices{};
+  size_t element_count{0};
+
+  template <size_t Version = 0>
+  [[nodiscard]] auto byte_size() const -> size_t {
+    return versioned_size<Version>() +
+           std::transform_reduce(dictionary.cbegin(), dictionary.cend(),
+                                 size_t{0}, std::plus<>(),
+                                 [](std::string_view dictionary_string) {
+                                   return sizeof_unversioned(dictionary_string);
+                                 }) +
+           2 * sizeof(size_t) + encoded_indices.size();
+  }
+};
+
+// the views in the plan point into string_column_input_data
+template <class Container>
+[[nodiscard]] auto make_string_column_plan(
+    const Container &string_column_input_data) -> StringColumnPlan {
+  PICKLEJAR_CONCEPT(StringColumnContainer<Container>,
+                    STRINGCOLUMNCONTAINER_MSG);
+  StringColumnPlan plan{};
+  plan.element_count = string_column_input_data.size();
+  std::unordered_map<std::string_view, size_t> dictionary_index{};
+  plan.encoded_indices.resize(plan.element_count * util::max_varint_size);
+  size_t encoded_size{0};
+  for (const auto &element : string_column_input_data) {
+    std::string_view element_view{element};
+    auto [found, inserted] =
+        dictionary_index.try_emplace(element_view, plan.dictionary.size());
+    if (inserted) plan.dictionary.push_back(element_view);
+    encoded_size += util::encode_varint(
+        found->second, plan.encoded_indices.data() + encoded_size);
+  }
+  plan.encoded_indices.resize(encoded_size);
+  return plan;
+}
+
+template <size_t Version = 0, class BufferOrStreamObject>
+auto write_string_column_plan(const StringColumnPlan &plan,
+                              BufferOrStreamObject &buffer_or_stream_object)
+    -> bool {
+  auto &&write_bytes = [&](const char *bytes, size_t size_to_write) {
+    return sink_write(buffer_or_stream_object, bytes, size_to_write);
+  };
+  auto &&write_size = [&](const size_t &size_to_write) {
+    return write_size_to_sink(size_to_write, buffer_or_stream_object);
+  };
+  if constexpr (Version > 0) {
+    if (!write_size(Version)) return false;
+  }
+  if (!write_size(plan.dictionary.size())) return false;
+  for (std::string_view dictionary_string : plan.dictionary) {
+    if (!write_string(dictionary_string, buffer_or_stream_object)) return false;
+  }
+  return write_size(plan.element_count) &&
+         write_size(plan.encoded_indices.size()) &&
+         write_bytes(plan.encoded_indices.data(), plan.encoded_indices.size());
+}
+
+template <size_t Version = 0, class Container>
+auto write_string_column_to_stream(const Container &string_column_input_data,
+                                   std::ofstream &ofs_output_file) -> bool {
+  return write_string_column_plan<Version>(
+      make_string_column_plan(string_column_input_data), ofs_output_file);
+}
+
+template <size_t Version = 0, class Container>
+auto write_string_column_to_file(const Container &string_column_input_data,
+                                 const std::string file_name) -> bool {
+  std::ofstream ofs_output_file(file_name, std::ios::binary);
+  return write_string_column_to_stream<Version>(string_column_input_data,
+                                                ofs_output_file);
+}
+
+// the returned buffer has the exact size of the column
+template <size_t Version = 0, class Container>
+auto write_string_column_to_buffer(const Container &string_column_input_data)
+    -> std::optional<ByteVectorWithCounter> {
+  auto plan = make_string_column_plan(string_column_input_data);
+  std::optional<ByteVectorWithCounter> optional_output_buffer_of_bytes{
+      plan.template byte_size<Version>()};
+  if (!write_string_column_plan<Version>(
+          plan, optional_output_buffer_of_bytes.value()))
+    return {};
+  return optional_output_buffer_of_bytes;
+}
+
+namespace util {
+// decodes element_count varint indices into views of the dictionary
+inline auto decode_string_column_indices(
+    std::vector<std::string_view> &result,
+    const std::vector<std::string_view> &dictionary, size_t element_count,
+    const char *current, const char *end_pos) -> bool {
+  // every index takes at least one byte
+  if (element_count > size_t(end_pos - current)) return false;
+  result.reserve(result.size() + element_count);
+  for (size_t i{0}; i < element_count; ++i) {
+    auto optional_index = decode_varint(current, end_pos);
+    if (!optional_index || optional_index.value() >= dictionary.size())
+      return false;
+    result.push_back(dictionary[optional_index.value()]);
+  }
+  return current == end_pos;
+}
+}  // namespace util
+
+// the string_views point into buffer_with_input_bytes
+template <size_t Version = 0, class ByteContainerOrViewType>
+auto read_string_column_from_buffer(
+    std::vector<std::string_view> &result,
+    ByteContainerOrViewType &buffer_with_input_bytes)
+    -> picklejar::optional<std::vector<std::string_view>> {
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  if constexpr (Version > 0) {
+    auto optional_version =
+        read_object_from_buffer<size_t>(buffer_with_input_bytes);
+    if (buffer_with_input_bytes.invalid() or !optional_version or
+        optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and
+          !buffer_with_input_bytes.invalid() and optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return {};
+    }
+  }
+  auto optional_dictionary_size =
+      read_object_from_buffer<size_t>(buffer_with_input_bytes);
+  if (buffer_with_input_bytes.invalid() or !optional_dictionary_size) return {};
+  // every dictionary string takes at least its size
+  if (optional_dictionary_size.value() >
+      buffer_with_input_bytes.size_remaining() / sizeof(size_t))
+    return {};
+  std::vector<std::string_view> dictionary{};
+  dictionary.reserve(optional_dictionary_size.value());
+  for (size_t i{0}; i < optional_dictionary_size.value(); ++i) {
+    auto optional_dictionary_string =
+        read_string_view(buffer_with_input_bytes);
+    if (!optional_dictionary_string) return {};
+    dictionary.push_back(optional_dictionary_string.value());
+  }
+
+  ByteCursor cursor{buffer_with_input_bytes};
+  size_t element_count{0};
+  size_t indices_size{0};
+  if (!cursor.read(element_count) || !cursor.read(indices_size) ||
+      !cursor.check(indices_size)) {
+    cursor.commit(buffer_with_input_bytes);
+    return {};
+  }
+  const char *indices_begin = cursor.data();
+  cursor.skip_unchecked(indices_size);
+  cursor.commit(buffer_with_input_bytes);
+  if (!util::decode_string_column_indices(result, dictionary, element_count,
+                                          indices_begin,
+                                          indices_begin + indices_size))
+    return {};
+  return PICKLEJAR_MAKE_OPTIONAL(result);
+}
+
+// the string_views point into string_pool
+template <size_t Version = 0>
+auto read_string_column_from_stream(std::vector<std::string_view> &result,
+                                    std::ifstream &ifs_input_file,
+                                    StringPool &string_pool)
+    -> picklejar::optional<std::vector<std::string_view>> {
+  if constexpr (Version > 0) {
+    if (auto optional_version = read_object_from_stream<size_t>(ifs_input_file);
+        !optional_version or optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return {};
+    }
+  }
+  auto optional_dictionary_size =
+      read_object_from_stream<size_t>(ifs_input_file);
+  // the sizes come from the file, so they are checked against the bytes left
+  // before anything is allocated, every dictionary string takes at least its
+  // size
+  size_t remaining_bytes{util::ifstream_remaining_bytes(ifs_input_file)};
+  if (!optional_dictionary_size ||
+      optional_dictionary_size.value() > remaining_bytes / sizeof(size_t))
+    return {};
+  std::vector<std::string_view> dictionary{};
+  std::string dictionary_string{};
+  for (size_t i{0}; i < optional_dictionary_size.value(); ++i) {
+    auto optional_string_size = read_object_from_stream<size_t>(ifs_input_file);
+    if (!optional_string_size || remaining_bytes < sizeof(size_t) ||
+        optional_string_size.value() > remaining_bytes - sizeof(size_t))
+      return {};
+    remaining_bytes -= sizeof(size_t) + optional_string_size.value();
+    // one scratch string reused for every dictionary entry
+    dictionary_string.resize(optional_string_size.value());
+    if (!basic_stream_read(ifs_input_file, dictionary_string.data(),
+                           dictionary_string.size()))
+      return {};
+    dictionary.push_back(string_pool.intern(dictionary_string));
+  }
+  auto optional_element_count = read_object_from_stream<size_t>(ifs_input_file);
+  auto optional_indices_size = read_object_from_stream<size_t>(ifs_input_file);
+  if (!optional_element_count || !optional_indices_size ||
+      remaining_bytes < 2 * sizeof(size_t) ||
+      optional_indices_size.value() > remaining_bytes - 2 * sizeof(size_t))
+    return {};
+  // all the indices are read with a single read call
+  std::vector<char> encoded_indices(optional_indices_size.value());
+  if (!basic_stream_read(ifs_input_file, encoded_indices.data(),
+                         encoded_indices.size()))
+    return {};
+  if (!util::decode_string_column_indices(
+          result, dictionary, optional_element_count.value(),
+          encoded_indices.data(),
+          encoded_indices.data() + encoded_indices.size()))
+    return {};
+  return PICKLEJAR_MAKE_OPTIONAL(result);
+}
+
+template <size_t Version = 0>
+auto read_string_column_from_file(std::vector<std::string_view> &result,
+                                  const std::string file_name,
+                                  StringPool &string_pool)
+    -> picklejar::optional<std::vector<std::string_view>> {
+  std::ifstream ifs_input_file(file_name, std::ios::binary);
+  return read_string_column_from_stream<Version>(result, ifs_input_file,
+                                                 string_pool);
+}
+// END STRING COLUMN FUNCTIONS
+
+// START MEMORY RESOURCES
+// Decoding into std::pmr containers lets a whole object graph be allocated
+// from one arena and freed at once when the arena goes out of scope. The read
+// functions that take the result container as a parameter
+// (read_vector_from_stream/buffer, deep_read_vector_from_*,
+// read_map_from_*...) work with std::pmr containers as they are, just
+// construct the result with the arena. Strings inside pmr maps are built with
+// the map's memory resource, use read_string(source, memory_resource) inside
+// your deep read lambdas. Ex:
+//   auto arena = picklejar::make_arena_for_file("example.data");
+//   std::pmr::vector<std::pmr::string> result{&arena};
+//   picklejar::deep_read_vector_from_file(result, "example.data", lambda);
+// make_arena_for_file returns a monotonic arena whose first block can hold the
+// whole file, it keeps growing if the decoded objects need more than that.
+[[nodiscard]] inline auto arena_size_for_file(const std::string &file_name)
+    -> size_t {
+  std::error_code error_code{};
+  const auto file_size = std::filesystem::file_size(file_name, error_code);
+  return error_code ? 0 : size_t(file_size);
+}
+
+[[nodiscard]] inline auto make_arena_for_file(
+    const std::string &file_name,
+    std::pmr::memory_resource *upstream_resource =
+        std::pmr::get_default_resource())
+    -> std::pmr::monotonic_buffer_resource {
+  // monotonic_buffer_resource needs an initial size greater than 0
+  return std::pmr::monotonic_buffer_resource{
+      std::max<size_t>(arena_size_for_file(file_name), 1), upstream_resource};
+}
+
+template <class ByteContainerOrViewType>
+[[nodiscard]] auto make_arena_for_buffer(
+    const ByteContainerOrViewType &buffer_with_input_bytes,
+    std::pmr::memory_resource *upstream_resource =
+        std::pmr::get_default_resource())
+    -> std::pmr::monotonic_buffer_resource {
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  return std::pmr::monotonic_buffer_resource{
+      std::max<size_t>(buffer_with_input_bytes.size(), 1), upstream_resource};
+}
+
+// same as read_vector_from_file but the vector and its elements are allocated
+// from memory_resource, the whole vector is reserved up front so a monotonic
+// arena doesn't keep the blocks of every reallocation
+template <class Type,
+          class ManagedAlignedCopy = ManagedAlignedCopyDefault<Type>>
+[[nodiscard]] auto read_pmr_vector_from_file(
+    const std::string file_name, std::pmr::memory_resource *memory_resource)
+    -> std::optional<std::pmr::vector<Type>> {
+  PICKLEJAR_CONCEPT(TriviallyCopiable<Type>, TRIVIALLYCOPIABLE_MSG);
+  std::pmr::vector<Type> vector_input_data{memory_resource};
+  vector_input_data.reserve(arena_size_for_file(file_name) / sizeof(Type));
+  std::ifstream ifstream_input_file(file_name, std::ios::in | std::ios::binary);
+  if (ifstream_is_invalid(ifstream_input_file)) {
+    return {};
+  }
+  auto result{read_vector_from_stream<Type, ManagedAlignedCopy>(
+      vector_input_data, ifstream_input_file)};
+  if (ifstream_close_and_check_is_invalid(ifstream_input_file) or !result) {
+    return {};
+  }
+  // moving keeps memory_resource, a copy would use the default resource
+  return std::make_optional(std::move(result.value()));
+}
+// END MEMORY RESOURCES
+
+// START PORTABLE_ENCODING
+// The regular API writes the bytes of an object exactly as they are in memory,
+// so a file written on a little endian machine can't be read on a big endian
+// one, and the size headers depend on the width of size_t. The *_portable
+// functions always write little endian data and 8 byte size headers. On a
+// little endian host they are just the regular memcpy/write functions, on a
+// big endian host arrays are byte swapped with SIMD kernels when available.
+// Only arithmetic and enum types can be byte swapped, for structs write each
+// member with write_object_to_stream_portable or write_object_to_buffer_portable
+constexpr std::endian portable_file_endian = std::endian::little;
+using portable_size_type = std::uint64_t;
+
+template <typename C>
+concept PortableScalar = std::is_arithmetic_v<C> || std::is_enum_v<C>;
+#define PORTABLESCALAR_MSG                                                    \
+  "PICKLEJAR_HELP: The portable functions can only byte swap arithmetic and " \
+  "enum types, write each member of your struct separately"
+
+template <typename Type>
+constexpr bool portable_needs_byteswap =
+    std::endian::native != portable_file_endian && sizeof(Type) > 1;
+
+namespace util {
+template <class Type>
+[[nodiscard]] constexpr auto byteswap_scalar(Type value) -> Type {
+  auto bytes = std::bit_cast<std::array<unsigned char, sizeof(Type)>>(value);
+  for (size_t i{0}; i < sizeof(Type) / 2; ++i) {
+    std::swap(bytes[i], bytes[sizeof(Type) - 1 - i]);
+  }
+  return std::bit_cast<Type>(bytes);
+}
+
+template <size_t ElementSize>
+void byteswap_bytes(unsigned char *data, size_t number_of_elements) {
+  const size_t total_size = number_of_elements * ElementSize;
+  size_t i{0};
+  if constexpr (ElementSize == 2 || ElementSize == 4 || ElementSize == 8) {
+#if defined(__AVX2__) || defined(__SSSE3__)
+    // shuffle mask that reverses the bytes of each element in a 16 byte lane
+    alignas(16) std::array<char, 16> mask_bytes{};
+    for (size_t j{0}; j < 16; ++j) {
+      mask_bytes[j] =
+          char((j / ElementSize) * ElementSize + ElementSize - 1 - j % ElementSize);
+    }
+    const __m128i mask = _mm_load_si128(
+        reinterpret_cast<const __m128i *>(mask_bytes.data()));  // NOLINT
+#endif
+#if defined(__AVX2__)
+    const __m256i mask256 = _mm256_broadcastsi128_si256(mask);
+    for (; i + 32 <= total_size; i += 32) {
+      auto *lane = reinterpret_cast<__m256i *>(data + i);  // NOLINT
+      _mm256_storeu_si256(
+          lane, _mm256_shuffle_epi8(_mm256_loadu_si256(lane), mask256));
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSSE3__)
+    for (; i + 16 <= total_size; i += 16) {
+      auto *lane = reinterpret_cast<__m128i *>(data + i);  // NOLINT
+      _mm_storeu_si128(lane, _mm_shuffle_epi8(_mm_loadu_si128(lane), mask));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= total_size; i += 16) {
+      uint8x16_t lane = vld1q_u8(data + i);
+      if constexpr (ElementSize == 2) {
+        lane = vrev16q_u8(lane);
+      } else if constexpr (ElementSize == 4) {
+        lane = vrev32q_u8(lane);
+      } else {
+        lane = vrev64q_u8(lane);
+      }
+      vst1q_u8(data + i, lane);
+    }
+#endif
+  }
+  // scalar tail, or the whole array if there is no SIMD kernel for this size
+  for (; i < total_size; i += ElementSize) {
+    for (size_t j{0}; j < ElementSize / 2; ++j) {
+      std::swap(data[i + j], data[i + ElementSize - 1 - j]);
+    }
+  }
+}
+
+// reverses the bytes of each element of the array in place
+template <class Type>
+void byteswap_array(Type *data, size_t number_of_elements) {
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  if constexpr (sizeof(Type) > 1) {
+    byteswap_bytes<sizeof(Type)>(
+        reinterpret_cast<unsigned char *>(data),  // NOLINT
+        number_of_elements);
+  }
+}
+}  // namespace util
+
+template <class Type>
+[[nodiscard]] constexpr auto to_portable_order(Type value) -> Type {
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  if constexpr (portable_needs_byteswap<Type>) {
+    return util::byteswap_scalar(value);
+  } else {
+    return value;
+  }
+}
+// swapping is symmetric so reading is the same operation
+template <class Type>
+[[nodiscard]] constexpr auto from_portable_order(Type value) -> Type {
+  return to_portable_order(value);
+}
+
+template <class Type>
+[[nodiscard]] auto write_object_to_stream_portable(
+    const Type &object, std::ofstream &ofs_output_file) -> bool {
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  return write_object_to_stream(to_portable_order(object), ofs_output_file);
+}
+
+template <class Type, class ByteContainerOrViewType>
+[[nodiscard]] auto write_object_to_buffer_portable(
+    const Type &object, ByteContainerOrViewType &byte_vector_with_counter)
+    -> bool {
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  return byte_vector_with_counter.write(to_portable_order(object));
+}
+
+template <class Type>
+[[nodiscard]] auto read_object_from_stream_portable(
+    std::ifstream &ifstream_input_file) -> std::optional<Type> {
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  if (auto optional_object = read_object_from_stream<Type>(ifstream_input_file))
+    return from_portable_order(optional_object.value());
+  return {};
+}
+
+template <class Type, class ByteContainerOrViewType>
+[[nodiscard]] auto read_object_from_buffer_portable(
+    ByteContainerOrViewType &byte_vector_with_counter) -> std::optional<Type> {
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  Type object{};
+  if (!byte_vector_with_counter.read(&object, sizeof(Type))) return {};
+  return from_portable_order(object);
+}
+
+// size headers for the deep copy API, they are always 8 bytes, pass them as
+// the WriteSizeFunction/ReadSizeFunction template parameters, Ex:
+// write_vector_deep_copy<1, std::ofstream,
+//                        picklejar::write_size_portable<std::ofstream>>(...)
+template <class BufferOrStreamObject>
+auto write_size_portable(const size_t &size,
+                         BufferOrStreamObject &buffer_or_stream_object)
+    -> bool {
+  const auto portable_size = to_portable_order(portable_size_type(size));
+  return sink_write(buffer_or_stream_object,
+                    reinterpret_cast<const char *>(&portable_size),  // NOLINT
+                    sizeof(portable_size_type));
+}
+
+template <class BufferOrStreamObject>
+auto read_size_portable(BufferOrStreamObject &buffer_or_stream_object)
+    -> std::optional<size_t> {
+  portable_size_type portable_size{0};
+  if (!source_read(buffer_or_stream_object,
+                   reinterpret_cast<char *>(&portable_size),  // NOLINT
+                   sizeof(portable_size_type)))
+    return {};
+  portable_size = from_portable_order(portable_size);
+  if (portable_size > std::numeric_limits<size_t>::max()) return {};
+  return size_t(portable_size);
+}
+
+template <size_t Version = 0>
+constexpr auto portable_versioned_size() -> size_t {
+  return Version > 0 ? sizeof(portable_size_type) * 2
+                     : sizeof(portable_size_type);
+}
+
+template <class Type>
+auto write_vector_to_stream_portable(const std::vector<Type> &container_of_type,
+                                     std::ofstream &ofs_output_file) -> bool {
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  if constexpr (!portable_needs_byteswap<Type>) {
+    return write_vector_to_stream(container_of_type, ofs_output_file);
+  } else {
+    // swap in chunks so we don't need a copy of the whole vector
+    constexpr size_t chunk_elements{4096};
+    std::vector<Type> chunk(
+        std::min(chunk_elements, container_of_type.size()));
+    for (size_t i{0}; i < container_of_type.size(); i += chunk_elements) {
+      const size_t number_of_elements =
+          std::min(chunk_elements, container_of_type.size() - i);
+      std::memcpy(chunk.data(), container_of_type.data() + i,
+                  number_of_elements * sizeof(Type));
+      util::byteswap_array(chunk.data(), number_of_elements);
+      ofs_output_file.write(
+          reinterpret_cast<const char *>(chunk.data()),  // NOLINT
+          std::streamsize(number_of_elements * sizeof(Type)));
+    }
+    return ofs_output_file.good();
+  }
+}
+
+template <class Type>
+auto write_vector_to_file_portable(const std::vector<Type> &container_of_type,
+                                   const std::string file_name) -> bool {
+  std::ofstream ofs_output_file(
+      file_name, std::ios::out | std::ios::trunc | std::ios::binary);
+  bool result{write_vector_to_stream_portable(container_of_type, ofs_output_file)};
+  ofs_output_file.close();
+  return result;
+}
+
+template <class Type, class ByteContainerOrViewType>
+auto write_vector_to_buffer_portable(
+    const std::vector<Type> &container_of_type,
+    ByteContainerOrViewType &byte_vector_with_counter) -> bool {
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  const size_t vector_byte_size = sizeof(Type) * container_of_type.size();
+  if (byte_vector_with_counter.invalid()) return false;
+  auto *destination = byte_vector_with_counter.current_data_pos();
+  if (!byte_vector_with_counter.write(
+          reinterpret_cast<const char *>(container_of_type.data()),  // NOLINT
+          vector_byte_size))
+    return false;
+  if constexpr (portable_needs_byteswap<Type>) {
+    util::byteswap_bytes<sizeof(Type)>(
+        reinterpret_cast<unsigned char *>(destination),  // NOLINT
+        container_of_type.size());
+  }
+  return true;
+}
+
+// reads every remaining element in a single read and then swaps them in place
+template <class Type, class Container>
+[[nodiscard]] auto read_vector_from_stream_portable(
+    Container &vector_input_data, std::ifstream &ifstream_input_file)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  PICKLEJAR_CONCEPT(ContainerHasDataAndSize<Container>,
+                    CONTAINERWITHHASDATAANDSIZE_MSG);
+  if (ifstream_is_invalid(ifstream_input_file)) {
+    return {};
+  }
+  const size_t number_of_elements =
+      size_t(ifstream_filesize(ifstream_input_file)) / sizeof(Type);
+  if (number_of_elements < 1) return {};
+  const size_t initial_vector_size = vector_input_data.size();
+  vector_input_data.resize(initial_vector_size + number_of_elements);
+  Type *destination = vector_input_data.data() + initial_vector_size;
+  if (!basic_stream_read(ifstream_input_file, destination,
+                         number_of_elements * sizeof(Type))) {
+    vector_input_data.resize(initial_vector_size);
+    return {};
+  }
+  if constexpr (portable_needs_byteswap<Type>) {
+    util::byteswap_array(destination, number_of_elements);
+  }
+  return PICKLEJAR_MAKE_OPTIONAL(vector_input_data);
+}
+
+template <class Type, class Container = std::vector<Type>>
+[[nodiscard]] auto read_vector_from_file_portable(const std::string file_name)
+    -> std::optional<Container> {
+  Container vector_input_data;
+  std::ifstream ifstream_input_file(file_name, std::ios::in | std::ios::binary);
+  if (ifstream_is_invalid(ifstream_input_file)) {
+    return {};
+  }
+  auto result{read_vector_from_stream_portable<Type>(vector_input_data,
+                                                     ifstream_input_file)};
+  if (ifstream_close_and_check_is_invalid(ifstream_input_file) or !result) {
+    return {};
+  }
+  return std::make_optional(RETURN_RESULT_FROM_FILE);
+}
+
+template <class Type, class Container, class ByteContainerOrViewType>
+[[nodiscard]] auto read_vector_from_buffer_portable(
+    Container &vector_input_data,
+    ByteContainerOrViewType &buffer_with_input_bytes)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  PICKLEJAR_CONCEPT(ContainerHasDataAndSize<Container>,
+                    CONTAINERWITHHASDATAANDSIZE_MSG);
+  const size_t number_of_elements =
+      buffer_with_input_bytes.size_remaining() / sizeof(Type);
+  if (number_of_elements < 1) return {};
+  const size_t initial_vector_size = vector_input_data.size();
+  vector_input_data.resize(initial_vector_size + number_of_elements);
+  Type *destination = vector_input_data.data() + initial_vector_size;
+  if (!buffer_with_input_bytes.read(destination,
+                                    number_of_elements * sizeof(Type))) {
+    vector_input_data.resize(initial_vector_size);
+    return {};
+  }
+  if constexpr (portable_needs_byteswap<Type>) {
+    util::byteswap_array(destination, number_of_elements);
+  }
+  return PICKLEJAR_MAKE_OPTIONAL(vector_input_data);
+}
+
+// deep copy API with portable size headers, the element bytes written inside
+// 'write_element_lambda' should use the *_portable object functions too
+template <size_t Version = 0, class Container, class WriteElementLambda,
+          class ElementSizeGetterLambda,
+          typename Type = typename Container::value_type>
+auto deep_copy_vector_to_file_portable(
+    const Container &vector_input_data, const std::string file_name,
+    ElementSizeGetterLambda &&element_size_getter_lambda,
+    WriteElementLambda &&write_element_lambda) -> bool {
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT((PickleJarWriteLambdaRequirements<WriteElementLambda,
+                                                      std::ofstream, Type>),
+                    WRITELAMBDAREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(
+      (PickleJarElementSizeGetterRequirements<ElementSizeGetterLambda, Type>),
+      SIZEGETTERLAMBDAREQUIREMENTS_MSG);
+  std::ofstream ofs_output_file(
+      file_name, std::ios::out | std::ios::trunc | std::ios::binary);
+  return write_vector_deep_copy<Version, std::ofstream,
+                                picklejar::write_size_portable<std::ofstream>>(
+      vector_input_data, ofs_output_file, element_size_getter_lambda,
+      write_element_lambda);
+}
+
+template <size_t Version = 0, class Container,
+          typename Type = typename Container::value_type,
+          class VectorInsertElementLambda>
+auto deep_read_vector_from_file_portable(
+    Container &result, const std::string file_name,
+    VectorInsertElementLambda &&vector_insert_element_lambda)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(
+      (PickleJarVectorInsertElementLambdaRequirements<VectorInsertElementLambda,
+                                                      Container>),
+      VECTORINSERTELEMENTLAMBDAREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+  std::ifstream ifs_input_file(file_name, std::ios::in | std::ios::binary);
+  return read_vector_deep_copy<Version, std::ifstream,
+                               picklejar::read_size_portable<std::ifstream>>(
+      result, ifs_input_file, vector_insert_element_lambda);
+}
+// END PORTABLE_ENCODING
+
+// START FILE_HEADER
+// Optional 64 byte header at the start of a file, it lets readers reject a
+// file that was written with a different Type, Version or layout before
+// decoding anything, and tells them which read path they can use.
+// The type name hash comes from type_name<Type>() so it is only comparable
+// between files written by the same compiler.
+// The header fields are stored in portable (little endian) order, so a reader
+// of the other byte order still gets to the flags that say how the rest of
+// the file was written.
+constexpr std::array<char, 8> file_header_magic{'P', 'C', 'K', 'L',
+                                                'J', 'A', 'R', '\0'};
+constexpr std::uint32_t file_header_format_version{1};
+
+enum FileHeaderFlags : std::uint32_t {
+  file_header_flag_trivially_copiable = 1U << 0U,
+  file_header_flag_little_endian = 1U << 1U,
+  file_header_flag_portable_encoding = 1U << 2U,
+  file_header_flag_deep_copy = 1U << 3U,
+};
+
+struct FileHeader {
+  std::array<char, 8> magic{file_header_magic};
+  std::uint32_t format_version{file_header_format_version};
+  std::uint32_t flags{0};
+  std::uint64_t type_size{0};
+  std::uint64_t type_alignment{0};
+  std::uint64_t type_name_hash{0};
+  std::uint64_t layout_hash{0};
+  std::uint64_t user_version{0};
+  std::uint64_t reserved{0};
+
+  [[nodiscard]] auto has_flag(std::uint32_t flag) const -> bool {
+    return (flags & flag) != 0;
+  }
+};
+static_assert(sizeof(FileHeader) == 64 &&
+                  std::is_trivially_copyable_v<FileHeader>,
+              "FileHeader must be a single 64 byte read");
+
+namespace util {
+// swapping is symmetric, so this converts to and from the stored order
+[[nodiscard]] constexpr auto file_header_in_portable_order(FileHeader header)
+    -> FileHeader {
+  header.format_version = to_portable_order(header.format_version);
+  header.flags = to_portable_order(header.flags);
+  header.type_size = to_portable_order(header.type_size);
+  header.type_alignment = to_portable_order(header.type_alignment);
+  header.type_name_hash = to_portable_order(header.type_name_hash);
+  header.layout_hash = to_portable_order(header.layout_hash);
+  header.user_version = to_portable_order(header.user_version);
+  header.reserved = to_portable_order(header.reserved);
+  return header;
+}
+[[nodiscard]] inline auto file_header_from_portable_order(
+    std::optional<FileHeader> optional_header) -> std::optional<FileHeader> {
+  if (!optional_header) return {};
+  return file_header_in_portable_order(optional_header.value());
+}
+
+// FNV-1a, constexpr so type fingerprints are computed at compile-time
+[[nodiscard]] constexpr auto fnv1a_hash(
+    std::string_view bytes,
+    std::uint64_t hash = 0xcbf29ce484222325ULL) -> std::uint64_t {
+  for (char byte : bytes) {
+    hash ^= std::uint64_t(static_cast<unsigned char>(byte));
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+[[nodiscard]] constexpr auto hash_combine(std::uint64_t hash,
+                                          std::uint64_t value)
+    -> std::uint64_t {
+  return hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6U) + (hash >> 2U));
+}
+}  // namespace util
+
+template <class Type>
+[[nodiscard]] constexpr auto type_name_hash() -> std::uint64_t {
+  return util::fnv1a_hash(type_name<Type>());
+}
+
+// C++20 can't list the members of a struct, so the layout hash is built from
+// the member types you pass, in declaration order. Ex:
+// picklejar::layout_hash<decltype(TrivialStructure::byte2_note_range_start),
+//                        decltype(TrivialStructure::byte2_note_range_end)>()
+template <class... FieldTypes>
+[[nodiscard]] constexpr auto layout_hash() -> std::uint64_t {
+  std::uint64_t hash{util::fnv1a_hash("picklejar_layout")};
+  ((hash = util::hash_combine(
+        util::hash_combine(hash, type_name_hash<FieldTypes>()),
+        sizeof(FieldTypes))),
+   ...);
+  return hash;
+}
+
+// used when you don't pass a layout hash, it only catches changes that affect
+// the size, alignment or copiability of Type
+template <class Type>
+[[nodiscard]] constexpr auto default_layout_hash() -> std::uint64_t {
+  return layout_hash<Type>() ^
+         (std::uint64_t(std::is_trivially_copyable_v<Type>) << 1U) ^
+         (std::uint64_t(std::is_standard_layout_v<Type>) << 2U);
+}
+
+template <class Type, size_t Version = 0>
+[[nodiscard]] constexpr auto make_file_header(
+    std::uint64_t layout = default_layout_hash<Type>(),
+    std::uint32_t extra_flags = 0) -> FileHeader {
+  FileHeader header{};
+  header.flags = extra_flags;
+  if constexpr (std::is_trivially_copyable_v<Type>) {
+    header.flags |= file_header_flag_trivially_copiable;
+  }
+  if constexpr (std::endian::native == std::endian::little) {
+    header.flags |= file_header_flag_little_endian;
+  }
+  header.type_size = sizeof(Type);
+  header.type_alignment = alignof(Type);
+  header.type_name_hash = type_name_hash<Type>();
+  header.layout_hash = layout;
+  header.user_version = Version;
+  return header;
+}
+
+[[nodiscard]] inline auto write_file_header_to_stream(
+    const FileHeader &header, std::ofstream &ofs_output_file) -> bool {
+  return write_object_to_stream(util::file_header_in_portable_order(header),
+                                ofs_output_file);
+}
+
+template <class ByteContainerOrViewType>
+[[nodiscard]] auto write_file_header_to_buffer(
+    const FileHeader &header, ByteContainerOrViewType &byte_vector_with_counter)
+    -> bool {
+  return byte_vector_with_counter.write(
+      util::file_header_in_portable_order(header));
+}
+
+// returns an empty optional if the magic or the library format don't match
+[[nodiscard]] inline auto validate_file_header(
+    std::optional<FileHeader> optional_header) -> std::optional<FileHeader> {
+  if (!optional_header) return {};
+  if (optional_header->magic != file_header_magic) {
+    if (PICKLEJAR_ENABLE_VERBOSE_MODE) {
+      PICKLEJAR_MESSAGE(0, "PICKLEJAR_RUNTIME_MESSAGE: The file doesn't start "
+                           "with a PickleJar file header");
+    }
+    return {};
+  }
+  if (optional_header->format_version != file_header_format_version) {
+    if (PICKLEJAR_ENABLE_VERBOSE_MODE) {
+      PICKLEJAR_MESSAGE(0, "PICKLEJAR_RUNTIME_MESSAGE: The file header format ("
+                               << optional_header->format_version
+                               << ") is not supported by this library ("
+                               << file_header_format_version << ")");
+    }
+    return {};
+  }
+  return optional_header;
+}
+
+[[nodiscard]] inline auto read_file_header_from_stream(
+    std::ifstream &ifstream_input_file) -> std::optional<FileHeader> {
+  return validate_file_header(util::file_header_from_portable_order(
+      read_object_from_stream<FileHeader>(ifstream_input_file)));
+}
+
+[[nodiscard]] inline auto read_file_header_from_file(
+    const std::string file_name) -> std::optional<FileHeader> {
+  std::ifstream ifstream_input_file(file_name, std::ios::in | std::ios::binary);
+  return read_file_header_from_stream(ifstream_input_file);
+}
+
+template <class ByteContainerOrViewType>
+[[nodiscard]] auto read_file_header_from_buffer(
+    ByteContainerOrViewType &byte_vector_with_counter)
+    -> std::optional<FileHeader> {
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  return validate_file_header(util::file_header_from_portable_order(
+      read_object_from_buffer<FileHeader>(byte_vector_with_counter)));
+}
+
+// true if the file was written for this Type, Version and layout
+template <class Type, size_t Version = 0>
+[[nodiscard]] auto file_header_matches(
+    const FileHeader &header,
+    std::uint64_t layout = default_layout_hash<Type>()) -> bool {
+  const FileHeader expected = make_file_header<Type, Version>(layout);
+  const bool matches = header.type_size == expected.type_size &&
+                       header.type_alignment == expected.type_alignment &&
+                       header.type_name_hash == expected.type_name_hash &&
+                       header.layout_hash == expected.layout_hash &&
+                       header.user_version == expected.user_version;
+  if (PICKLEJAR_ENABLE_VERBOSE_MODE) {
+    PICKLEJAR_MESSAGE(
+        matches,
+        "PICKLEJAR_RUNTIME_MESSAGE: The file header doesn't match '"
+            << type_name<Type>() << "' Version (" << Version
+            << "): sizeof " << header.type_size << "/" << expected.type_size
+            << ", alignof " << header.type_alignment << "/"
+            << expected.type_alignment << ", version " << header.user_version
+            << "/" << expected.user_version << ", type or layout hash "
+            << (header.type_name_hash == expected.type_name_hash &&
+                        header.layout_hash == expected.layout_hash
+                    ? "match"
+                    : "differ"));
+  }
+  return matches;
+}
+
+template <class Type, size_t Version = 0>
+auto write_vector_to_file_with_header(
+    const std::vector<Type> &container_of_type, const std::string file_name,
+    std::uint64_t layout = default_layout_hash<Type>()) -> bool {
+  PICKLEJAR_CONCEPT(TriviallyCopiable<Type>, TRIVIALLYCOPIABLE_MSG);
+  std::ofstream ofs_output_file(
+      file_name, std::ios::out | std::ios::trunc | std::ios::binary);
+  if (!write_file_header_to_stream(make_file_header<Type, Version>(layout),
+                                   ofs_output_file))
+    return false;
+  bool result{write_vector_to_stream(container_of_type, ofs_output_file)};
+  ofs_output_file.close();
+  return result;
+}
+
+template <class Type, size_t Version = 0>
+auto write_vector_to_file_with_header_portable(
+    const std::vector<Type> &container_of_type, const std::string file_name,
+    std::uint64_t layout = default_layout_hash<Type>()) -> bool {
+  PICKLEJAR_CONCEPT(PortableScalar<Type>, PORTABLESCALAR_MSG);
+  std::ofstream ofs_output_file(
+      file_name, std::ios::out | std::ios::trunc | std::ios::binary);
+  if (!write_file_header_to_stream(
+          make_file_header<Type, Version>(layout,
+                                          file_header_flag_portable_encoding),
+          ofs_output_file))
+    return false;
+  bool result{
+      write_vector_to_stream_portable(container_of_type, ofs_output_file)};
+  ofs_output_file.close();
+  return result;
+}
+
+// rejects the file after reading only the header if it doesn't match, then
+// picks the read path from the header flags: portable files go through the
+// byte swapping reader, native files of the same byte order are read in bulk
+// with a single read into the presized container
+template <class Type, size_t Version = 0, class Container = std::vector<Type>>
+[[nodiscard]] auto read_vector_from_file_with_header(
+    const std::string file_name,
+    std::uint64_t layout = default_layout_hash<Type>())
+    -> std::optional<Container> {
+  PICKLEJAR_CONCEPT(TriviallyCopiable<Type>, TRIVIALLYCOPIABLE_MSG);
+  PICKLEJAR_CONCEPT(ContainerHasDataAndSize<Container>,
+                    CONTAINERWITHHASDATAANDSIZE_MSG);
+  std::ifstream ifstream_input_file(file_name, std::ios::in | std::ios::binary);
+  if (ifstream_is_invalid(ifstream_input_file)) {
+    return {};
+  }
+  auto optional_header = read_file_header_from_stream(ifstream_input_file);
+  if (!optional_header or
+      !file_header_matches<Type, Version>(optional_header.value(), layout))
+    return {};
+  Container vector_input_data;
+  if (optional_header->has_flag(file_header_flag_portable_encoding)) {
+    if constexpr (PortableScalar<Type>) {
+      auto result{read_vector_from_stream_portable<Type>(vector_input_data,
+                                                         ifstream_input_file)};
+      if (!result) return {};
+      return std::make_optional(RETURN_RESULT_FROM_FILE);
+    } else {
+      return {};
+    }
+  }
+  const bool written_little_endian =
+      optional_header->has_flag(file_header_flag_little_endian);
+  if (written_little_endian != (std::endian::native == std::endian::little) or
+      !optional_header->has_flag(file_header_flag_trivially_copiable)) {
+    if (PICKLEJAR_ENABLE_VERBOSE_MODE) {
+      PICKLEJAR_MESSAGE(0, "PICKLEJAR_RUNTIME_MESSAGE: The file was written "
+                           "with a different byte order, write it with "
+                           "write_vector_to_file_with_header_portable");
+    }
+    return {};
+  }
+  const size_t number_of_elements =
+      size_t(ifstream_filesize(ifstream_input_file)) / sizeof(Type);
+  if (number_of_elements < 1) return {};
+  vector_input_data.resize(number_of_elements);
+  if (!basic_stream_read(ifstream_input_file, vector_input_data.data(),
+                         number_of_elements * sizeof(Type)))
+    return {};
+  return vector_input_data;
+}
+
+template <size_t Version = 0, class Container, class WriteElementLambda,
+          class ElementSizeGetterLambda,
+          typename Type = typename Container::value_type>
+auto deep_copy_vector_to_file_with_header(
+    const Container &vector_input_data, const std::string file_name,
+    ElementSizeGetterLambda &&element_size_getter_lambda,
+    WriteElementLambda &&write_element_lambda,
+    std::uint64_t layout = default_layout_hash<Type>()) -> bool {
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT((PickleJarWriteLambdaRequirements<WriteElementLambda,
+                                                      std::ofstream, Type>),
+                    WRITELAMBDAREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(
+      (PickleJarElementSizeGetterRequirements<ElementSizeGetterLambda, Type>),
+      SIZEGETTERLAMBDAREQUIREMENTS_MSG);
+  std::ofstream ofs_output_file(
+      file_name, std::ios::out | std::ios::trunc | std::ios::binary);
+  if (!write_file_header_to_stream(
+          make_file_header<Type, Version>(layout, file_header_flag_deep_copy),
+          ofs_output_file))
+    return false;
+  return write_vector_deep_copy<Version>(vector_input_data, ofs_output_file,
+                                         element_size_getter_lambda,
+                                         write_element_lambda);
+}
+
+template <size_t Version = 0, class Container,
+          typename Type = typename Container::value_type,
+          class VectorInsertElementLambda>
+auto deep_read_vector_from_file_with_header(
+    Container &result, const std::string file_name,
+    VectorInsertElementLambda &&vector_insert_element_lambda,
+    std::uint64_t layout = default_layout_hash<Type>())
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(
+      (PickleJarVectorInsertElementLambdaRequirements<VectorInsertElementLambda,
+                                                      Container>),
+      VECTORINSERTELEMENTLAMBDAREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+  std::ifstream ifs_input_file(file_name, std::ios::in | std::ios::binary);
+  auto optional_header = read_file_header_from_stream(ifs_input_file);
+  if (!optional_header or
+      !optional_header->has_flag(file_header_flag_deep_copy) or
+      !file_header_matches<Type, Version>(optional_header.value(), layout))
+    return {};
+  return read_vector_deep_copy<Version>(result, ifs_input_file,
+                                        vector_insert_element_lambda);
+}
+// END FILE_HEADER
+
+// START MIGRATION_REGISTRY
+// A MigrationRegistry maps every Version your program still accepts to a
+// 'read_element_lambda' that decodes one element written with that Version,
+// and an 'upgrade_lambda' that converts it into the type of the next
+// registered Version. Reading dispatches on the Version stored in the file and
+// streams each element through the chain of upgrade lambdas straight into the
+// Container of the latest type, in a single pass without intermediate vectors.
+// Steps must be registered from oldest to newest with strictly increasing
+// Versions (checked at compile time), the last step doesn't need an upgrade
+// lambda. Ex:
+//   auto registry = picklejar::make_migration_registry(
+//       picklejar::migration_step<1>(read_v1_element, upgrade_v1_to_v2),
+//       picklejar::migration_step<2>(read_v2_element, upgrade_v2_to_v4),
+//       picklejar::migration_step<4>(read_v4_element));
+//   picklejar::deep_read_vector_with_migrations_from_file(result, file_name,
+//                                                         registry);
+// where read_vN_element is (ByteVectorWithCounter &) -> std::optional<TypeVN>
+// and upgrade_vN_to_vM is (TypeVN &&) -> TypeVM
+struct no_upgrade {
+  template <class Type>
+  auto operator()(Type &&object) const -> std::remove_cvref_t<Type> {
+    return std::forward<Type>(object);
+  }
+};
+
+template <size_t Version, class ReadElementLambda,
+          class UpgradeLambda = no_upgrade>
+struct MigrationStep {
+  static_assert(Version > 0,
+                "PICKLEJAR_HELP: migration steps need a Version greater than 0 "
+                "because unversioned files don't store their Version");
+  static constexpr size_t version = Version;
+  ReadElementLambda read_element_lambda;
+  UpgradeLambda upgrade_lambda;
+};
+
+template <size_t Version, class ReadElementLambda,
+          class UpgradeLambda = no_upgrade>
+[[nodiscard]] constexpr auto migration_step(
+    ReadElementLambda &&read_element_lambda, UpgradeLambda &&upgrade_lambda = {})
+    -> MigrationStep<Version, std::decay_t<ReadElementLambda>,
+                     std::decay_t<UpgradeLambda>> {
+  return {std::forward<ReadElementLambda>(read_element_lambda),
+          std::forward<UpgradeLambda>(upgrade_lambda)};
+}
+
+template <class... Steps>
+class MigrationRegistry {
+  static_assert(sizeof...(Steps) > 0,
+                "PICKLEJAR_HELP: a MigrationRegistry needs at least one step");
+  // latest_version and the upgrade chain follow the order of the steps
+  [[nodiscard]] static constexpr auto versions_strictly_increase() -> bool {
+    constexpr std::array<size_t, sizeof...(Steps)> versions{Steps::version...};
+    for (size_t i{1}; i < versions.size(); ++i)
+      if (versions[i - 1] >= versions[i]) return false;
+    return true;
+  }
+  static_assert(versions_strictly_increase(),
+                "PICKLEJAR_HELP: the migration steps must be registered from "
+                "oldest to newest, each with a different Version");
+  std::tuple<Steps...> steps;
+
+  template <size_t StepIndex, class Object>
+  auto upgrade(Object &&object) {
+    if constexpr (StepIndex + 1 == sizeof...(Steps)) {
+      return std::forward<Object>(object);
+    } else {
+      return upgrade<StepIndex + 1>(
+          std::get<StepIndex>(steps).upgrade_lambda(std::forward<Object>(object)));
+    }
+  }
+
+  template <size_t StepIndex, class BufferOrStreamObject,
+            std::optional<size_t> ReadSizeFunction(BufferOrStreamObject &),
+            bool ReadBufferOrStreamFunction(BufferOrStreamObject &, char *,
+                                            const size_t),
+            class Container>
+  auto read_with_step(Container &result,
+                      BufferOrStreamObject &buffer_or_stream_object)
+      -> picklejar::optional<Container> {
+    return read_vector_deep_copy<0, BufferOrStreamObject, ReadSizeFunction,
+                                 ReadBufferOrStreamFunction>(
+        result, buffer_or_stream_object,
+        [this](Container &_result,
+               ByteVectorWithCounter &byte_vector_with_counter) {
+          auto optional_element =
+              std::get<StepIndex>(steps).read_element_lambda(
+                  byte_vector_with_counter);
+          if (!optional_element) return false;
+          _result.push_back(
+              upgrade<StepIndex>(std::move(optional_element.value())));
+          return true;
+        });
+  }
+
+  template <class BufferOrStreamObject,
+            std::optional<size_t> ReadSizeFunction(BufferOrStreamObject &),
+            bool ReadBufferOrStreamFunction(BufferOrStreamObject &, char *,
+                                            const size_t),
+            class Container, size_t... StepIndex>
+  auto dispatch(size_t version, Container &result,
+                BufferOrStreamObject &buffer_or_stream_object,
+                std::index_sequence<StepIndex...> /*is*/)
+      -> picklejar::optional<Container> {
+    picklejar::optional<Container> read_result{};
+    ((Steps::version == version
+          ? (read_result =
+                 read_with_step<StepIndex, BufferOrStreamObject,
+                                ReadSizeFunction, ReadBufferOrStreamFunction>(
+                     result, buffer_or_stream_object),
+             true)
+          : false) ||
+     ...);
+    return read_result;
+  }
+
+ public:
+  static constexpr size_t latest_version =
+      std::tuple_element_t<sizeof...(Steps) - 1, std::tuple<Steps...>>::version;
+
+  explicit MigrationRegistry(Steps... _steps) : steps{std::move(_steps)...} {}
+
+  [[nodiscard]] static constexpr auto supports(size_t version) -> bool {
+    return ((Steps::version == version) || ...);
+  }
+
+  // reads the Version header and then the whole container with the matching
+  // step, returns an empty optional if the Version isn't registered or the
+  // read failed
+  template <class BufferOrStreamObject,
+            std::optional<size_t> ReadSizeFunction(BufferOrStreamObject &) =
+                picklejar::read_object_from_stream<size_t>,
+            bool ReadBufferOrStreamFunction(BufferOrStreamObject &, char *,
+                                            const size_t) =
+                picklejar::basic_stream_read,
+            class Container>
+  auto read(Container &result, BufferOrStreamObject &buffer_or_stream_object)
+      -> picklejar::optional<Container> {
+    PICKLEJAR_CONCEPT((ContainerHasPushBack<Container,
+                                            typename Container::value_type>),
+                      CONTAINERWITHHASPUSHBACK_MSG);
+    auto optional_version = ReadSizeFunction(buffer_or_stream_object);
+    if (!optional_version) return {};
+    if (!supports(optional_version.value())) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE) {
+        PICKLEJAR_MESSAGE(0, "PICKLEJAR_RUNTIME_MESSAGE: The version from the "
+                             "file ("
+                                 << optional_version.value()
+                                 << ") has no step in the MigrationRegistry");
+      }
+      return {};
+    }
+    return dispatch<BufferOrStreamObject, ReadSizeFunction,
+                    ReadBufferOrStreamFunction>(
+        optional_version.value(), result, buffer_or_stream_object,
+        std::index_sequence_for<Steps...>{});
+  }
+};
+
+template <class... Steps>
+[[nodiscard]] auto make_migration_registry(Steps &&...steps)
+    -> MigrationRegistry<std::decay_t<Steps>...> {
+  return MigrationRegistry<std::decay_t<Steps>...>{
+      std::forward<Steps>(steps)...};
+}
+
+template <class Container, class... Steps>
+auto deep_read_vector_with_migrations_from_stream(
+    Container &result, std::ifstream &ifs_input_file,
+    MigrationRegistry<Steps...> &registry) -> picklejar::optional<Container> {
+  return registry.read(result, ifs_input_file);
+}
+
+template <class Container, class... Steps>
+auto deep_read_vector_with_migrations_from_file(
+    Container &result, const std::string file_name,
+    MigrationRegistry<Steps...> &registry) -> picklejar::optional<Container> {
+  std::ifstream ifs_input_file(file_name, std::ios::in | std::ios::binary);
+  if (ifstream_is_invalid(ifs_input_file)) return {};
+  return deep_read_vector_with_migrations_from_stream(result, ifs_input_file,
+                                                      registry);
+}
+
+template <class Container, class... Steps>
+auto deep_read_vector_with_migrations_from_buffer(
+    Container &result, ByteVectorWithCounter &vector_byte_buffer,
+    MigrationRegistry<Steps...> &registry) -> picklejar::optional<Container> {
+  return registry.template read<ByteVectorWithCounter,
+                                picklejar::read_object_from_buffer<size_t>,
+                                picklejar::basic_buffer_read>(
+      result, vector_byte_buffer);
+}
+// END MIGRATION_REGISTRY
+
+// START COLUMNAR
+// The regular vector functions write an array of structs, reading one member
+// of every record means reading every byte of the file. The columnar functions
+// write each member listed in a ColumnLayout as its own contiguous column:
+// [row count][column count][width of each column][column 0][column 1]...
+// Every column starts at an offset that only depends on the header, so
+// read_column_from_(stream/file/buffer) read a single column without touching
+// the others, and a loaded column is a plain contiguous array. Ex:
+//   using Layout = picklejar::ColumnLayout<&Trade::timestamp, &Trade::price>;
+//   picklejar::write_vector_columnar_to_file<Layout>(trades, "trades.data");
+//   std::vector<double> prices{};
+//   picklejar::read_column_from_file<Layout, 1>(prices, "trades.data");
+// Members that are not in the layout are not written, and keep the value of a
+// default constructed record when reading the whole vector back.
+namespace util {
+template <class MemberPointer>
+struct member_pointer_traits;
+template <class Class, class Member>
+struct member_pointer_traits<Member Class::*> {
+  using class_type = Class;
+  using member_type = Member;
+};
+
+// columns are copied through a scratch buffer this many rows at a time
+constexpr size_t columnar_chunk_rows = 4096;
+}  // namespace util
+
+template <auto... MemberPointers>
+struct ColumnLayout {
+  static_assert(sizeof...(MemberPointers) > 0,
+                "PICKLEJAR_HELP: a ColumnLayout needs at least one member");
+  using record_type = typename util::member_pointer_traits<
+      std::tuple_element_t<0, std::tuple<decltype(MemberPointers)...>>>::
+      class_type;
+  static_assert(
+      (std::same_as<record_type, typename util::member_pointer_traits<
+                                     decltype(MemberPointers)>::class_type> &&
+       ...),
+      "PICKLEJAR_HELP: every member of a ColumnLayout has to belong to the "
+      "same struct");
+  static_assert(
+      (std::is_trivially_copyable_v<typename util::member_pointer_traits<
+           decltype(MemberPointers)>::member_type> &&
+       ...),
+      "PICKLEJAR_HELP: every member of a ColumnLayout has to be trivially "
+      "copiable");
+
+  static constexpr size_t column_count = sizeof...(MemberPointers);
+  static constexpr std::array<size_t, column_count> column_widths{
+      sizeof(typename util::member_pointer_traits<
+             decltype(MemberPointers)>::member_type)...};
+  static constexpr size_t row_width =
+      (size_t{0} + ... +
+       sizeof(typename util::member_pointer_traits<
+              decltype(MemberPointers)>::member_type));
+  static constexpr size_t header_size = sizeof(size_t) * (2 + column_count);
+
+  template <size_t ColumnIndex>
+  static constexpr auto member_pointer =
+      std::get<ColumnIndex>(std::tuple{MemberPointers...});
+  template <size_t ColumnIndex>
+  using column_type = typename util::member_pointer_traits<
+      std::remove_cv_t<decltype(member_pointer<ColumnIndex>)>>::member_type;
+
+  // offset of a column from the start of the header
+  [[nodiscard]] static constexpr auto column_offset(size_t column_index,
+                                                    size_t row_count)
+      -> size_t {
+    size_t offset{header_size};
+    for (size_t i{0}; i < column_index; ++i) {
+      offset += column_widths[i] * row_count;
+    }
+    return offset;
+  }
+  [[nodiscard]] static constexpr auto byte_size(size_t row_count) -> size_t {
+    return header_size + row_width * row_count;
+  }
+};
+
+namespace util {
+template <class Layout, class BufferOrStreamObject>
+auto write_columnar_bytes(BufferOrStreamObject &buffer_or_stream_object,
+                          const char *bytes, size_t size_to_write) -> bool {
+  return sink_write(buffer_or_stream_object, bytes, size_to_write);
+}
+
+// returns the row count if the header matches Layout
+template <class Layout>
+auto parse_columnar_header(
+    const std::array<size_t, 2 + Layout::column_count> &header)
+    -> std::optional<size_t> {
+  if (header[1] != Layout::column_count) return {};
+  for (size_t i{0}; i < Layout::column_count; ++i) {
+    if (header[2 + i] != Layout::column_widths[i]) return {};
+  }
+  return header[0];
+}
+
+// copies the ColumnIndex member of every record into a contiguous column
+template <class Layout, size_t ColumnIndex, class Container,
+          class BufferOrStreamObject>
+auto write_column(const Container &vector_input_data,
+                  BufferOrStreamObject &buffer_or_stream_object,
+                  std::vector<char> &scratch_bytes) -> bool {
+  using column_type = typename Layout::template column_type<ColumnIndex>;
+  constexpr auto member_pointer =
+      Layout::template member_pointer<ColumnIndex>;
+  auto record = std::cbegin(vector_input_data);
+  const auto record_end = std::cend(vector_input_data);
+  while (record != record_end) {
+    size_t chunk_bytes{0};
+    for (; record != record_end && chunk_bytes < scratch_bytes.size();
+         ++record, chunk_bytes += sizeof(column_type)) {
+      std::memcpy(scratch_bytes.data() + chunk_bytes,
+                  &((*record).*member_pointer), sizeof(column_type));
+    }
+    if (!write_columnar_bytes<Layout>(buffer_or_stream_object,
+                                      scratch_bytes.data(), chunk_bytes))
+      return false;
+  }
+  return true;
+}
+
+// scatters a contiguous column into the ColumnIndex member of every record
+template <class Layout, size_t ColumnIndex, class RecordIterator>
+void scatter_column(RecordIterator record, const char *column_bytes,
+                    size_t row_count) {
+  using column_type = typename Layout::template column_type<ColumnIndex>;
+  constexpr auto member_pointer =
+      Layout::template member_pointer<ColumnIndex>;
+  for (size_t i{0}; i < row_count; ++i, ++record) {
+    std::memcpy(&((*record).*member_pointer),
+                column_bytes + i * sizeof(column_type), sizeof(column_type));
+  }
+}
+}  // namespace util
+
+template <class Layout, class Container, class BufferOrStreamObject>
+auto write_vector_columnar(const Container &vector_input_data,
+                           BufferOrStreamObject &buffer_or_stream_object)
+    -> bool {
+  static_assert(
+      std::same_as<typename Container::value_type,
+                   typename Layout::record_type>,
+      "PICKLEJAR_HELP: the Container has to hold the struct of the Layout");
+  std::array<size_t, 2 + Layout::column_count> header{
+      vector_input_data.size(), Layout::column_count};
+  std::copy(Layout::column_widths.begin(), Layout::column_widths.end(),
+            header.begin() + 2);
+  if (!util::write_columnar_bytes<Layout>(
+          buffer_or_stream_object,
+          reinterpret_cast<const char *>(header.data()),  // NOLINT
+          sizeof(header)))
+    return false;
+  std::vector<char> scratch_bytes(
+      util::columnar_chunk_rows *
+      *std::max_element(Layout::column_widths.begin(),
+                        Layout::column_widths.end()));
+  return [&]<size_t... ColumnIndex>(std::index_sequence<ColumnIndex...>) {
+    return (util::write_column<Layout, ColumnIndex>(
+                vector_input_data, buffer_or_stream_object, scratch_bytes) &&
+            ...);
+  }
+  (std::make_index_sequence<Layout::column_count>{});
+}
+
+template <class Layout, class Container>
+auto write_vector_columnar_to_stream(const Container &vector_input_data,
+                                     std::ofstream &ofs_output_file) -> bool {
+  return write_vector_columnar<Layout>(vector_input_data, ofs_output_file);
+}
+
+template <class Layout, class Container>
+auto write_vector_columnar_to_file(const Container &vector_input_data,
+                                   const std::string file_name) -> bool {
+  std::ofstream ofs_output_file(file_name, std::ios::binary);
+  return write_vector_columnar<Layout>(vector_input_data, ofs_output_file);
+}
+
+// the returned buffer has the exact size of the columns
+template <class Layout, class Container>
+auto write_vector_columnar_to_buffer(const Container &vector_input_data)
+    -> std::optional<ByteVectorWithCounter> {
+  std::optional<ByteVectorWithCounter> optional_output_buffer_of_bytes{
+      Layout::byte_size(vector_input_data.size())};
+  if (!write_vector_columnar<Layout>(vector_input_data,
+                                     optional_output_buffer_of_bytes.value()))
+    return {};
+  return optional_output_buffer_of_bytes;
+}
+
+// appends the records to vector_input_data, it needs .resize()
+template <class Layout, class Container>
+auto read_vector_columnar_from_stream(Container &vector_input_data,
+                                      std::ifstream &ifstream_input_file)
+    -> picklejar::optional<Container> {
+  static_assert(DefaultConstructible<typename Layout::record_type>,
+                DEFAULTCONSTRUCTIBLE_MSG);
+  std::array<size_t, 2 + Layout::column_count> header{};
+  if (!basic_stream_read(ifstream_input_file, header.data(), sizeof(header)))
+    return {};
+  auto optional_row_count = util::parse_columnar_header<Layout>(header);
+  if (!optional_row_count) return {};
+  const size_t row_count = optional_row_count.value();
+  if (row_count > util::ifstream_remaining_bytes(ifstream_input_file) /
+                      Layout::row_width)
+    return {};
+  const size_t initial_size = vector_input_data.size();
+  vector_input_data.resize(initial_size + row_count);
+  const bool read_ok = [&]<size_t... ColumnIndex>(
+      std::index_sequence<ColumnIndex...>) {
+    std::vector<char> scratch_bytes{};
+    auto &&read_column = [&]<size_t Index>(
+        std::integral_constant<size_t, Index>) {
+      auto record = std::begin(vector_input_data) + long(initial_size);
+      for (size_t rows_done{0}; rows_done < row_count;) {
+        const size_t chunk_rows =
+            std::min(util::columnar_chunk_rows, row_count - rows_done);
+        scratch_bytes.resize(chunk_rows * Layout::column_widths[Index]);
+        if (!basic_stream_read(ifstream_input_file, scratch_bytes.data(),
+                               scratch_bytes.size()))
+          return false;
+        util::scatter_column<Layout, Index>(record, scratch_bytes.data(),
+                                            chunk_rows);
+        record += long(chunk_rows);
+        rows_done += chunk_rows;
+      }
+      return true;
+    };
+    return (read_column(std::integral_constant<size_t, ColumnIndex>{}) &&
+            ...);
+  }
+  (std::make_index_sequence<Layout::column_count>{});
+  if (!read_ok) {
+    vector_input_data.resize(initial_size);
+    return {};
+  }
+  return PICKLEJAR_MAKE_OPTIONAL(vector_input_data);
+}
+
+template <class Layout,
+          class Container = std::vector<typename Layout::record_type>>
+[[nodiscard]] auto read_vector_columnar_from_file(const std::string file_name)
+    -> std::optional<Container> {
+  Container vector_input_data;
+  std::ifstream ifstream_input_file(file_name, std::ios::in | std::ios::binary);
+  if (ifstream_is_invalid(ifstream_input_file)) {
+    return {};
+  }
+  auto result{read_vector_columnar_from_stream<Layout>(vector_input_data,
+                                                       ifstream_input_file)};
+  if (!result) return {};
+  return std::make_optional(RETURN_RESULT_FROM_FILE);
+}
+
+template <class Layout, class Container, class ByteContainerOrViewType>
+auto read_vector_columnar_from_buffer(
+    Container &vector_input_data,
+    ByteContainerOrViewType &buffer_with_input_bytes)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  static_assert(DefaultConstructible<typename Layout::record_type>,
+                DEFAULTCONSTRUCTIBLE_MSG);
+  ByteCursor cursor{buffer_with_input_bytes};
+  std::array<size_t, 2 + Layout::column_count> header{};
+  if (!cursor.check(sizeof(header))) {
+    cursor.commit(buffer_with_input_bytes);
+    return {};
+  }
+  cursor.read_unchecked(reinterpret_cast<char *>(header.data()),  // NOLINT
+                        sizeof(header));
+  auto optional_row_count = util::parse_columnar_header<Layout>(header);
+  if (!optional_row_count) return {};
+  const size_t row_count = optional_row_count.value();
+  if (row_count > cursor.size_remaining() / Layout::row_width ||
+      !cursor.check(row_count * Layout::row_width)) {
+    cursor.error = true;
+    cursor.commit(buffer_with_input_bytes);
+    return {};
+  }
+  const size_t initial_size = vector_input_data.size();
+  vector_input_data.resize(initial_size + row_count);
+  // the columns are scattered straight from the buffer bytes
+  [&]<size_t... ColumnIndex>(std::index_sequence<ColumnIndex...>) {
+    (util::scatter_column<Layout, ColumnIndex>(
+         std::begin(vector_input_data) + long(initial_size),
+         cursor.data() + Layout::column_offset(ColumnIndex, row_count) -
+             Layout::header_size,
+         row_count),
+     ...);
+  }
+  (std::make_index_sequence<Layout::column_count>{});
+  cursor.skip_unchecked(row_count * Layout::row_width);
+  cursor.commit(buffer_with_input_bytes);
+  return PICKLEJAR_MAKE_OPTIONAL(vector_input_data);
+}
+
+// projection read, seeks over the other columns and reads only ColumnIndex
+// with a single read. The stream is left at the end of the columnar data.
+template <class Layout, size_t ColumnIndex, class Container>
+auto read_column_from_stream(Container &column_result,
+                             std::ifstream &ifstream_input_file)
+    -> picklejar::optional<Container> {
+  using column_type = typename Layout::template column_type<ColumnIndex>;
+  PICKLEJAR_CONCEPT(ContainerHasDataAndSize<Container>,
+                    CONTAINERWITHHASDATAANDSIZE_MSG);
+  static_assert(
+      std::same_as<typename Container::value_type, column_type>,
+      "PICKLEJAR_HELP: the Container has to hold the type of the column");
+  const auto columnar_begin = ifstream_input_file.tellg();
+  std::array<size_t, 2 + Layout::column_count> header{};
+  if (columnar_begin < 0 ||
+      !basic_stream_read(ifstream_input_file, header.data(), sizeof(header)))
+    return {};
+  auto optional_row_count = util::parse_columnar_header<Layout>(header);
+  if (!optional_row_count) return {};
+  const size_t row_count = optional_row_count.value();
+  if (row_count > util::ifstream_remaining_bytes(ifstream_input_file) /
+                      Layout::row_width)
+    return {};
+  ifstream_input_file.seekg(
+      columnar_begin +
+      std::streamoff(Layout::column_offset(ColumnIndex, row_count)));
+  const size_t initial_size = column_result.size();
+  column_result.resize(initial_size + row_count);
+  if (!basic_stream_read(ifstream_input_file,
+                         column_result.data() + initial_size,
+                         row_count * sizeof(column_type))) {
+    column_result.resize(initial_size);
+    return {};
+  }
+  ifstream_input_file.seekg(columnar_begin +
+                            std::streamoff(Layout::byte_size(row_count)));
+  return PICKLEJAR_MAKE_OPTIONAL(column_result);
+}
+
+template <class Layout, size_t ColumnIndex, class Container>
+auto read_column_from_file(Container &column_result,
+                           const std::string file_name)
+    -> picklejar::optional<Container> {
+  std::ifstream ifstream_input_file(file_name, std::ios::in | std::ios::binary);
+  return read_column_from_stream<Layout, ColumnIndex>(column_result,
+                                                      ifstream_input_file);
+}
+
+// copies one column out of the buffer and moves the counter past the columnar
+// data
+template <class Layout, size_t ColumnIndex, class Container,
+          class ByteContainerOrViewType>
+auto read_column_from_buffer(Container &column_result,
+                             ByteContainerOrViewType &buffer_with_input_bytes)
+    -> picklejar::optional<Container> {
+  using column_type = typename Layout::template column_type<ColumnIndex>;
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  static_assert(
+      std::same_as<typename Container::value_type, column_type>,
+      "PICKLEJAR_HELP: the Container has to hold the type of the column");
+  ByteCursor cursor{buffer_with_input_bytes};
+  std::array<size_t, 2 + Layout::column_count> header{};
+  if (!cursor.check(sizeof(header))) {
+    cursor.commit(buffer_with_input_bytes);
+    return {};
+  }
+  cursor.read_unchecked(reinterpret_cast<char *>(header.data()),  // NOLINT
+                        sizeof(header));
+  auto optional_row_count = util::parse_columnar_header<Layout>(header);
+  if (!optional_row_count) return {};
+  const size_t row_count = optional_row_count.value();
+  if (row_count > cursor.size_remaining() / Layout::row_width ||
+      !cursor.check(row_count * Layout::row_width)) {
+    cursor.error = true;
+    cursor.commit(buffer_with_input_bytes);
+    return {};
+  }
+  const size_t initial_size = column_result.size();
+  column_result.resize(initial_size + row_count);
+  std::memcpy(column_result.data() + initial_size,
+              cursor.data() + Layout::column_offset(ColumnIndex, row_count) -
+                  Layout::header_size,
+              row_count * sizeof(column_type));
+  cursor.skip_unchecked(row_count * Layout::row_width);
+  cursor.commit(buffer_with_input_bytes);
+  return PICKLEJAR_MAKE_OPTIONAL(column_result);
+}
+// END COLUMNAR
+
+// START INTEGER ENCODINGS
+// The vector functions store integers at their full width, even when they are
+// sorted timestamps or sequence ids that only change by a few units per
+// element. The encoded integer functions store a container of integers with
+// one of these encodings:
+//  - delta: the zigzag encoded difference with the previous element as a
+//    varint, monotonic or slowly changing values take one or two bytes each
+//  - frame_of_reference: the smallest element once, then every element minus
+//    the smallest one bit packed with the width of the largest difference.
+//    Containers of a single value are written as run_length instead, a frame
+//    without bits couldn't tell the reader how many elements it holds
+//  - run_length: a [zigzag varint value][varint run length] pair per run
+// IntegerEncoding::smallest measures the three and keeps the smallest one.
+// Layout:
+// [Version][element count][payload byte size][encoding][element width][payload]
+// the encoding and the element width take one byte each. Decoding the deltas
+// is a varint pass followed by an in place prefix sum, which uses SIMD kernels
+// when SSSE3 or AVX2 are enabled. Inside a deep copy element the encoded
+// functions can be used on the element buffer, and single integer members can
+// be written as a varint with write_integer_field.
+enum class IntegerEncoding : std::uint8_t {
+  smallest = 0,
+  delta = 1,
+  frame_of_reference = 2,
+  run_length = 3
+};
+
+template <typename C>
+concept EncodableInteger = std::integral<C> && !std::same_as<C, bool>;
+#define ENCODABLEINTEGER_MSG                                                \
+  "PICKLEJAR_HELP: the integer encodings need a container of integral types " \
+  "other than bool"
+
+namespace util {
+// maps small negative and positive values to small unsigned values
+template <class Type>
+[[nodiscard]] constexpr auto zigzag_encode(Type value) -> std::uint64_t {
+  const auto signed_value = std::int64_t(std::make_signed_t<Type>(value));
+  return (std::uint64_t(signed_value) << 1) ^
+         std::uint64_t(signed_value >> 63);
+}
+template <class Type>
+[[nodiscard]] constexpr auto zigzag_decode(std::uint64_t encoded) -> Type {
+  return Type(std::int64_t(encoded >> 1) ^ -std::int64_t(encoded & 1));
+}
+
+// in place inclusive prefix sum that wraps around, the inverse of taking the
+// difference between consecutive elements. The 128 bit kernels are used with
+// AVX2 too, a 256 bit scan needs a cross lane fixup and the decode is already
+// bound by the varint pass before it.
+template <class Unsigned>
+void prefix_sum(Unsigned *data, size_t number_of_elements) {
+  static_assert(std::is_unsigned_v<Unsigned>);
+  size_t i{0};
+#if defined(__AVX2__) || defined(__SSSE3__)
+  constexpr size_t lane_elements = 16 / sizeof(Unsigned);
+  __m128i carry = _mm_setzero_si128();
+  for (; i + lane_elements <= number_of_elements; i += lane_elements) {
+    auto *lane = reinterpret_cast<__m128i *>(data + i);  // NOLINT
+    __m128i sums = _mm_loadu_si128(lane);
+    // log2(lane_elements) shifted adds, then add the last sum of the
+    // previous lane which carry holds in every element
+    if constexpr (sizeof(Unsigned) == 1) {
+      sums = _mm_add_epi8(sums, _mm_slli_si128(sums, 1));
+      sums = _mm_add_epi8(sums, _mm_slli_si128(sums, 2));
+      sums = _mm_add_epi8(sums, _mm_slli_si128(sums, 4));
+      sums = _mm_add_epi8(sums, _mm_slli_si128(sums, 8));
+      sums = _mm_add_epi8(sums, carry);
+      carry = _mm_shuffle_epi8(sums, _mm_set1_epi8(15));
+    } else if constexpr (sizeof(Unsigned) == 2) {
+      sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 2));
+      sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 4));
+      sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 8));
+      sums = _mm_add_epi16(sums, carry);
+      carry = _mm_shufflehi_epi16(sums, 0xFF);
+      carry = _mm_unpackhi_epi64(carry, carry);
+    } else if constexpr (sizeof(Unsigned) == 4) {
+      sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 4));
+      sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+      sums = _mm_add_epi32(sums, carry);
+      carry = _mm_shuffle_epi32(sums, 0xFF);
+    } else {
+      sums = _mm_add_epi64(sums, _mm_slli_si128(sums, 8));
+      sums = _mm_add_epi64(sums, carry);
+      carry = _mm_unpackhi_epi64(sums, sums);
+    }
+    _mm_storeu_si128(lane, sums);
+  }
+#endif
+  for (i = std::max(i, size_t{1}); i < number_of_elements; ++i) {
+    data[i] = Unsigned(data[i] + data[i - 1]);
+  }
+}
+
+template <class Type>
+[[nodiscard]] auto delta_encoded_size(const Type *values,
+                                      size_t number_of_elements) -> size_t {
+  using Unsigned = std::make_unsigned_t<Type>;
+  size_t encoded_size{0};
+  Unsigned previous{0};
+  for (size_t i{0}; i < number_of_elements; ++i) {
+    encoded_size += varint_size(
+        zigzag_encode(Unsigned(Unsigned(values[i]) - previous)));
+    previous = Unsigned(values[i]);
+  }
+  return encoded_size;
+}
+
+template <class Type>
+auto encode_delta(const Type *values, size_t number_of_elements,
+                  char *destination) -> size_t {
+  using Unsigned = std::make_unsigned_t<Type>;
+  size_t encoded_size{0};
+  Unsigned previous{0};
+  for (size_t i{0}; i < number_of_elements; ++i) {
+    encoded_size += encode_varint(
+        zigzag_encode(Unsigned(Unsigned(values[i]) - previous)),
+        destination + encoded_size);
+    previous = Unsigned(values[i]);
+  }
+  return encoded_size;
+}
+
+template <class Type>
+auto decode_delta(const char *current, const char *end_pos,
+                  Type *destination, size_t number_of_elements) -> bool {
+  using Unsigned = std::make_unsigned_t<Type>;
+  // every delta takes at least one byte
+  if (number_of_elements > size_t(end_pos - current)) return false;
+  auto *unsigned_destination =
+      reinterpret_cast<Unsigned *>(destination);  // NOLINT
+  for (size_t i{0}; i < number_of_elements; ++i) {
+    auto optional_delta = decode_varint(current, end_pos);
+    if (!optional_delta) return false;
+    unsigned_destination[i] = zigzag_decode<Unsigned>(optional_delta.value());
+  }
+  prefix_sum(unsigned_destination, number_of_elements);
+  return current == end_pos;
+}
+
+// the reference and the bit width of the frame, the payload is
+// [reference as 8 bytes][bit width as 1 byte][little endian bit packed values]
+template <class Type>
+struct frame_of_reference {
+  using Unsigned = std::make_unsigned_t<Type>;
+  static constexpr size_t header_size = sizeof(std::uint64_t) + 1;
+  Unsigned reference{0};
+  size_t bit_width{0};
+
+  frame_of_reference(const Type *values, size_t number_of_elements) {
+    if (number_of_elements == 0) return;
+    auto [min_pos, max_pos] =
+        std::minmax_element(values, values + number_of_elements);
+    reference = Unsigned(*min_pos);
+    bit_width = size_t(
+        std::bit_width(std::uint64_t(Unsigned(Unsigned(*max_pos) - reference))));
+  }
+  [[nodiscard]] auto encoded_size(size_t number_of_elements) const -> size_t {
+    return header_size + (number_of_elements * bit_width + 7) / 8;
+  }
+};
+
+inline auto load_portable_word(const char *source) -> std::uint64_t {
+  std::uint64_t word;
+  std::memcpy(&word, source, sizeof(word));
+  return from_portable_order(word);
+}
+
+template <class Type>
+auto encode_frame_of_reference(const Type *values, size_t number_of_elements,
+                               const frame_of_reference<Type> &frame,
+                               char *destination) -> size_t {
+  using Unsigned = std::make_unsigned_t<Type>;
+  const auto portable_reference =
+      to_portable_order(std::uint64_t(frame.reference));
+  std::memcpy(destination, &portable_reference, sizeof(std::uint64_t));
+  destination[sizeof(std::uint64_t)] = char(frame.bit_width);
+  char *packed = destination + frame_of_reference<Type>::header_size;
+  if (frame.bit_width == 0) return frame.encoded_size(number_of_elements);
+  std::uint64_t bit_buffer{0};
+  size_t bits_in_buffer{0};
+  auto &&flush = [&](size_t size_to_flush) {
+    const auto portable_word = to_portable_order(bit_buffer);
+    std::memcpy(packed, &portable_word, size_to_flush);
+    packed += size_to_flush;
+  };
+  for (size_t i{0}; i < number_of_elements; ++i) {
+    const auto value = std::uint64_t(Unsigned(Unsigned(values[i]) - frame.reference));
+    bit_buffer |= value << bits_in_buffer;
+    bits_in_buffer += frame.bit_width;
+    if (bits_in_buffer >= 64) {
+      flush(sizeof(std::uint64_t));
+      bits_in_buffer -= 64;
+      // the high bits of value that didn't fit in the word we just flushed
+      bit_buffer =
+          bits_in_buffer == 0 ? 0 : value >> (frame.bit_width - bits_in_buffer);
+    }
+  }
+  flush((bits_in_buffer + 7) / 8);
+  return frame.encoded_size(number_of_elements);
+}
+
+template <class Type>
+auto decode_frame_of_reference(const char *current, const char *end_pos,
+                               Type *destination, size_t number_of_elements)
+    -> bool {
+  using Unsigned = std::make_unsigned_t<Type>;
+  if (size_t(end_pos - current) < frame_of_reference<Type>::header_size)
+    return false;
+  const auto reference = Unsigned(load_portable_word(current));
+  const auto bit_width = size_t(static_cast<unsigned char>(
+      current[sizeof(std::uint64_t)]));
+  const char *packed = current + frame_of_reference<Type>::header_size;
+  const size_t packed_size = size_t(end_pos - packed);
+  if (bit_width > sizeof(Type) * 8) return false;
+  if (bit_width == 0) {
+    std::fill_n(destination, number_of_elements, Type(reference));
+    return packed_size == 0;
+  }
+  if (number_of_elements > packed_size * 8 / bit_width ||
+      packed_size != (number_of_elements * bit_width + 7) / 8)
+    return false;
+  const std::uint64_t mask = bit_width == 64
+                                 ? ~std::uint64_t{0}
+                                 : (std::uint64_t{1} << bit_width) - 1;
+  // a value spans at most 9 bytes, two word loads from its first byte
+  auto &&unpack = [&](const char *bytes, size_t bit_position) {
+    const size_t shift = bit_position % 8;
+    const char *first_byte = bytes + bit_position / 8;
+    std::uint64_t value = load_portable_word(first_byte) >> shift;
+    if (shift + bit_width > 64)
+      value |= load_portable_word(first_byte + 8) << (64 - shift);
+    return Type(Unsigned(reference + Unsigned(value & mask)));
+  };
+  // the loads stay inside packed while 16 bytes are left after the first byte
+  const size_t unchecked_elements =
+      packed_size < 16
+          ? 0
+          : std::min(number_of_elements,
+                     ((packed_size - 16) * 8 + 7) / bit_width + 1);
+  for (size_t i{0}; i < unchecked_elements; ++i) {
+    destination[i] = unpack(packed, i * bit_width);
+  }
+  if (unchecked_elements == number_of_elements) return true;
+  // the last values are unpacked from a zero padded copy of the last bytes
+  const size_t tail_begin = unchecked_elements * bit_width / 8;
+  std::array<char, 32> tail_bytes{};
+  std::memcpy(tail_bytes.data(), packed + tail_begin, packed_size - tail_begin);
+  for (size_t i{unchecked_elements}; i < number_of_elements; ++i) {
+    destination[i] = unpack(tail_bytes.data(), i * bit_width - tail_begin * 8);
+  }
+  return true;
+}
+
+template <class Type>
+[[nodiscard]] auto run_length_encoded_size(const Type *values,
+                                           size_t number_of_elements)
+    -> size_t {
+  size_t encoded_size{0};
+  for (size_t i{0}; i < number_of_elements;) {
+    size_t run_end{i + 1};
+    while (run_end < number_of_elements && values[run_end] == values[i])
+      ++run_end;
+    encoded_size += varint_size(zigzag_encode(values[i])) +
+                    varint_size(std::uint64_t(run_end - i));
+    i = run_end;
+  }
+  return encoded_size;
+}
+
+template <class Type>
+auto encode_run_length(const Type *values, size_t number_of_elements,
+                       char *destination) -> size_t {
+  size_t encoded_size{0};
+  for (size_t i{0}; i < number_of_elements;) {
+    size_t run_end{i + 1};
+    while (run_end < number_of_elements && values[run_end] == values[i])
+      ++run_end;
+    encoded_size +=
+        encode_varint(zigzag_encode(values[i]), destination + encoded_size);
+    encoded_size += encode_varint(std::uint64_t(run_end - i),
+                                  destination + encoded_size);
+    i = run_end;
+  }
+  return encoded_size;
+}
+
+template <class Type>
+auto decode_run_length(const char *current, const char *end_pos,
+                       Type *destination, size_t number_of_elements) -> bool {
+  size_t decoded_elements{0};
+  while (current != end_pos) {
+    auto optional_value = decode_varint(current, end_pos);
+    if (!optional_value) return false;
+    auto optional_run_length = decode_varint(current, end_pos);
+    if (!optional_run_length || optional_run_length.value() == 0 ||
+        optional_run_length.value() > number_of_elements - decoded_elements)
+      return false;
+    std::fill_n(destination + decoded_elements,
+                size_t(optional_run_length.value()),
+                zigzag_decode<Type>(optional_value.value()));
+    decoded_elements += size_t(optional_run_length.value());
+  }
+  return decoded_elements == number_of_elements;
+}
+
+// the element count comes from the file, so it is checked against what the
+// payload can hold before the result is resized to it
+inline auto encoded_integer_count_fits(IntegerEncoding encoding,
+                                       const char *payload,
+                                       size_t payload_size,
+                                       size_t number_of_elements) -> bool {
+  switch (encoding) {
+    case IntegerEncoding::delta:
+      // every delta takes at least one byte
+      return number_of_elements <= payload_size;
+    case IntegerEncoding::frame_of_reference: {
+      // the bit width is the same for every Type
+      constexpr size_t header_size = frame_of_reference<int>::header_size;
+      if (payload_size < header_size) return false;
+      const auto bit_width = size_t(
+          static_cast<unsigned char>(payload[sizeof(std::uint64_t)]));
+      // a frame without bits says nothing about the count, so constant
+      // containers are written as runs
+      if (bit_width == 0) return number_of_elements == 0;
+      return number_of_elements <= (payload_size - header_size) * 8 / bit_width;
+    }
+    case IntegerEncoding::run_length: {
+      const char *current = payload;
+      const char *end_pos = payload + payload_size;
+      size_t run_lengths_sum{0};
+      while (current != end_pos) {
+        if (!decode_varint(current, end_pos)) return false;
+        auto optional_run_length = decode_varint(current, end_pos);
+        if (!optional_run_length ||
+            optional_run_length.value() > number_of_elements - run_lengths_sum)
+          return false;
+        run_lengths_sum += size_t(optional_run_length.value());
+      }
+      return run_lengths_sum == number_of_elements;
+    }
+    default:
+      return false;
+  }
+}
+
+template <class Type>
+auto decode_integers(IntegerEncoding encoding, const char *payload,
+                     size_t payload_size, Type *destination,
+                     size_t number_of_elements) -> bool {
+  switch (encoding) {
+    case IntegerEncoding::delta:
+      return decode_delta(payload, payload + payload_size, destination,
+                          number_of_elements);
+    case IntegerEncoding::frame_of_reference:
+      return decode_frame_of_reference(payload, payload + payload_size,
+                                       destination, number_of_elements);
+    case IntegerEncoding::run_length:
+      return decode_run_length(payload, payload + payload_size, destination,
+                               number_of_elements);
+    default:
+      return false;
+  }
+}
+}  // namespace util
+
+// the encoded payload of a container of integers, computed once so the exact
+// size is known before writing
+struct IntegerEncodingPlan {
+  IntegerEncoding encoding{IntegerEncoding::delta};
+  size_t element_width{0};
+  size_t element_count{0};
+  std::vector<char> payload{};
+
+  template <size_t Version = 0>
+  [[nodiscard]] auto byte_size() const -> size_t {
+    // versioned_size counts the element count, then the payload byte size,
+    // the encoding and the element width
+    return versioned_size<Version>() + sizeof(size_t) + 2 + payload.size();
+  }
+};
+
+template <class Container>
+[[nodiscard]] auto make_integer_encoding_plan(
+    const Container &integer_input_data,
+    IntegerEncoding encoding = IntegerEncoding::smallest)
+    -> IntegerEncodingPlan {
+  using Type = typename Container::value_type;
+  PICKLEJAR_CONCEPT(EncodableInteger<Type>, ENCODABLEINTEGER_MSG);
+  PICKLEJAR_CONCEPT(ContainerHasDataAndSize<Container>,
+                    CONTAINERWITHHASDATAANDSIZE_MSG);
+  const Type *values = integer_input_data.data();
+  const size_t number_of_elements = integer_input_data.size();
+  const util::frame_of_reference<Type> frame{values, number_of_elements};
+  if (encoding == IntegerEncoding::smallest) {
+    const std::array<std::pair<size_t, IntegerEncoding>, 3> encoded_sizes{
+        {{util::delta_encoded_size(values, number_of_elements),
+          IntegerEncoding::delta},
+         {frame.encoded_size(number_of_elements),
+          IntegerEncoding::frame_of_reference},
+         {util::run_length_encoded_size(values, number_of_elements),
+          IntegerEncoding::run_length}}};
+    encoding = std::min_element(encoded_sizes.cbegin(), encoded_sizes.cend(),
+                                [](const auto &lhs, const auto &rhs) {
+                                  return lhs.first < rhs.first;
+                                })
+                   ->second;
+  }
+  if (encoding == IntegerEncoding::frame_of_reference &&
+      frame.bit_width == 0 && number_of_elements > 0)
+    encoding = IntegerEncoding::run_length;
+  IntegerEncodingPlan plan{encoding, sizeof(Type), number_of_elements, {}};
+  switch (encoding) {
+    case IntegerEncoding::frame_of_reference:
+      plan.payload.resize(frame.encoded_size(number_of_elements));
+      util::encode_frame_of_reference(values, number_of_elements, frame,
+                                      plan.payload.data());
+      break;
+    case IntegerEncoding::run_length:
+      plan.payload.resize(
+          util::run_length_encoded_size(values, number_of_elements));
+      util::encode_run_length(values, number_of_elements, plan.payload.data());
+      break;
+    default:
+      plan.encoding = IntegerEncoding::delta;
+      plan.payload.resize(util::delta_encoded_size(values, number_of_elements));
+      util::encode_delta(values, number_of_elements, plan.payload.data());
+      break;
+  }
+  return plan;
+}
+
+template <size_t Version = 0, class BufferOrStreamObject>
+auto write_integer_encoding_plan(const IntegerEncodingPlan &plan,
+                                 BufferOrStreamObject &buffer_or_stream_object)
+    -> bool {
+  auto &&write_bytes = [&](const char *bytes, size_t size_to_write) {
+    return sink_write(buffer_or_stream_object, bytes, size_to_write);
+  };
+  auto &&write_size = [&](const size_t &size_to_write) {
+    return write_size_to_sink(size_to_write, buffer_or_stream_object);
+  };
+  if constexpr (Version > 0) {
+    if (!write_size(Version)) return false;
+  }
+  const std::array<char, 2> encoding_and_width{char(plan.encoding),
+                                               char(plan.element_width)};
+  // an empty payload has no data pointer to hand to the sink
+  return write_size(plan.element_count) && write_size(plan.payload.size()) &&
+         write_bytes(encoding_and_width.data(), encoding_and_width.size()) &&
+         (plan.payload.empty() ||
+          write_bytes(plan.payload.data(), plan.payload.size()));
+}
+
+template <size_t Version = 0, class Container>
+auto write_encoded_integers_to_stream(
+    const Container &integer_input_data, std::ofstream &ofs_output_file,
+    IntegerEncoding encoding = IntegerEncoding::smallest) -> bool {
+  return write_integer_encoding_plan<Version>(
+      make_integer_encoding_plan(integer_input_data, encoding),
+      ofs_output_file);
+}
+
+template <size_t Version = 0, class Container>
+auto write_encoded_integers_to_file(
+    const Container &integer_input_data, const std::string file_name,
+    IntegerEncoding encoding = IntegerEncoding::smallest) -> bool {
+  std::ofstream ofs_output_file(file_name, std::ios::binary);
+  return write_encoded_integers_to_stream<Version>(integer_input_data,
+                                                   ofs_output_file, encoding);
+}
+
+// the returned buffer has the exact size of the encoded integers
+template <size_t Version = 0, class Container>
+auto write_encoded_integers_to_buffer(
+    const Container &integer_input_data,
+    IntegerEncoding encoding = IntegerEncoding::smallest)
+    -> std::optional<ByteVectorWithCounter> {
+  auto plan = make_integer_encoding_plan(integer_input_data, encoding);
+  std::optional<ByteVectorWithCounter> optional_output_buffer_of_bytes{
+      plan.template byte_size<Version>()};
+  if (!write_integer_encoding_plan<Version>(
+          plan, optional_output_buffer_of_bytes.value()))
+    return {};
+  return optional_output_buffer_of_bytes;
+}
+
+// decodes straight from the buffer bytes into the end of result
+template <size_t Version = 0, class Container, class ByteContainerOrViewType>
+auto read_encoded_integers_from_buffer(
+    Container &result, ByteContainerOrViewType &buffer_with_input_bytes)
+    -> picklejar::optional<Container> {
+  using Type = typename Container::value_type;
+  PICKLEJAR_CONCEPT(
+      PickleJarValidByteContainerOrViewType<ByteContainerOrViewType>,
+      VALIDBYTECONTAINERORVIEWTYPE_MSG);
+  PICKLEJAR_CONCEPT(EncodableInteger<Type>, ENCODABLEINTEGER_MSG);
+  PICKLEJAR_CONCEPT(ContainerHasDataAndSize<Container>,
+                    CONTAINERWITHHASDATAANDSIZE_MSG);
+  if constexpr (Version > 0) {
+    auto optional_version =
+        read_object_from_buffer<size_t>(buffer_with_input_bytes);
+    if (buffer_with_input_bytes.invalid() or !optional_version or
+        optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and
+          !buffer_with_input_bytes.invalid() and optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return {};
+    }
+  }
+  ByteCursor cursor{buffer_with_input_bytes};
+  size_t element_count{0};
+  size_t payload_size{0};
+  std::array<unsigned char, 2> encoding_and_width{};
+  if (!cursor.read(element_count) || !cursor.read(payload_size) ||
+      !cursor.read(encoding_and_width) || !cursor.check(payload_size) ||
+      encoding_and_width[1] != sizeof(Type) ||
+      !util::encoded_integer_count_fits(IntegerEncoding(encoding_and_width[0]),
+                                        cursor.data(), payload_size,
+                                        element_count)) {
+    cursor.error = true;
+    cursor.commit(buffer_with_input_bytes);
+    return {};
+  }
+  const char *payload = cursor.data();
+  cursor.skip_unchecked(payload_size);
+  cursor.commit(buffer_with_input_bytes);
+  const size_t initial_size = result.size();
+  result.resize(initial_size + element_count);
+  if (!util::decode_integers(IntegerEncoding(encoding_and_width[0]), payload,
+                             payload_size, result.data() + initial_size,
+                             element_count)) {
+    result.resize(initial_size);
+    return {};
+  }
+  return PICKLEJAR_MAKE_OPTIONAL(result);
+}
+
+// reads the whole payload with a single read and decodes it into the end of
+// result
+template <size_t Version = 0, class Container>
+auto read_encoded_integers_from_stream(Container &result,
+                                       std::ifstream &ifs_input_file)
+    -> picklejar::optional<Container> {
+  using Type = typename Container::value_type;
+  PICKLEJAR_CONCEPT(EncodableInteger<Type>, ENCODABLEINTEGER_MSG);
+  PICKLEJAR_CONCEPT(ContainerHasDataAndSize<Container>,
+                    CONTAINERWITHHASDATAANDSIZE_MSG);
+  if constexpr (Version > 0) {
+    if (auto optional_version = read_object_from_stream<size_t>(ifs_input_file);
+        !optional_version or optional_version.value() != Version) {
+      if (PICKLEJAR_ENABLE_VERBOSE_MODE and optional_version) {
+        PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                          PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+      }
+      return {};
+    }
+  }
+  auto optional_element_count = read_object_from_stream<size_t>(ifs_input_file);
+  auto optional_payload_size = read_object_from_stream<size_t>(ifs_input_file);
+  std::array<unsigned char, 2> encoding_and_width{};
+  if (!optional_element_count || !optional_payload_size ||
+      !basic_stream_read(ifs_input_file, encoding_and_width.data(),
+                         encoding_and_width.size()) ||
+      encoding_and_width[1] != sizeof(Type) ||
+      optional_payload_size.value() >
+          util::ifstream_remaining_bytes(ifs_input_file))
+    return {};
+  std::vector<char> payload(optional_payload_size.value());
+  if (!basic_stream_read(ifs_input_file, payload.data(), payload.size()) ||
+      !util::encoded_integer_count_fits(IntegerEncoding(encoding_and_width[0]),
+                                        payload.data(), payload.size(),
+                                        optional_element_count.value()))
+    return {};
+  const size_t initial_size = result.size();
+  result.resize(initial_size + optional_element_count.value());
+  if (!util::decode_integers(IntegerEncoding(encoding_and_width[0]),
+                             payload.data(), payload.size(),
+                             result.data() + initial_size,
+                             optional_element_count.value())) {
+    result.resize(initial_size);
+    return {};
+  }
+  return PICKLEJAR_MAKE_OPTIONAL(result);
+}
+
+template <size_t Version = 0, class Container>
+auto read_encoded_integers_from_file(Container &result,
+                                     const std::string file_name)
+    -> picklejar::optional<Container> {
+  std::ifstream ifs_input_file(file_name, std::ios::binary);
+  return read_encoded_integers_from_stream<Version>(result, ifs_input_file);
+}
+
+// single integer members, signed types are zigzag encoded so small negative
+// values stay small
+namespace util {
+template <class Type>
+[[nodiscard]] constexpr auto integer_field_bits(Type value) -> std::uint64_t {
+  if constexpr (std::is_signed_v<Type>) {
+    return zigzag_encode(value);
+  } else {
+    return std::uint64_t(value);
+  }
+}
+template <class Type>
+[[nodiscard]] constexpr auto integer_field_from_bits(std::uint64_t bits)
+    -> std::optional<Type> {
+  if constexpr (std::is_signed_v<Type>) {
+    const auto value = zigzag_decode<std::int64_t>(bits);
+    if (!std::in_range<Type>(value)) return {};
+    return Type(value);
+  } else {
+    if (!std::in_range<Type>(bits)) return {};
+    return Type(bits);
+  }
+}
+}  // namespace util
+
+template <class Type>
+[[nodiscard]] constexpr auto sizeof_integer_field(const Type &value)
+    -> size_t {
+  PICKLEJAR_CONCEPT(EncodableInteger<Type>, ENCODABLEINTEGER_MSG);
+  return util::varint_size(util::integer_field_bits(value));
+}
+
+template <class Type, class BufferOrStreamObject>
+auto write_integer_field(const Type &value,
+                         BufferOrStreamObject &buffer_or_stream_object)
+    -> bool {
+  PICKLEJAR_CONCEPT(EncodableInteger<Type>, ENCODABLEINTEGER_MSG);
+  std::array<char, util::max_varint_size> varint_bytes{};
+  const size_t varint_size =
+      util::encode_varint(util::integer_field_bits(value), varint_bytes.data());
+  return sink_write(buffer_or_stream_object, varint_bytes.data(), varint_size);
+}
+
+template <class Type, class ByteContainerOrViewType>
+[[nodiscard]] auto read_integer_field_from_buffer(
+    ByteContainerOrViewType &buffer_with_input_bytes) -> std::optional<Type> {
+  PICKLEJAR_CONCEPT(EncodableInteger<Type>, ENCODABLEINTEGER_MSG);
+  ByteCursor cursor{buffer_with_input_bytes};
+  if (cursor.invalid()) return {};
+  const char *current = cursor.data();
+  auto optional_bits = util::decode_varint(current, cursor.end_pos);
+  if (!optional_bits) {
+    cursor.error = true;
+    cursor.commit(buffer_with_input_bytes);
+    return {};
+  }
+  cursor.skip_unchecked(size_t(current - cursor.data()));
+  cursor.commit(buffer_with_input_bytes);
+  return util::integer_field_from_bits<Type>(optional_bits.value());
+}
+
+template <class Type>
+[[nodiscard]] auto read_integer_field_from_stream(
+    std::ifstream &ifs_input_file) -> std::optional<Type> {
+  PICKLEJAR_CONCEPT(EncodableInteger<Type>, ENCODABLEINTEGER_MSG);
+  std::array<char, util::max_varint_size> varint_bytes{};
+  size_t varint_size{0};
+  do {
+    if (varint_size == varint_bytes.size() ||
+        !basic_stream_read(ifs_input_file, &varint_bytes[varint_size], 1))
+      return {};
+  } while (static_cast<unsigned char>(varint_bytes[varint_size++]) & 0x80);
+  const char *current = varint_bytes.data();
+  auto optional_bits =
+      util::decode_varint(current, varint_bytes.data() + varint_size);
+  if (!optional_bits) return {};
+  return util::integer_field_from_bits<Type>(optional_bits.value());
+}
+// END INTEGER ENCODINGS
+
+// START DIFFERENTIAL SNAPSHOTS
+// Checkpoints of a big vector where few elements change between them.
+// write_snapshot_base writes a normal deep copied file (any deep read
+// function can read it) and write_snapshot_delta a delta file with only the
+// elements whose encoded bytes changed since the previous checkpoint, or that
+// were added after its end. The changes are found by hashing the bytes
+// write_element_lambda writes, which DifferentialSnapshotState keeps between
+// checkpoints; the lambda writes into a ByteVectorWithCounter, so take the
+// sink as 'auto &'.
+// Delta layout:
+//   [Version][delta magic][checksum of the previous checkpoint]
+//   [element count][changed count]([index][size][bytes])...
+// Elements removed from the end only lower the element count, removing one
+// from the middle shifts the ones after it so they are all written.
+// The checksum comes from the element hashes, which readers recompute from
+// the files, so a delta that was not written on top of the base and the
+// deltas before it is refused. When deltas pile up write a new base, or let
+// compact_snapshot_files merge them without decoding anything.
+// Ex:
+//   picklejar::DifferentialSnapshotState state{};
+//   picklejar::write_snapshot_base<1>(vec, "base.data", state, size_getter,
+//                                     write_element_lambda);
+//   ... change vec
+//   picklejar::write_snapshot_delta<1>(vec, "delta1.data", state, size_getter,
+//                                      write_element_lambda);
+//   auto optional_result = picklejar::read_snapshot_with_deltas_from_files<1>(
+//       result, "base.data", {"delta1.data"}, vector_insert_element_lambda);
+struct DifferentialSnapshotState {
+  std::vector<std::uint64_t> element_hashes{};
+  std::uint64_t checksum{0};  // of the last checkpoint written
+  size_t deltas_since_base{0};
+};
+
+namespace util {
+constexpr std::uint64_t snapshot_delta_magic{
+    fnv1a_hash("picklejar_snapshot_delta")};
+
+[[nodiscard]] inline auto snapshot_element_hash(std::span<const char> bytes)
+    -> std::uint64_t {
+  return fnv1a_hash(std::string_view{bytes.data(), bytes.size()});
+}
+
+[[nodiscard]] inline auto snapshot_checksum(
+    const std::vector<std::uint64_t> &element_hashes) -> std::uint64_t {
+  std::uint64_t checksum{
+      hash_combine(fnv1a_hash("picklejar_snapshot"), element_hashes.size())};
+  for (const std::uint64_t element_hash : element_hashes)
+    checksum = hash_combine(checksum, element_hash);
+  return checksum;
+}
+
+// element_bytes is reused between elements to avoid an allocation each
+template <class Type, class ElementSizeGetterLambda, class WriteElementLambda>
+auto encode_snapshot_element(
+    ByteVectorWithCounter &element_bytes, const Type &element,
+    ElementSizeGetterLambda &&element_size_getter_lambda,
+    WriteElementLambda &&write_element_lambda) -> bool {
+  const size_t element_size = element_size_getter_lambda(element);
+  element_bytes.byte_data.resize(element_size);
+  element_bytes.set_counter(0);
+  if (!write_element_lambda(element_bytes, element, element_size)) return false;
+  PICKLEJAR_ASSERT(!element_bytes.invalid() and
+                       element_bytes.byte_counter.value() == element_size,
+                   "PICKLEJAR_RUNTIME_HELP: the 'write_element_lambda' did "
+                   "not write the size returned from the "
+                   "'element_size_getter_lambda("
+                       << type_name<Type>() << ")' (" << element_size << ")");
+  return !element_bytes.invalid() and
+         element_bytes.byte_counter.value() == element_size;
+}
+
+inline auto write_snapshot_element(std::ofstream &ofs_output_file,
+                                   const ByteVectorWithCounter &element_bytes)
+    -> bool {
+  return write_size_to_sink(element_bytes.size(), ofs_output_file) &&
+         sink_write(ofs_output_file, element_bytes.byte_data.data(),
+                    element_bytes.size());
+}
+
+[[nodiscard]] inline auto read_file_to_buffer(const std::string file_name)
+    -> std::optional<ByteVectorWithCounter> {
+  std::ifstream ifs_input_file(file_name, std::ios::binary);
+  if (!ifs_input_file.is_open()) return {};
+  std::optional<ByteVectorWithCounter> optional_buffer{
+      std::in_place, ifstream_remaining_bytes(ifs_input_file)};
+  if (optional_buffer->size() > 0 &&
+      !basic_stream_read(ifs_input_file, optional_buffer->byte_data.data(),
+                         optional_buffer->size()))
+    return {};
+  return optional_buffer;
+}
+
+template <size_t Version>
+auto read_snapshot_version(ByteVectorWithCounter &buffer_with_input_bytes)
+    -> bool {
+  if constexpr (Version > 0) {
+    auto optional_version = read_size_from_source(buffer_with_input_bytes);
+    if (!optional_version) return false;
+    if (PICKLEJAR_ENABLE_VERBOSE_MODE) {
+      PICKLEJAR_MESSAGE(optional_version.value() == Version,
+                        PICKLEJAR_RUNTIME_READ_VERSION_MISSMATCH);
+    }
+    return optional_version.value() == Version;
+  }
+  return true;
+}
+
+// [size][bytes] as a view into the buffer
+inline auto read_snapshot_element(
+    ByteVectorWithCounter &buffer_with_input_bytes)
+    -> std::optional<std::span<char>> {
+  auto optional_size = read_size_from_source(buffer_with_input_bytes);
+  if (!optional_size) return {};
+  return source_view(buffer_with_input_bytes, optional_size.value());
+}
+
+// the element bytes of the base with the deltas laid over it, the spans
+// point into files
+struct snapshot_overlay {
+  std::deque<ByteVectorWithCounter> files{};
+  std::vector<std::span<char>> elements{};
+  std::vector<std::uint64_t> element_hashes{};
+};
+
+template <size_t Version>
+auto overlay_snapshot_delta(snapshot_overlay &overlay,
+                            ByteVectorWithCounter &delta) -> bool {
+  if (!read_snapshot_version<Version>(delta)) return false;
+  auto optional_magic = read_size_from_source(delta);
+  auto optional_checksum = read_size_from_source(delta);
+  auto optional_element_count = read_size_from_source(delta);
+  auto optional_changed_count = read_size_from_source(delta);
+  if (!optional_changed_count ||
+      optional_magic.value() != snapshot_delta_magic)
+    return false;
+  if (optional_checksum.value() != snapshot_checksum(overlay.element_hashes)) {
+    if (PICKLEJAR_ENABLE_VERBOSE_MODE) {
+      PICKLEJAR_MESSAGE(0,
+                        "PICKLEJAR_RUNTIME_HELP: the delta was not written "
+                        "on top of the base and deltas read before it, check "
+                        "the order of the delta files");
+    }
+    return false;
+  }
+  // every element added has to be in the delta, so a count bigger than the
+  // bytes left is a broken file
+  if (optional_element_count.value() >
+      overlay.elements.size() + delta.size_remaining() / sizeof(size_t))
+    return false;
+  const size_t previous_count{overlay.elements.size()};
+  overlay.elements.resize(optional_element_count.value());
+  overlay.element_hashes.resize(optional_element_count.value());
+  // an index may only change once per delta, and every element past the
+  // previous count has to be written or it would be left empty
+  std::vector<bool> changed_indices(optional_element_count.value(), false);
+  for (size_t i{0}; i < optional_changed_count.value(); ++i) {
+    auto optional_index = read_size_from_source(delta);
+    if (!optional_index ||
+        optional_index.value() >= optional_element_count.value() ||
+        changed_indices[optional_index.value()])
+      return false;
+    changed_indices[optional_index.value()] = true;
+    auto optional_element = read_snapshot_element(delta);
+    if (!optional_element) return false;
+    overlay.elements[optional_index.value()] = optional_element.value();
+    overlay.element_hashes[optional_index.value()] =
+        snapshot_element_hash(optional_element.value());
+  }
+  return std::all_of(
+      changed_indices.begin() +
+          static_cast<std::ptrdiff_t>(
+              std::min(previous_count, changed_indices.size())),
+      changed_indices.end(), [](bool changed) { return changed; });
+}
+
+template <size_t Version>
+auto overlay_snapshot_files(const std::string base_file_name,
+                            const std::vector<std::string> &delta_file_names)
+    -> std::optional<snapshot_overlay> {
+  std::optional<snapshot_overlay> overlay{std::in_place};
+  auto optional_base = read_file_to_buffer(base_file_name);
+  if (!optional_base) return {};
+  auto &base = overlay->files.emplace_back(std::move(optional_base.value()));
+  if (!read_snapshot_version<Version>(base)) return {};
+  auto optional_count = read_size_from_source(base);
+  if (!optional_count ||
+      optional_count.value() > base.size_remaining() / sizeof(size_t))
+    return {};
+  overlay->elements.reserve(optional_count.value());
+  overlay->element_hashes.reserve(optional_count.value());
+  for (size_t i{0}; i < optional_count.value(); ++i) {
+    auto optional_element = read_snapshot_element(base);
+    if (!optional_element) return {};
+    overlay->elements.push_back(optional_element.value());
+    overlay->element_hashes.push_back(
+        snapshot_element_hash(optional_element.value()));
+  }
+
+  for (const auto &delta_file_name : delta_file_names) {
+    auto optional_delta = read_file_to_buffer(delta_file_name);
+    if (!optional_delta) return {};
+    if (!overlay_snapshot_delta<Version>(
+            overlay.value(),
+            overlay->files.emplace_back(std::move(optional_delta.value()))))
+      return {};
+  }
+  return overlay;
+}
+}  // namespace util
+
+template <size_t Version = 0, class Container, class ElementSizeGetterLambda,
+          class WriteElementLambda,
+          typename Type = typename Container::value_type>
+auto write_snapshot_base(const Container &vector_input_data,
+                         const std::string file_name,
+                         DifferentialSnapshotState &state,
+                         ElementSizeGetterLambda &&element_size_getter_lambda,
+                         WriteElementLambda &&write_element_lambda) -> bool {
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(
+      (PickleJarElementSizeGetterRequirements<ElementSizeGetterLambda, Type>),
+      SIZEGETTERLAMBDAREQUIREMENTS_MSG);
+  std::ofstream ofs_output_file(file_name, std::ios::binary);
+  if constexpr (Version > 0) {
+    if (!write_size_to_sink(Version, ofs_output_file)) return false;
+  }
+  if (!write_size_to_sink(vector_input_data.size(), ofs_output_file))
+    return false;
+  std::vector<std::uint64_t> element_hashes{};
+  element_hashes.reserve(vector_input_data.size());
+  ByteVectorWithCounter element_bytes{size_t{0}};
+  for (const auto &element : vector_input_data) {
+    if (!util::encode_snapshot_element(element_bytes, element,
+                                       element_size_getter_lambda,
+                                       write_element_lambda) ||
+        !util::write_snapshot_element(ofs_output_file, element_bytes))
+      return false;
+    element_hashes.push_back(
+        util::snapshot_element_hash(element_bytes.byte_data));
+  }
+  ofs_output_file.close();
+  if (!ofs_output_file) return false;
+  state.checksum = util::snapshot_checksum(element_hashes);
+  state.element_hashes = std::move(element_hashes);
+  state.deltas_since_base = 0;
+  return true;
+}
+
+// state has to come from the write_snapshot_base/_delta of the previous
+// checkpoint, it is only updated when the delta is written
+template <size_t Version = 0, class Container, class ElementSizeGetterLambda,
+          class WriteElementLambda,
+          typename Type = typename Container::value_type>
+auto write_snapshot_delta(const Container &vector_input_data,
+                          const std::string file_name,
+                          DifferentialSnapshotState &state,
+                          ElementSizeGetterLambda &&element_size_getter_lambda,
+                          WriteElementLambda &&write_element_lambda) -> bool {
+  PICKLEJAR_CONCEPT(ContainerDeepCopyReadRequirements<Container>,
+                    CONTAINERDEEPCOPYREADREQUIREMENTS_MSG);
+  PICKLEJAR_CONCEPT(
+      (PickleJarElementSizeGetterRequirements<ElementSizeGetterLambda, Type>),
+      SIZEGETTERLAMBDAREQUIREMENTS_MSG);
+  // hashing everything first gives the changed count for the header, the
+  // changed elements are encoded again when they are written
+  std::vector<std::uint64_t> element_hashes{};
+  element_hashes.reserve(vector_input_data.size());
+  std::vector<bool> element_changed(vector_input_data.size(), false);
+  size_t changed_count{0};
+  ByteVectorWithCounter element_bytes{size_t{0}};
+  for (const auto &element : vector_input_data) {
+    if (!util::encode_snapshot_element(element_bytes, element,
+                                       element_size_getter_lambda,
+                                       write_element_lambda))
+      return false;
+    const size_t index{element_hashes.size()};
+    element_hashes.push_back(
+        util::snapshot_element_hash(element_bytes.byte_data));
+    if (index >= state.element_hashes.size() ||
+        state.element_hashes[index] != element_hashes[index]) {
+      element_changed[index] = true;
+      ++changed_count;
+    }
+  }
+
+  std::ofstream ofs_output_file(file_name, std::ios::binary);
+  if constexpr (Version > 0) {
+    if (!write_size_to_sink(Version, ofs_output_file)) return false;
+  }
+  if (!write_size_to_sink(util::snapshot_delta_magic, ofs_output_file) ||
+      !write_size_to_sink(state.checksum, ofs_output_file) ||
+      !write_size_to_sink(vector_input_data.size(), ofs_output_file) ||
+      !write_size_to_sink(changed_count, ofs_output_file))
+    return false;
+  size_t index{0};
+  for (const auto &element : vector_input_data) {
+    if (element_changed[index] &&
+        (!util::encode_snapshot_element(element_bytes, element,
+                                        element_size_getter_lambda,
+                                        write_element_lambda) ||
+         !write_size_to_sink(index, ofs_output_file) ||
+         !util::write_snapshot_element(ofs_output_file, element_bytes)))
+      return false;
+    ++index;
+  }
+  ofs_output_file.close();
+  if (!ofs_output_file) return false;
+  state.checksum = util::snapshot_checksum(element_hashes);
+  state.element_hashes = std::move(element_hashes);
+  ++state.deltas_since_base;
+  return true;
+}
+
+// the deltas are laid over the base in the order given, the lambda gets the
+// final bytes of each element like deep_read_vector_from_buffer_view
+template <size_t Version = 0, class Container,
+          class VectorInsertElementLambda>
+auto read_snapshot_with_deltas_from_files(
+    Container &result, const std::string base_file_name,
+    const std::vector<std::string> &delta_file_names,
+    VectorInsertElementLambda &&vector_insert_element_lambda)
+    -> picklejar::optional<Container> {
+  PICKLEJAR_CONCEPT((PickleJarVectorInsertElementSpanLambdaRequirements<
+                        VectorInsertElementLambda, Container>),
+                    VECTORINSERTELEMENTSPANLAMBDAREQUIREMENTS_MSG);
+  auto overlay =
+      util::overlay_snapshot_files<Version>(base_file_name, delta_file_names);
+  if (!overlay) return {};
+  for (const auto &element : overlay->elements) {
+    ByteSpanWithCounter element_bytes{element};
+    if (!vector_insert_element_lambda(result, element_bytes)) return {};
+  }
+  return PICKLEJAR_MAKE_OPTIONAL(result);
+}
+
+// writes the base with its deltas laid over it as a new base, copying the
+// element bytes as they are; a DifferentialSnapshotState of the last delta
+// stays valid for writing deltas on top of the new base
+template <size_t Version = 0>
+auto compact_snapshot_files(const std::string base_file_name,
+                            const std::vector<std::string> &delta_file_names,
+                            const std::string new_base_file_name) -> bool {
+  auto overlay =
+      util::overlay_snapshot_files<Version>(base_file_name, delta_file_names);
+  if (!overlay) return false;
+  std::ofstream ofs_output_file(new_base_file_name, std::ios::binary);
+  if constexpr (Version > 0) {
+    if (!write_size_to_sink(Version, ofs_output_file)) return false;
+  }
+  if (!write_size_to_sink(overlay->elements.size(), ofs_output_file))
+    return false;
+  for (const auto &element : overlay->elements) {
+    if (!write_size_to_sink(element.size(), ofs_output_file) ||
+        !sink_write(ofs_output_file, element.data(), element.size()))
+      return false;
+  }
+  ofs_output_file.close();
+  return bool(ofs_output_file);
 }
+// END DIFFERENTIAL SNAPSHOTS
 
 }  // namespace picklejar
 #endif
@@ -19,8 +19,26 @@
 #include <hexer.hpp>
 #include <picklejar.hpp>
 
+#include "picklejartests_appender.hpp"
+#include "picklejartests_background.hpp"
 #include "picklejartests_buffer.hpp"
+#include "picklejartests_columnar.hpp"
+#include "picklejartests_cursor.hpp"
+#include "picklejartests_differential.hpp"
 #include "picklejartests_file.hpp"
+#include "picklejartests_header.hpp"
+#include "picklejartests_integerencoding.hpp"
+#include "picklejartests_map.hpp"
+#include "picklejartests_migration.hpp"
+#include "picklejartests_parallel.hpp"
+#include "picklejartests_pipeline.hpp"
+#include "picklejartests_pmr.hpp"
+#include "picklejartests_portable.hpp"
+#include "picklejartests_projection.hpp"
+#include "picklejartests_readahead.hpp"
+#include "picklejartests_sinksource.hpp"
+#include "picklejartests_snapshot.hpp"
+#include "picklejartests_stringcolumn.hpp"
 #include "picklejartests_teststructures.hpp"
 
 using namespace boost::ut;
@@ -28,6 +46,24 @@ using namespace boost::ut;
 int main() {
   picklejartests_file();
   picklejartests_buffer();
+  picklejartests_cursor();
+  picklejartests_portable();
+  picklejartests_header();
+  picklejartests_migration();
+  picklejartests_map();
+  picklejartests_stringcolumn();
+  picklejartests_pmr();
+  picklejartests_columnar();
+  picklejartests_integerencoding();
+  picklejartests_projection();
+  picklejartests_sinksource();
+  picklejartests_readahead();
+  picklejartests_background();
+  picklejartests_pipeline();
+  picklejartests_parallel();
+  picklejartests_appender();
+  picklejartests_snapshot();
+  picklejartests_differential();
   // namespace u = boost::ut;
   // using namespace boost::ut::literals;
   // using namespace boost::ut::operators::terse;
@@ -0,0 +1,161 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <thread>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+struct AppendedEvent {
+  std::uint32_t producer{0};
+  std::uint32_t sequence{0};
+  std::string message{};
+};
+
+inline void picklejartests_appender() {
+  auto &&event_size_getter = [](const AppendedEvent &event) {
+    return 2 * sizeof(std::uint32_t) +
+           picklejar::sizeof_unversioned(event.message);
+  };
+  auto &&event_writer = [](auto &sink, const AppendedEvent &event,
+                           size_t /*element_size*/) {
+    const std::array<std::uint32_t, 2> header{event.producer, event.sequence};
+    return picklejar::sink_write(
+               sink, reinterpret_cast<const char *>(header.data()),
+               sizeof(header)) &&
+           picklejar::write_string(event.message, sink);
+  };
+  auto &&event_reader = [](std::vector<AppendedEvent> &_result,
+                           picklejar::ByteVectorWithCounter &element_bytes) {
+    auto optional_header =
+        picklejar::read_frame<std::uint32_t, std::uint32_t>(element_bytes);
+    if (!optional_header) return false;
+    auto optional_message = picklejar::read_string(element_bytes);
+    if (!optional_message) return false;
+    _result.push_back({std::get<0>(optional_header.value()),
+                       std::get<1>(optional_header.value()),
+                       optional_message.value()});
+    return true;
+  };
+  auto &&make_message = [](size_t producer, size_t sequence) {
+    return std::string((producer * 7 + sequence) % 100, char('a' + producer));
+  };
+
+  "concurrent_appender_many_producers"_test = [&] {
+    constexpr size_t producer_count = 8;
+    constexpr size_t events_per_producer = 4'000;
+    {
+      // tiny segments so records keep crossing segment ends and producers
+      // have to wait for the flusher to recycle them
+      picklejar::ConcurrentAppender<1, picklejar::CFileSink> appender{
+          {1024, 2}, "appender.data"};
+      std::vector<std::thread> producers{};
+      for (size_t producer{0}; producer < producer_count; ++producer) {
+        producers.emplace_back([&, producer] {
+          for (size_t sequence{0}; sequence < events_per_producer;
+               ++sequence) {
+            const AppendedEvent event{std::uint32_t(producer),
+                                      std::uint32_t(sequence),
+                                      make_message(producer, sequence)};
+            if (!appender.append(event, event_size_getter(event),
+                                 event_writer))
+              return;
+          }
+        });
+      }
+      for (auto &producer : producers) producer.join();
+      expect(producer_count * events_per_producer ==
+             appender.records_appended());
+      expect(true == appender.close());
+      expect(std::filesystem::file_size("appender.data") ==
+             appender.bytes_written());
+    }
+
+    std::ifstream ifstream_input_file("appender.data", std::ios::binary);
+    std::vector<AppendedEvent> result{};
+    auto optional_result = picklejar::deep_read_records_from_source<1>(
+        result, ifstream_input_file, event_reader);
+    expect(true == optional_result.has_value());
+    expect(producer_count * events_per_producer ==
+           optional_result.value().size());
+    // every producer's events arrive complete and in its own order
+    std::array<size_t, producer_count> next_sequence{};
+    bool events_match{true};
+    for (const auto &event : optional_result.value()) {
+      events_match = events_match && event.producer < producer_count &&
+                     event.sequence == next_sequence[event.producer]++ &&
+                     event.message == make_message(event.producer,
+                                                   event.sequence);
+    }
+    expect(true == events_match);
+  };
+
+  "concurrent_appender_rejects_oversized_records"_test = [&] {
+    picklejar::ConcurrentAppender<0, picklejar::CFileSink> appender{
+        {256, 2}, "appender.data"};
+    const AppendedEvent big_event{0, 0, std::string(300, 'x')};
+    expect(false == appender.append(big_event, event_size_getter(big_event),
+                                    event_writer));
+    const AppendedEvent small_event{0, 1, "fits"};
+    expect(true == appender.append(small_event,
+                                   event_size_getter(small_event),
+                                   event_writer));
+    expect(true == appender.close());
+    expect(false == appender.append(small_event,
+                                    event_size_getter(small_event),
+                                    event_writer))
+        << "a closed appender takes no more records";
+
+    std::ifstream ifstream_input_file("appender.data", std::ios::binary);
+    std::vector<AppendedEvent> result{};
+    auto optional_result = picklejar::deep_read_records_from_source(
+        result, ifstream_input_file, event_reader);
+    expect(true == optional_result.has_value());
+    expect(1 == optional_result.value().size());
+    expect("fits" == optional_result.value().front().message);
+  };
+
+  "concurrent_appender_flushes_a_slow_trickle"_test = [&] {
+    // far from filling a segment, the records still reach the file
+    picklejar::ConcurrentAppender<1, picklejar::CFileSink> appender{
+        {size_t{1} << 20, 2, std::chrono::milliseconds{5}}, "appender.data"};
+    size_t appended_bytes{0};
+    for (std::uint32_t sequence{0}; sequence < 3; ++sequence) {
+      const AppendedEvent event{0, sequence, make_message(0, sequence)};
+      expect(true == appender.append(event, event_size_getter(event),
+                                     event_writer));
+      appended_bytes += 2 * sizeof(size_t) + event_size_getter(event);
+      std::this_thread::sleep_for(std::chrono::milliseconds{2});
+    }
+    for (size_t tries{0};
+         appender.bytes_written() < appended_bytes && tries < 1000; ++tries)
+      std::this_thread::sleep_for(std::chrono::milliseconds{2});
+    expect(appended_bytes == appender.bytes_written());
+    expect(appended_bytes == std::filesystem::file_size("appender.data"))
+        << "the records should be handed to the OS before close()";
+
+    std::ifstream ifstream_input_file("appender.data", std::ios::binary);
+    std::vector<AppendedEvent> result{};
+    auto optional_result = picklejar::deep_read_records_from_source<1>(
+        result, ifstream_input_file, event_reader);
+    expect(true == optional_result.has_value());
+    expect(3 == optional_result.value().size());
+    expect(true == appender.close());
+    expect(appended_bytes == std::filesystem::file_size("appender.data"));
+  };
+}
@@ -0,0 +1,91 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <numeric>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+inline void picklejartests_background() {
+  auto &&string_size_getter = [](const std::string &string_element) {
+    return picklejar::sizeof_unversioned(string_element);
+  };
+  auto &&string_writer = [](auto &sink, const std::string &string_element,
+                            size_t /*element_size*/) {
+    return picklejar::write_string(string_element, sink);
+  };
+  auto &&string_reader = [](std::vector<std::string> &_result,
+                            picklejar::ByteVectorWithCounter &element_bytes) {
+    auto optional_string = picklejar::read_string(element_bytes);
+    if (!optional_string) return false;
+    _result.push_back(optional_string.value());
+    return true;
+  };
+
+  "background_deep_copy_to_file"_test = [&] {
+    std::vector<std::string> strings{};
+    for (size_t i{0}; i < 20'000; ++i)
+      strings.push_back(std::string(i % 50, char('a' + i % 26)));
+    // small buffers and a single queued buffer so the writer has to wait
+    auto writer = picklejar::deep_copy_vector_to_file_in_background<1>(
+        strings, "background.data", string_size_getter, string_writer,
+        {4096, 1});
+    expect(true == writer.wait());
+    expect(writer.bytes_encoded() == writer.bytes_written());
+    expect(std::filesystem::file_size("background.data") ==
+           writer.bytes_written());
+    expect(false == writer.write("x", 1)) << "a finished writer is closed";
+
+    std::vector<std::string> result{};
+    auto optional_result = picklejar::deep_read_vector_from_file<1>(
+        result, "background.data", string_reader);
+    expect(true == optional_result.has_value());
+    expect(true == (strings == optional_result.value()));
+  };
+
+  "background_sink_with_cfile_and_failures"_test = [] {
+    std::vector<std::uint32_t> numbers(300'000);
+    std::iota(numbers.begin(), numbers.end(), std::uint32_t{5});
+    {
+      picklejar::BackgroundSink<picklejar::CFileSink> sink{
+          {size_t{64} << 10, 4}, "background.data"};
+      // bigger than a buffer, it is split across several of them
+      expect(true == picklejar::write_vector_to_sink(numbers, sink));
+      expect(numbers.size() * sizeof(std::uint32_t) == sink.position());
+      expect(true == sink.wait());
+      expect(sink.position() == sink.bytes_written());
+    }
+    std::vector<std::uint32_t> result{};
+    auto optional_result =
+        picklejar::read_vector_from_file<std::uint32_t>("background.data");
+    expect(true == optional_result.has_value());
+    expect(true == (numbers == optional_result.value()));
+
+    picklejar::BackgroundFileSink missing_directory{
+        {}, "background_missing_directory/background.data"};
+    expect(false == missing_directory.good());
+    expect(false == missing_directory.write("x", 1));
+    expect(false == missing_directory.wait());
+
+    picklejar::BackgroundFileSink cancelled{{}, "background.data"};
+    expect(true == cancelled.write("x", 1));
+    cancelled.cancel();
+    expect(false == cancelled.wait());
+    expect(0 == cancelled.bytes_written());
+  };
+}
@@ -448,4 +448,163 @@ inline void picklejartests_buffer() {
         buffer_v1_test_data_innerstruct,
         prepare_triviallyconstructiblestruct_array_for_tests);
   };
+
+  "deep_read_vector_from_buffer_view_nested"_test = [] {
+    std::vector<std::vector<int>> nested_vec{{1, 2, 3}, {4, 5}};
+    auto &&inner_size = [](const std::vector<int> &inner) -> size_t {
+      return 2 * sizeof(size_t) + inner.size() * (sizeof(size_t) + sizeof(int));
+    };
+    size_t total_size{2 * sizeof(size_t)};
+    for (const auto &inner : nested_vec)
+      total_size += sizeof(size_t) + inner_size(inner);
+    picklejar::ByteVectorWithCounter byte_vector_with_counter{total_size};
+    expect(true ==
+           picklejar::write_vector_deep_copy<1, picklejar::ByteVectorWithCounter,
+                                             picklejar::write_object_to_buffer>(
+               nested_vec, byte_vector_with_counter, inner_size,
+               [](picklejar::ByteVectorWithCounter &buffer,
+                  const std::vector<int> &inner, size_t /*element_size*/) {
+                 return picklejar::write_vector_deep_copy<
+                     1, picklejar::ByteVectorWithCounter,
+                     picklejar::write_object_to_buffer>(
+                     inner, buffer,
+                     [](const int &) -> size_t { return sizeof(int); },
+                     [](picklejar::ByteVectorWithCounter &_buffer,
+                        const int &value, size_t /*element_size*/) {
+                       return _buffer.write(value);
+                     });
+               }));
+    byte_vector_with_counter.set_counter(0);
+
+    const char *parent_begin = byte_vector_with_counter.byte_data.data();
+    const char *parent_end = parent_begin + byte_vector_with_counter.size();
+    bool aliases_parent{true};
+    std::vector<std::vector<int>> result{};
+    auto optional_result = picklejar::deep_read_vector_from_buffer_view<1>(
+        result, byte_vector_with_counter,
+        [&](auto &outer_result, picklejar::ByteSpanWithCounter &element_span) {
+          aliases_parent = aliases_parent &&
+                           element_span.byte_data.data() >= parent_begin &&
+                           element_span.byte_data.data() < parent_end;
+          std::vector<int> inner{};
+          auto optional_inner = picklejar::deep_read_vector_from_buffer_view<1>(
+              inner, element_span,
+              [&](auto &inner_result,
+                  picklejar::ByteSpanWithCounter &value_span) {
+                aliases_parent = aliases_parent &&
+                                 value_span.byte_data.data() >= parent_begin &&
+                                 value_span.byte_data.data() < parent_end;
+                auto optional_value =
+                    picklejar::read_object_from_buffer<int>(value_span);
+                if (value_span.invalid() || !optional_value) return false;
+                inner_result.push_back(optional_value.value());
+                return true;
+              });
+          if (!optional_inner) return false;
+          outer_result.push_back(optional_inner.value());
+          return true;
+        });
+    expect(true == optional_result.has_value()) << "nested view read failed";
+    expect(true == (nested_vec == optional_result.value()))
+        << "nested view read doesn't match the written data";
+    expect(true == aliases_parent)
+        << "nested spans should point into the parent buffer";
+    expect(0 == byte_vector_with_counter.size_remaining());
+
+    byte_vector_with_counter.set_counter(0);
+    std::vector<std::vector<int>> wrong_version_result{};
+    expect(false == picklejar::deep_read_vector_from_buffer_view<2>(
+                        wrong_version_result, byte_vector_with_counter,
+                        [](auto &, picklejar::ByteSpanWithCounter &) {
+                          return true;
+                        })
+                        .has_value());
+  };
+
+  "string_buffer_owned_and_borrowed"_test = [] {
+    const std::string first_string{"pickle"};
+    picklejar::ByteVectorWithCounter byte_vector_with_counter{
+        picklejar::sizeof_unversioned(first_string) +
+        picklejar::sizeof_unversioned(std::string_view{"jar"})};
+    expect(true == picklejar::write_string(first_string,
+                                           byte_vector_with_counter));
+    expect(true == picklejar::write_string(std::string_view{"jar"},
+                                           byte_vector_with_counter));
+
+    byte_vector_with_counter.set_counter(0);
+    auto optional_owned = picklejar::read_string(byte_vector_with_counter);
+    expect(true == optional_owned.has_value());
+    expect(first_string == optional_owned.value());
+    auto optional_borrowed =
+        picklejar::read_string_view(byte_vector_with_counter);
+    expect(true == optional_borrowed.has_value());
+    expect(std::string_view{"jar"} == optional_borrowed.value());
+    expect(true == (optional_borrowed.value().data() >
+                    byte_vector_with_counter.byte_data.data()))
+        << "read_string_view should borrow the buffer bytes";
+    expect(0 == byte_vector_with_counter.size_remaining());
+
+    // a size that is bigger than what's left invalidates the buffer
+    picklejar::ByteVectorWithCounter truncated{sizeof(size_t) + 2};
+    expect(true == truncated.write(size_t{10}));
+    truncated.set_counter(0);
+    expect(false == picklejar::read_string_view(truncated).has_value());
+    expect(true == truncated.invalid());
+  };
+
+  "deep_copy_plan_exact_buffer_and_offsets"_test = [] {
+    const std::vector<std::string> string_vec{"a", "much longer than 32 bytes",
+                                              "", "pickle"};
+    size_t getter_calls{0};
+    auto &&string_size_getter = [&](const std::string &string_element) {
+      ++getter_calls;
+      return picklejar::sizeof_unversioned(string_element);
+    };
+    auto &&string_writer = [](picklejar::ByteVectorWithCounter &buffer,
+                              const std::string &string_element,
+                              size_t /*element_size*/) {
+      return picklejar::write_string(string_element, buffer);
+    };
+
+    const picklejar::DeepCopyPlan plan =
+        picklejar::make_deep_copy_plan<3>(string_vec, string_size_getter);
+    expect(4 == getter_calls);
+    expect(4 == plan.element_sizes.size());
+    picklejar::ByteVectorWithCounter byte_vector_with_counter{plan.byte_size};
+    expect(true ==
+           picklejar::write_vector_deep_copy_with_plan<
+               3, picklejar::ByteVectorWithCounter,
+               picklejar::write_object_to_buffer>(
+               string_vec, plan, byte_vector_with_counter, string_writer));
+    expect(4 == getter_calls) << "the write pass should use the cached sizes";
+    expect(0 == byte_vector_with_counter.size_remaining());
+
+    // the offsets index the size header of each element
+    const auto offsets = plan.element_offsets();
+    byte_vector_with_counter.set_counter(offsets.at(3) + sizeof(size_t));
+    expect("pickle" ==
+           picklejar::read_string(byte_vector_with_counter).value());
+
+    // deep_copy_vector_to_buffer sizes its buffer with a plan, so elements
+    // bigger than sizeof(Type) fit
+    getter_calls = 0;
+    auto optional_buffer = picklejar::deep_copy_vector_to_buffer<3>(
+        string_vec, string_size_getter, string_writer);
+    expect(true == optional_buffer.has_value());
+    expect(4 == getter_calls);
+    expect(plan.byte_size == optional_buffer.value().size());
+    expect(0 == optional_buffer.value().size_remaining());
+    optional_buffer.value().set_counter(0);
+    std::vector<std::string> result{};
+    auto optional_result = picklejar::deep_read_vector_from_buffer_view<3>(
+        result, optional_buffer.value(),
+        [](auto &_result, picklejar::ByteSpanWithCounter &element_bytes) {
+          auto optional_string = picklejar::read_string(element_bytes);
+          if (!optional_string) return false;
+          _result.push_back(optional_string.value());
+          return true;
+        });
+    expect(true == optional_result.has_value());
+    expect(true == (string_vec == optional_result.value()));
+  };
 }
@@ -0,0 +1,114 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+struct ColumnarTrade {
+  std::int64_t timestamp{0};
+  double price{0};
+  char side{'?'};
+  int not_stored{-1};
+  auto operator==(const ColumnarTrade &) const -> bool = default;
+};
+
+inline void picklejartests_columnar() {
+  using TradeLayout =
+      picklejar::ColumnLayout<&ColumnarTrade::timestamp, &ColumnarTrade::price,
+                              &ColumnarTrade::side>;
+  static_assert(TradeLayout::row_width ==
+                sizeof(std::int64_t) + sizeof(double) + sizeof(char));
+  // more rows than a single scratch chunk
+  auto &&make_trades = [] {
+    std::vector<ColumnarTrade> trades(picklejar::util::columnar_chunk_rows + 7);
+    for (size_t i{0}; i < trades.size(); ++i) {
+      trades[i] = {std::int64_t(1'000'000 + i), double(i) * 0.25,
+                   i % 2 == 0 ? 'B' : 'S', 42};
+    }
+    return trades;
+  };
+
+  "columnar_file_full_and_projection"_test = [&] {
+    const auto trades = make_trades();
+    expect(true == picklejar::write_vector_columnar_to_file<TradeLayout>(
+                       trades, "columnar.data"));
+    expect(TradeLayout::byte_size(trades.size()) ==
+           picklejar::arena_size_for_file("columnar.data"));
+
+    auto optional_trades =
+        picklejar::read_vector_columnar_from_file<TradeLayout>("columnar.data");
+    expect(true == optional_trades.has_value());
+    expect(trades.size() == optional_trades.value().size());
+    expect(-1 == optional_trades.value().back().not_stored)
+        << "members outside the layout keep their default value";
+    auto expected_back = trades.back();
+    expected_back.not_stored = -1;
+    expect(true == (expected_back == optional_trades.value().back()));
+
+    std::vector<double> prices{};
+    auto optional_prices =
+        picklejar::read_column_from_file<TradeLayout, 1>(prices,
+                                                         "columnar.data");
+    expect(true == optional_prices.has_value());
+    expect(trades.size() == optional_prices.value().size());
+    expect(trades.at(4100).price == optional_prices.value().at(4100));
+
+    using WrongLayout =
+        picklejar::ColumnLayout<&ColumnarTrade::timestamp, &ColumnarTrade::side>;
+    std::vector<char> sides{};
+    expect(false == picklejar::read_column_from_file<WrongLayout, 1>(
+                        sides, "columnar.data")
+                        .has_value())
+        << "a file written with another layout should be rejected";
+  };
+
+  "columnar_buffer_full_and_projection"_test = [&] {
+    const auto trades = make_trades();
+    auto optional_buffer =
+        picklejar::write_vector_columnar_to_buffer<TradeLayout>(trades);
+    expect(true == optional_buffer.has_value());
+    expect(0 == optional_buffer.value().size_remaining());
+
+    optional_buffer.value().set_counter(0);
+    std::vector<char> sides{};
+    auto optional_sides = picklejar::read_column_from_buffer<TradeLayout, 2>(
+        sides, optional_buffer.value());
+    expect(true == optional_sides.has_value());
+    expect('S' == optional_sides.value().at(3));
+    expect(0 == optional_buffer.value().size_remaining())
+        << "the counter should move past the columnar data";
+
+    optional_buffer.value().set_counter(0);
+    std::vector<ColumnarTrade> result{};
+    auto optional_result = picklejar::read_vector_columnar_from_buffer<
+        TradeLayout>(result, optional_buffer.value());
+    expect(true == optional_result.has_value());
+    expect(trades.at(17).timestamp == optional_result.value().at(17).timestamp);
+    expect(trades.at(17).price == optional_result.value().at(17).price);
+
+    picklejar::ByteVectorWithCounter truncated{
+        optional_buffer.value().byte_data.begin(),
+        optional_buffer.value().byte_data.end() - 1};
+    std::vector<ColumnarTrade> truncated_result{};
+    expect(false == picklejar::read_vector_columnar_from_buffer<TradeLayout>(
+                        truncated_result, truncated)
+                        .has_value());
+    expect(true == truncated.invalid());
+  };
+}
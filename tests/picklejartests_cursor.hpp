@@ -0,0 +1,117 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <picklejar.hpp>
+
+#include "picklejartests_teststructures.hpp"
+
+using namespace boost::ut;
+
+inline void picklejartests_cursor() {
+  "byte_cursor_batch_read"_test = [] {
+    std::vector<int> int_vec{1, 2, 3, 4, 5};
+    auto bytes = picklejar::write_vector_to_buffer(int_vec);
+    auto byte_vector_with_counter =
+        picklejar::ByteVectorWithCounter{std::begin(bytes), std::end(bytes)};
+
+    picklejar::ByteCursor cursor{byte_vector_with_counter};
+    expect(true == cursor.check(int_vec.size() * sizeof(int)))
+        << "cursor should have room for the whole batch";
+    int sum{0};
+    for (size_t i{0}; i < int_vec.size(); ++i)
+      sum += cursor.read_unchecked<int>();
+    expect(15 == sum) << "unchecked reads returned the wrong values";
+    expect(true == cursor.commit(byte_vector_with_counter))
+        << "commit of a valid cursor failed";
+    expect(0 == byte_vector_with_counter.size_remaining())
+        << "commit did not move the counter to the end";
+  };
+
+  "byte_cursor_sticky_error"_test = [] {
+    picklejar::ByteVectorWithCounter byte_vector_with_counter(sizeof(int));
+    picklejar::ByteCursor cursor{byte_vector_with_counter};
+    expect(false == cursor.check(sizeof(int) * 2))
+        << "check should fail when there aren't enough bytes";
+    expect(false == cursor.check(1))
+        << "error flag should be sticky after a failed check";
+    int value{};
+    expect(false == cursor.read(value)) << "read on an invalid cursor";
+    expect(false == cursor.commit(byte_vector_with_counter))
+        << "commit of an invalid cursor should fail";
+    expect(true == byte_vector_with_counter.invalid())
+        << "commit should invalidate the counter of the original buffer";
+  };
+
+  "byte_cursor_write_then_read"_test = [] {
+    picklejar::ByteVectorWithCounter byte_vector_with_counter(
+        sizeof(TrivialStructure) + sizeof(double));
+    picklejar::ByteCursor write_cursor{byte_vector_with_counter};
+    TrivialStructure trivial{1, 2, 3, 4};
+    expect(true == write_cursor.write(trivial));
+    expect(true == write_cursor.write(4.5));
+    expect(true == write_cursor.commit(byte_vector_with_counter));
+
+    byte_vector_with_counter.set_counter(0);
+    auto optional_trivial =
+        byte_vector_with_counter.read<TrivialStructure>();
+    auto optional_double = byte_vector_with_counter.read<double>();
+    expect(true == (optional_trivial.value() == trivial))
+        << "cursor writes can't be read back by ByteVectorWithCounter";
+    expect(4.5 == optional_double.value());
+  };
+
+  "byte_frame_reader"_test = [] {
+    picklejar::ByteVectorWithCounter byte_vector_with_counter(
+        sizeof(int) + sizeof(double) + sizeof(size_t));
+    expect(true == byte_vector_with_counter.write(7));
+    expect(true == byte_vector_with_counter.write(2.5));
+    expect(true == byte_vector_with_counter.write(size_t{42}));
+    byte_vector_with_counter.set_counter(0);
+
+    picklejar::ByteFrameReader frame{byte_vector_with_counter,
+                                     picklejar::frame_size<int, double>()};
+    expect(true == frame.valid()) << "frame should fit in the buffer";
+    expect(7 == frame.read<int>());
+    expect(2.5 == frame.read<double>());
+    expect(true == frame.commit());
+    expect(sizeof(size_t) == byte_vector_with_counter.size_remaining())
+        << "commit should only advance the counter by the frame";
+    expect(42 == byte_vector_with_counter.read<size_t>().value())
+        << "bytes after the frame can still be read with the counter";
+  };
+
+  "read_frame_tuple"_test = [] {
+    picklejar::ByteVectorWithCounter byte_vector_with_counter(sizeof(int) * 2);
+    expect(true == byte_vector_with_counter.write(3));
+    expect(true == byte_vector_with_counter.write(4));
+    byte_vector_with_counter.set_counter(0);
+    auto optional_fields =
+        picklejar::read_frame<int, int>(byte_vector_with_counter);
+    expect(true == optional_fields.has_value());
+    expect(3 == std::get<0>(optional_fields.value()));
+    expect(4 == std::get<1>(optional_fields.value()));
+
+    byte_vector_with_counter.set_counter(0);
+    auto optional_too_big =
+        picklejar::read_frame<int, int, int>(byte_vector_with_counter);
+    expect(false == optional_too_big.has_value())
+        << "a frame larger than the buffer should fail";
+    expect(true == byte_vector_with_counter.invalid())
+        << "a frame that doesn't fit should invalidate the counter";
+  };
+}
@@ -0,0 +1,210 @@
+#include <boost/ut.hpp>
+#include <fstream>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <string>
+#include <vector>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+inline void picklejartests_differential() {
+  std::vector<std::string> strings{};
+  for (size_t i{0}; i < 1'000; ++i)
+    strings.push_back(std::to_string(i) + std::string(i % 15, 'd'));
+  auto &&string_size_getter = [](const std::string &string_element) {
+    return picklejar::sizeof_unversioned(string_element);
+  };
+  auto &&string_writer = [](auto &sink, const std::string &string_element,
+                            size_t /*element_size*/) {
+    return picklejar::write_string(string_element, sink);
+  };
+  auto &&string_view_reader = [](std::vector<std::string> &_result,
+                                 picklejar::ByteSpanWithCounter &element_bytes) {
+    auto optional_string = picklejar::read_string(element_bytes);
+    if (!optional_string) return false;
+    _result.push_back(optional_string.value());
+    return true;
+  };
+  auto &&file_size = [](const std::string &file_name) {
+    std::ifstream ifs_input_file(file_name, std::ios::binary);
+    return picklejar::util::ifstream_remaining_bytes(ifs_input_file);
+  };
+
+  "differential_snapshot_deltas_and_compaction"_test = [&] {
+    picklejar::DifferentialSnapshotState state{};
+    expect(true == picklejar::write_snapshot_base<1>(
+                       strings, "differential_base.data", state,
+                       string_size_getter, string_writer));
+    expect(strings.size() == state.element_hashes.size());
+
+    // the base is a plain deep copied file
+    std::vector<std::string> plain_result{};
+    auto optional_plain = picklejar::deep_read_vector_from_file<1>(
+        plain_result, "differential_base.data",
+        [](std::vector<std::string> &_result,
+           picklejar::ByteVectorWithCounter &element_bytes) {
+          auto optional_string = picklejar::read_string(element_bytes);
+          if (!optional_string) return false;
+          _result.push_back(optional_string.value());
+          return true;
+        });
+    expect(true == optional_plain.has_value());
+    expect(strings == optional_plain.value());
+
+    std::vector<std::string> modified{strings};
+    modified[3] = "changed";
+    modified[500] = "also changed";
+    modified.push_back("added");
+    expect(true == picklejar::write_snapshot_delta<1>(
+                       modified, "differential_delta1.data", state,
+                       string_size_getter, string_writer));
+    expect(1 == state.deltas_since_base);
+    expect(file_size("differential_delta1.data") <
+           file_size("differential_base.data") / 10)
+        << "only the changed elements should be written";
+
+    modified.resize(900);
+    modified[0] = "first";
+    expect(true == picklejar::write_snapshot_delta<1>(
+                       modified, "differential_delta2.data", state,
+                       string_size_getter, string_writer));
+
+    std::vector<std::string> result{};
+    auto optional_result =
+        picklejar::read_snapshot_with_deltas_from_files<1>(
+            result, "differential_base.data",
+            {"differential_delta1.data", "differential_delta2.data"},
+            string_view_reader);
+    expect(true == optional_result.has_value());
+    expect(modified == optional_result.value());
+
+    std::vector<std::string> first_result{};
+    auto optional_first = picklejar::read_snapshot_with_deltas_from_files<1>(
+        first_result, "differential_base.data", {"differential_delta1.data"},
+        string_view_reader);
+    expect(true == optional_first.has_value());
+    expect(strings.size() + 1 == optional_first.value().size());
+    expect("also changed" == optional_first.value().at(500));
+
+    expect(true == picklejar::compact_snapshot_files<1>(
+                       "differential_base.data",
+                       {"differential_delta1.data", "differential_delta2.data"},
+                       "differential_compacted.data"));
+    // the state of the last delta keeps working on the compacted base
+    modified[899] = "last";
+    expect(true == picklejar::write_snapshot_delta<1>(
+                       modified, "differential_delta3.data", state,
+                       string_size_getter, string_writer));
+    std::vector<std::string> compacted_result{};
+    auto optional_compacted =
+        picklejar::read_snapshot_with_deltas_from_files<1>(
+            compacted_result, "differential_compacted.data",
+            {"differential_delta3.data"}, string_view_reader);
+    expect(true == optional_compacted.has_value());
+    expect(modified == optional_compacted.value());
+  };
+
+  "differential_snapshot_rejects_wrong_chain"_test = [&] {
+    picklejar::DifferentialSnapshotState state{};
+    expect(true == picklejar::write_snapshot_base<1>(
+                       strings, "differential_base.data", state,
+                       string_size_getter, string_writer));
+    std::vector<std::string> modified{strings};
+    modified[1] = "one";
+    expect(true == picklejar::write_snapshot_delta<1>(
+                       modified, "differential_delta1.data", state,
+                       string_size_getter, string_writer));
+    modified[2] = "two";
+    expect(true == picklejar::write_snapshot_delta<1>(
+                       modified, "differential_delta2.data", state,
+                       string_size_getter, string_writer));
+
+    std::vector<std::string> result{};
+    expect(false == picklejar::read_snapshot_with_deltas_from_files<1>(
+                        result, "differential_base.data",
+                        {"differential_delta2.data"}, string_view_reader)
+                        .has_value())
+        << "a delta missing the one before it should be refused";
+    expect(false == picklejar::read_snapshot_with_deltas_from_files<2>(
+                        result, "differential_base.data",
+                        {"differential_delta1.data"}, string_view_reader)
+                        .has_value())
+        << "a different version should be refused";
+    expect(false == picklejar::read_snapshot_with_deltas_from_files<1>(
+                        result, "differential_missing.data", {},
+                        string_view_reader)
+                        .has_value());
+  };
+
+  "differential_snapshot_rejects_holes_and_repeated_indices"_test = [&] {
+    picklejar::DifferentialSnapshotState state{};
+    expect(true == picklejar::write_snapshot_base<1>(
+                       strings, "differential_base.data", state,
+                       string_size_getter, string_writer));
+    // writes a delta by hand so its indices can be anything
+    auto &&write_forged_delta = [&](size_t element_count,
+                                    const std::vector<size_t> &indices) {
+      std::ofstream ofs_output_file("differential_forged.data",
+                                    std::ios::binary);
+      auto &&write_size = [&](size_t size_to_write) {
+        ofs_output_file.write(reinterpret_cast<const char *>(  // NOLINT
+                                  &size_to_write),
+                              sizeof(size_t));
+      };
+      write_size(1);
+      write_size(picklejar::util::snapshot_delta_magic);
+      write_size(state.checksum);
+      write_size(element_count);
+      write_size(indices.size());
+      for (const size_t index : indices) {
+        const std::string element{"forged"};
+        write_size(index);
+        write_size(picklejar::sizeof_unversioned(element));
+        write_size(element.size());
+        ofs_output_file.write(element.data(),
+                              static_cast<std::streamsize>(element.size()));
+      }
+    };
+
+    write_forged_delta(strings.size() + 2, {strings.size() + 1, strings.size()});
+    std::vector<std::string> result{};
+    auto optional_result = picklejar::read_snapshot_with_deltas_from_files<1>(
+        result, "differential_base.data", {"differential_forged.data"},
+        string_view_reader);
+    expect(true == optional_result.has_value());
+    expect(strings.size() + 2 == optional_result.value().size());
+    expect("forged" == optional_result.value().back());
+
+    write_forged_delta(strings.size() + 2, {strings.size() + 1});
+    std::vector<std::string> hole_result{};
+    expect(false == picklejar::read_snapshot_with_deltas_from_files<1>(
+                        hole_result, "differential_base.data",
+                        {"differential_forged.data"}, string_view_reader)
+                        .has_value())
+        << "an added element missing from the delta should be refused";
+
+    write_forged_delta(strings.size(), {5, 5});
+    std::vector<std::string> repeated_result{};
+    expect(false == picklejar::read_snapshot_with_deltas_from_files<1>(
+                        repeated_result, "differential_base.data",
+                        {"differential_forged.data"}, string_view_reader)
+                        .has_value())
+        << "an index changed twice in one delta should be refused";
+  };
+}
@@ -549,4 +549,20 @@ void picklejartests_file() {
     expect(false == recovered_optional.has_value())
         << "returned optional SHOULD NOT have value";
   };
+
+  "string_stream_write_read"_test = [] {
+    {
+      std::ofstream ofs_output_file("filetests.string", std::ios::binary);
+      expect(true == picklejar::write_string(std::string_view{"first"},
+                                             ofs_output_file));
+      expect(true == picklejar::write_string(std::string{}, ofs_output_file));
+      expect(true == picklejar::write_string_to_stream("third", ofs_output_file));
+    }
+    std::ifstream ifs_input_file("filetests.string", std::ios::binary);
+    expect("first" == picklejar::read_string(ifs_input_file).value());
+    expect(std::string{} == picklejar::read_string(ifs_input_file).value());
+    expect("third" == picklejar::read_string_from_stream(ifs_input_file).value());
+    expect(false == picklejar::read_string(ifs_input_file).has_value())
+        << "reading past the end of the file should fail";
+  };
 }
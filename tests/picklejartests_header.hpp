@@ -0,0 +1,133 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <picklejar.hpp>
+
+#include "picklejartests_teststructures.hpp"
+
+using namespace boost::ut;
+
+inline void picklejartests_header() {
+  "file_header_trivial_vector"_test = [] {
+    std::vector<TrivialStructure> struct_vec{{1, 2, 3, 4}, {5, 6, 7, 8}};
+    expect(true == picklejar::write_vector_to_file_with_header<TrivialStructure,
+                                                               3>(
+                       struct_vec, "header.data"));
+
+    auto optional_header = picklejar::read_file_header_from_file("header.data");
+    expect(true == optional_header.has_value()) << "header should be valid";
+    expect(sizeof(TrivialStructure) == optional_header->type_size);
+    expect(3 == optional_header->user_version);
+    expect(true == optional_header->has_flag(
+                       picklejar::file_header_flag_trivially_copiable));
+
+    auto optional_read_vector =
+        picklejar::read_vector_from_file_with_header<TrivialStructure, 3>(
+            "header.data");
+    expect(true == optional_read_vector.has_value());
+    expect(true == (optional_read_vector.value() == struct_vec))
+        << "bulk read with header failed";
+  };
+
+  "file_header_rejects_mismatch"_test = [] {
+    std::vector<int> int_vec{1, 2, 3, 4};
+    expect(true ==
+           picklejar::write_vector_to_file_with_header(int_vec, "header.data"));
+    expect(false == picklejar::read_vector_from_file_with_header<float>(
+                        "header.data")
+                        .has_value())
+        << "a float reader should reject a file of int";
+    expect(false == picklejar::read_vector_from_file_with_header<int, 1>(
+                        "header.data")
+                        .has_value())
+        << "a different version should be rejected";
+    expect(false ==
+           picklejar::read_vector_from_file_with_header<int>(
+               "header.data", picklejar::layout_hash<int, int>())
+               .has_value())
+        << "a different layout hash should be rejected";
+
+    expect(true == picklejar::write_vector_to_file(int_vec, "header.data"));
+    expect(false == picklejar::read_file_header_from_file("header.data")
+                        .has_value())
+        << "a file without header should be rejected";
+  };
+
+  "file_header_portable_and_deep_copy"_test = [] {
+    std::vector<double> double_vec{1.5, 2.5};
+    expect(true == picklejar::write_vector_to_file_with_header_portable(
+                       double_vec, "header.data"));
+    auto optional_read_vector =
+        picklejar::read_vector_from_file_with_header<double>("header.data");
+    expect(true == (optional_read_vector.value() == double_vec))
+        << "portable read with header failed";
+
+    std::vector<std::string> string_vec{"one", "two", "three"};
+    expect(true == picklejar::deep_copy_vector_to_file_with_header<2>(
+                       string_vec, "header_deep.data",
+                       [](const std::string &string) { return string.size(); },
+                       [](auto &ofs_output_file, const std::string &object,
+                          size_t element_size) {
+                         return picklejar::basic_stream_write(
+                             ofs_output_file, object.data(), element_size);
+                       }));
+    std::vector<std::string> result{};
+    auto optional_result =
+        picklejar::deep_read_vector_from_file_with_header<2>(
+            result, "header_deep.data",
+            [](auto &_result,
+               picklejar::ByteVectorWithCounter &byte_vector_with_counter) {
+              _result.emplace_back(std::begin(byte_vector_with_counter),
+                                   std::end(byte_vector_with_counter));
+              byte_vector_with_counter.set_counter(
+                  byte_vector_with_counter.size());
+              return true;
+            });
+    expect(true == (optional_result.value() == string_vec))
+        << "deep copy with header failed";
+  };
+
+  "file_header_fields_in_portable_order"_test = [] {
+    const auto header = picklejar::make_file_header<std::uint32_t, 7>(
+        0x0102030405060708ULL, picklejar::file_header_flag_portable_encoding);
+    picklejar::ByteVectorWithCounter header_buffer{
+        sizeof(picklejar::FileHeader)};
+    expect(true ==
+           picklejar::write_file_header_to_buffer(header, header_buffer));
+    // the same bytes on hosts of either byte order
+    auto &&byte_at = [&](size_t offset) {
+      return int(static_cast<unsigned char>(header_buffer.byte_data[offset]));
+    };
+    expect(1 == byte_at(8) && 0 == byte_at(11)) << "format version";
+    expect(0 != (byte_at(12) &
+                 int(picklejar::file_header_flag_portable_encoding)))
+        << "the flags should be in the first byte";
+    expect(4 == byte_at(16) && 0 == byte_at(23)) << "type size";
+    expect(0x08 == byte_at(40) && 0x01 == byte_at(47)) << "layout hash";
+    expect(7 == byte_at(48)) << "user version";
+
+    header_buffer.set_counter(0);
+    auto optional_header =
+        picklejar::read_file_header_from_buffer(header_buffer);
+    expect(true == optional_header.has_value());
+    expect(true == picklejar::file_header_matches<std::uint32_t, 7>(
+                       optional_header.value(), 0x0102030405060708ULL));
+    expect(true == optional_header->has_flag(
+                       picklejar::file_header_flag_portable_encoding));
+  };
+}
@@ -0,0 +1,210 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+struct EncodedSeries {
+  int series_id{};
+  std::vector<std::int64_t> timestamps{};
+};
+
+inline void picklejartests_integerencoding() {
+  "integer_encodings_buffer_round_trip"_test = [] {
+    // sorted timestamps, 37 elements so the SIMD prefix sum has a tail
+    std::vector<std::int64_t> timestamps{};
+    for (std::int64_t i{0}; i < 37; ++i) {
+      timestamps.push_back(1'700'000'000'000 + i * 3 + i % 5);
+    }
+    for (auto encoding : {picklejar::IntegerEncoding::delta,
+                          picklejar::IntegerEncoding::frame_of_reference,
+                          picklejar::IntegerEncoding::run_length,
+                          picklejar::IntegerEncoding::smallest}) {
+      auto optional_buffer =
+          picklejar::write_encoded_integers_to_buffer<2>(timestamps, encoding);
+      expect(true == optional_buffer.has_value());
+      expect(0 == optional_buffer.value().size_remaining());
+      optional_buffer.value().set_counter(0);
+      std::vector<std::int64_t> result{};
+      auto optional_result = picklejar::read_encoded_integers_from_buffer<2>(
+          result, optional_buffer.value());
+      expect(true == optional_result.has_value())
+          << "encoding" << int(encoding) << "failed to decode";
+      expect(true == (timestamps == optional_result.value()));
+    }
+    auto plan = picklejar::make_integer_encoding_plan(timestamps);
+    expect(picklejar::IntegerEncoding::run_length != plan.encoding);
+    expect(plan.byte_size() < timestamps.size() * sizeof(std::int64_t) / 4)
+        << "sorted timestamps should take about a byte each";
+
+    // negative values, frame of reference over the signed range
+    std::vector<int> signed_values{-40, 7, -3, 1000, -40, 0, 999, 12, 13};
+    auto for_plan = picklejar::make_integer_encoding_plan(
+        signed_values, picklejar::IntegerEncoding::frame_of_reference);
+    // reference, bit width and 9 values of 11 bits
+    expect(8 + 1 + (9 * 11 + 7) / 8 == for_plan.payload.size());
+    picklejar::ByteVectorWithCounter for_buffer{for_plan.byte_size()};
+    expect(true == picklejar::write_integer_encoding_plan(for_plan, for_buffer));
+    for_buffer.set_counter(0);
+    std::vector<int> signed_result{};
+    auto optional_signed_result =
+        picklejar::read_encoded_integers_from_buffer(signed_result, for_buffer);
+    expect(true == optional_signed_result.has_value());
+    expect(true == (signed_values == optional_signed_result.value()));
+
+    // long runs of small values pick run length
+    std::vector<std::uint8_t> flags(1000, 1);
+    std::fill_n(flags.begin() + 500, 300, std::uint8_t{250});
+    auto rle_plan = picklejar::make_integer_encoding_plan(flags);
+    expect(picklejar::IntegerEncoding::run_length == rle_plan.encoding);
+    expect(rle_plan.payload.size() < 10);
+    std::vector<std::uint16_t> wrong_width_result{};
+    auto optional_rle_buffer = picklejar::write_encoded_integers_to_buffer(flags);
+    optional_rle_buffer.value().set_counter(0);
+    expect(false == picklejar::read_encoded_integers_from_buffer(
+                        wrong_width_result, optional_rle_buffer.value())
+                        .has_value())
+        << "a container of a different width should be rejected";
+
+    // empty containers round trip
+    std::vector<std::int64_t> empty_values{};
+    auto optional_empty_buffer =
+        picklejar::write_encoded_integers_to_buffer(empty_values);
+    optional_empty_buffer.value().set_counter(0);
+    std::vector<std::int64_t> empty_result{};
+    auto optional_empty_result = picklejar::read_encoded_integers_from_buffer(
+        empty_result, optional_empty_buffer.value());
+    expect(true == optional_empty_result.has_value());
+    expect(true == optional_empty_result.value().empty());
+  };
+
+  "integer_encodings_reject_corrupt_counts"_test = [] {
+    const std::vector<std::int64_t> values{5, 6, 8, 8, 11};
+    for (auto encoding : {picklejar::IntegerEncoding::delta,
+                          picklejar::IntegerEncoding::frame_of_reference,
+                          picklejar::IntegerEncoding::run_length}) {
+      auto optional_buffer =
+          picklejar::write_encoded_integers_to_buffer(values, encoding);
+      // the element count is the first size_t of an unversioned buffer
+      for (const size_t corrupt_count : {size_t{1} << 61U, size_t{6}}) {
+        std::memcpy(optional_buffer.value().byte_data.data(), &corrupt_count,
+                    sizeof(size_t));
+        optional_buffer.value().set_counter(0);
+        std::vector<std::int64_t> result{};
+        expect(false == picklejar::read_encoded_integers_from_buffer(
+                            result, optional_buffer.value())
+                            .has_value())
+            << "encoding" << int(encoding) << "count" << corrupt_count;
+        expect(true == result.empty());
+      }
+    }
+
+    // a frame of a constant container has no bits, so it is written as runs
+    const std::vector<int> constant_values(1000, 42);
+    auto constant_plan = picklejar::make_integer_encoding_plan(
+        constant_values, picklejar::IntegerEncoding::frame_of_reference);
+    expect(picklejar::IntegerEncoding::run_length == constant_plan.encoding);
+    std::ofstream ofs_output_file("integer_encodings.data", std::ios::binary);
+    expect(true == picklejar::write_integer_encoding_plan(constant_plan,
+                                                         ofs_output_file));
+    ofs_output_file.close();
+    std::vector<int> constant_result{};
+    auto optional_constant_result = picklejar::read_encoded_integers_from_file(
+        constant_result, "integer_encodings.data");
+    expect(true == optional_constant_result.has_value());
+    expect(true == (constant_values == optional_constant_result.value()));
+  };
+
+  "integer_encodings_file_and_deep_copy_fields"_test = [] {
+    std::vector<std::uint32_t> sequence_ids(5000);
+    std::iota(sequence_ids.begin(), sequence_ids.end(), 4'000'000'000U);
+    std::vector<std::uint64_t> wide_values{0, ~std::uint64_t{0}, 1, 1ULL << 63};
+    std::ofstream ofs_output_file("integer_encodings.data", std::ios::binary);
+    expect(true == picklejar::write_encoded_integers_to_stream<1>(
+                       sequence_ids, ofs_output_file));
+    expect(true == picklejar::write_encoded_integers_to_stream<1>(
+                       wide_values, ofs_output_file,
+                       picklejar::IntegerEncoding::frame_of_reference));
+    ofs_output_file.close();
+    expect(std::filesystem::file_size("integer_encodings.data") <
+           sequence_ids.size() * sizeof(std::uint32_t) / 3);
+
+    std::ifstream ifs_input_file("integer_encodings.data", std::ios::binary);
+    std::vector<std::uint32_t> sequence_result{};
+    auto optional_sequence_result =
+        picklejar::read_encoded_integers_from_stream<1>(sequence_result,
+                                                        ifs_input_file);
+    expect(true == optional_sequence_result.has_value());
+    expect(true == (sequence_ids == optional_sequence_result.value()));
+    std::vector<std::uint64_t> wide_result{};
+    auto optional_wide_result = picklejar::read_encoded_integers_from_stream<1>(
+        wide_result, ifs_input_file);
+    expect(true == optional_wide_result.has_value());
+    expect(true == (wide_values == optional_wide_result.value()))
+        << "64 bit wide frames should round trip";
+    ifs_input_file.close();
+
+    // a deep copy element with a varint member and an encoded vector member
+    const std::vector<EncodedSeries> series_vec{
+        {-3, {10, 20, 30, 31, 32}}, {70000, {}}, {5, {-1, -1, -1}}};
+    auto optional_buffer = picklejar::deep_copy_vector_to_buffer<1>(
+        series_vec,
+        [](const EncodedSeries &series) {
+          return picklejar::sizeof_integer_field(series.series_id) +
+                 picklejar::make_integer_encoding_plan(series.timestamps)
+                     .byte_size();
+        },
+        [](picklejar::ByteVectorWithCounter &buffer,
+           const EncodedSeries &series, size_t /*element_size*/) {
+          return picklejar::write_integer_field(series.series_id, buffer) &&
+                 picklejar::write_integer_encoding_plan(
+                     picklejar::make_integer_encoding_plan(series.timestamps),
+                     buffer);
+        });
+    expect(true == optional_buffer.has_value());
+    expect(0 == optional_buffer.value().size_remaining());
+    optional_buffer.value().set_counter(0);
+    std::vector<EncodedSeries> result{};
+    auto optional_result = picklejar::deep_read_vector_from_buffer_view<1>(
+        result, optional_buffer.value(),
+        [](auto &_result, picklejar::ByteSpanWithCounter &element_bytes) {
+          EncodedSeries series{};
+          auto optional_id =
+              picklejar::read_integer_field_from_buffer<int>(element_bytes);
+          if (!optional_id) return false;
+          series.series_id = optional_id.value();
+          std::vector<std::int64_t> timestamps{};
+          auto optional_timestamps =
+              picklejar::read_encoded_integers_from_buffer(timestamps,
+                                                           element_bytes);
+          if (!optional_timestamps) return false;
+          series.timestamps = std::move(optional_timestamps.value());
+          _result.push_back(std::move(series));
+          return true;
+        });
+    expect(true == optional_result.has_value());
+    expect(3 == optional_result.value().size());
+    expect(-3 == optional_result.value().at(0).series_id);
+    expect(70000 == optional_result.value().at(1).series_id);
+    expect(true == (series_vec.at(0).timestamps ==
+                    optional_result.value().at(0).timestamps));
+    expect(true == (series_vec.at(2).timestamps ==
+                    optional_result.value().at(2).timestamps));
+  };
+}
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <cstring>
+#include <map>
+#include <picklejar.hpp>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace boost::ut;
+
+inline void picklejartests_map() {
+  "map_buffer_unordered_to_ordered_and_flat"_test = [] {
+    std::unordered_map<std::string, int> unordered_input{
+        {"banana", 2}, {"apple", 1}, {"cherry", 3}};
+    picklejar::ByteVectorWithCounter byte_vector_with_counter{
+        picklejar::sizeof_map<1>(unordered_input)};
+    expect(picklejar::sizeof_versioned<1>(unordered_input) ==
+           byte_vector_with_counter.size())
+        << "sizeof_map and sizeof_versioned should agree for string keys";
+    expect(true == picklejar::write_map_to_buffer<1>(unordered_input,
+                                                    byte_vector_with_counter));
+    expect(0 == byte_vector_with_counter.size_remaining());
+
+    byte_vector_with_counter.set_counter(0);
+    std::map<std::string, int> ordered_result{};
+    auto optional_ordered = picklejar::read_map_from_buffer<1>(
+        ordered_result, byte_vector_with_counter);
+    expect(true == optional_ordered.has_value());
+    expect(true == (std::map<std::string, int>{unordered_input.begin(),
+                                               unordered_input.end()} ==
+                    optional_ordered.value()));
+
+    // keys are written sorted, so a flat map comes out sorted
+    byte_vector_with_counter.set_counter(0);
+    std::vector<std::pair<std::string, int>> flat_result{};
+    auto optional_flat =
+        picklejar::read_map_from_buffer<1>(flat_result, byte_vector_with_counter);
+    expect(true == optional_flat.has_value());
+    expect(3 == optional_flat.value().size());
+    expect("apple" == optional_flat.value().at(0).first);
+    expect("cherry" == optional_flat.value().at(2).first);
+    expect(3 == optional_flat.value().at(2).second);
+
+    // reading into a flat map that already has elements replaces them
+    byte_vector_with_counter.set_counter(0);
+    std::vector<std::pair<std::string, int>> stale_flat_result{{"zebra", 26}};
+    auto optional_replaced = picklejar::read_map_from_buffer<1>(
+        stale_flat_result, byte_vector_with_counter);
+    expect(true == optional_replaced.has_value());
+    expect(3 == optional_replaced.value().size());
+    expect("apple" == optional_replaced.value().front().first);
+    expect(true == picklejar::write_map_to_file<1>(unordered_input, "map.data"));
+    stale_flat_result = {{"zebra", 26}};
+    auto optional_replaced_from_file =
+        picklejar::read_map_from_file<1>(stale_flat_result, "map.data");
+    expect(true == optional_replaced_from_file.has_value());
+    expect(3 == optional_replaced_from_file.value().size());
+    expect(true == std::is_sorted(optional_replaced_from_file.value().begin(),
+                                  optional_replaced_from_file.value().end()));
+
+    byte_vector_with_counter.set_counter(0);
+    std::map<std::string, int> wrong_version_result{};
+    expect(false == picklejar::read_map_from_buffer<2>(wrong_version_result,
+                                                       byte_vector_with_counter)
+                        .has_value());
+  };
+
+  "map_file_sets_and_empty"_test = [] {
+    const std::set<int> set_input{9, 1, 5};
+    expect(true == picklejar::write_map_to_file(set_input, "map.data"));
+    std::unordered_set<int> set_result{};
+    auto optional_set = picklejar::read_map_from_file(set_result, "map.data");
+    expect(true == optional_set.has_value());
+    expect(3 == optional_set.value().size());
+    expect(1 == optional_set.value().count(5));
+
+    const std::map<int, double> empty_input{};
+    expect(true == picklejar::write_map_to_file<3>(empty_input, "map.data"));
+    std::map<int, double> empty_result{};
+    expect(true == picklejar::read_map_from_file<3>(empty_result, "map.data")
+                       .has_value())
+        << "an empty map is a valid result";
+
+    std::map<int, double> missing_result{};
+    expect(false == picklejar::read_map_from_file(missing_result,
+                                                  "map.nonexistent_file")
+                        .has_value());
+  };
+
+  "size_of_fixed_width_and_string_keys"_test = [] {
+    static_assert(picklejar::size_of<int, 1>::fixed_width);
+    static_assert(picklejar::size_of<int, 1>::value ==
+                  2 * sizeof(size_t) + sizeof(int));
+    static_assert(picklejar::size_of<std::vector<int>>::element_width ==
+                  sizeof(size_t) + sizeof(int));
+
+    const std::vector<int> int_vec(100, 7);
+    expect(sizeof(size_t) + 100 * (sizeof(size_t) + sizeof(int)) ==
+           picklejar::sizeof_versioned(int_vec));
+    expect(100 * sizeof(int) == picklejar::sizeof_unversioned(int_vec));
+
+    std::map<int, double> fixed_map{};
+    for (int i{0}; i < 50; ++i) fixed_map[i] = i * 0.5;
+    const size_t fixed_map_size = picklejar::sizeof_versioned<1>(fixed_map);
+    expect(2 * sizeof(size_t) +
+               50 * (sizeof(size_t) + sizeof(int) + sizeof(double)) ==
+           fixed_map_size);
+    expect(fixed_map_size == picklejar::sizeof_map<1>(fixed_map));
+    picklejar::ByteVectorWithCounter byte_vector_with_counter{fixed_map_size};
+    expect(true == picklejar::write_map_to_buffer<1>(fixed_map,
+                                                    byte_vector_with_counter));
+    expect(0 == byte_vector_with_counter.size_remaining())
+        << "the O(1) size should match the bytes written";
+
+    const std::map<std::string, int> string_map{{"a", 1}, {"three", 3}};
+    expect(2 * sizeof(size_t) + 2 * (2 * sizeof(size_t) + sizeof(int)) + 6 ==
+           picklejar::sizeof_versioned<1>(string_map));
+  };
+
+  "corrupt_counts_and_sizes_fail_without_allocating"_test = [] {
+    // a plain vector file read as a deep copied one, the count is 2^61
+    const std::vector<size_t> plain_vec{size_t{1} << 61U, 5, 7};
+    expect(true == picklejar::write_vector_to_file(plain_vec, "map.data"));
+    std::vector<std::string> deep_result{};
+    expect(false == picklejar::deep_read_vector_from_file(
+                        deep_result, "map.data",
+                        [](std::vector<std::string> &,
+                           picklejar::ByteVectorWithCounter &element_bytes) {
+                          element_bytes.set_counter(element_bytes.size());
+                          return true;
+                        })
+                        .has_value());
+    // a corrupt count and an element size bigger than the file
+    const std::vector<size_t> corrupt_map_vec{size_t{1} << 61U,
+                                              size_t{1} << 40U, 7};
+    expect(true ==
+           picklejar::write_vector_to_file(corrupt_map_vec, "map.data"));
+    std::map<int, int> map_result{};
+    expect(false ==
+           picklejar::read_map_from_file(map_result, "map.data").has_value());
+  };
+}
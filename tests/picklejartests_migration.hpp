@@ -0,0 +1,145 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+struct MigrationV1 {
+  int id;
+};
+struct MigrationV2 {
+  int id;
+  double weight;
+};
+struct MigrationV3 {
+  int id;
+  double weight;
+  std::string name;
+};
+
+inline void picklejartests_migration() {
+  auto &&make_registry = [] {
+    return picklejar::make_migration_registry(
+        picklejar::migration_step<1>(
+            [](picklejar::ByteVectorWithCounter &byte_vector_with_counter)
+                -> std::optional<MigrationV1> {
+              auto optional_id = byte_vector_with_counter.read<int>();
+              if (!optional_id) return {};
+              return MigrationV1{optional_id.value()};
+            },
+            [](MigrationV1 &&old) {
+              return MigrationV2{old.id, 1.0};
+            }),
+        picklejar::migration_step<2>(
+            [](picklejar::ByteVectorWithCounter &byte_vector_with_counter)
+                -> std::optional<MigrationV2> {
+              auto optional_fields =
+                  picklejar::read_frame<int, double>(byte_vector_with_counter);
+              if (!optional_fields) return {};
+              return MigrationV2{std::get<0>(optional_fields.value()),
+                                 std::get<1>(optional_fields.value())};
+            },
+            [](MigrationV2 &&old) {
+              return MigrationV3{old.id, old.weight,
+                                 "id" + std::to_string(old.id)};
+            }),
+        picklejar::migration_step<3>(
+            [](picklejar::ByteVectorWithCounter &byte_vector_with_counter)
+                -> std::optional<MigrationV3> {
+              auto optional_fields =
+                  picklejar::read_frame<int, double>(byte_vector_with_counter);
+              if (!optional_fields) return {};
+              std::string name(byte_vector_with_counter.current_iterator(),
+                               std::end(byte_vector_with_counter));
+              byte_vector_with_counter.set_counter(
+                  byte_vector_with_counter.size());
+              return MigrationV3{std::get<0>(optional_fields.value()),
+                                 std::get<1>(optional_fields.value()), name};
+            }));
+  };
+
+  "migration_v1_to_latest"_test = [&] {
+    std::vector<MigrationV1> v1_vec{{1}, {2}, {3}};
+    expect(true == picklejar::deep_copy_vector_to_file<1>(
+                       v1_vec, "migration.data",
+                       [](const MigrationV1 &) { return sizeof(int); },
+                       [](auto &ofs_output_file, const MigrationV1 &object,
+                          size_t /*element_size*/) {
+                         return picklejar::write_object_to_stream(
+                             object.id, ofs_output_file);
+                       }));
+    auto registry = make_registry();
+    expect(3 == decltype(registry)::latest_version);
+    std::vector<MigrationV3> result{};
+    auto optional_result =
+        picklejar::deep_read_vector_with_migrations_from_file(
+            result, "migration.data", registry);
+    expect(true == optional_result.has_value()) << "v1 migration failed";
+    expect(3 == optional_result.value().size());
+    expect(2 == optional_result.value().at(1).id);
+    expect(1.0 == optional_result.value().at(1).weight);
+    expect("id2" == optional_result.value().at(1).name)
+        << "v1 elements should go through both upgrade lambdas";
+  };
+
+  "migration_v2_and_unknown_version"_test = [&] {
+    std::vector<MigrationV2> v2_vec{{7, 0.5}, {8, 1.5}};
+    expect(true == picklejar::deep_copy_vector_to_file<2>(
+                       v2_vec, "migration.data",
+                       [](const MigrationV2 &) {
+                         return sizeof(int) + sizeof(double);
+                       },
+                       [](auto &ofs_output_file, const MigrationV2 &object,
+                          size_t /*element_size*/) {
+                         return picklejar::write_object_to_stream(
+                                    object.id, ofs_output_file) &&
+                                picklejar::write_object_to_stream(
+                                    object.weight, ofs_output_file);
+                       }));
+    std::ifstream ifs_input_file("migration.data", std::ios::binary);
+    std::vector<char> file_bytes{std::istreambuf_iterator<char>(ifs_input_file),
+                                 std::istreambuf_iterator<char>()};
+    picklejar::ByteVectorWithCounter file_buffer{file_bytes.size()};
+    std::copy(file_bytes.begin(), file_bytes.end(),
+              file_buffer.byte_data.begin());
+    auto registry = make_registry();
+    std::vector<MigrationV3> result{};
+    auto optional_result =
+        picklejar::deep_read_vector_with_migrations_from_buffer(
+            result, file_buffer, registry);
+    expect(true == optional_result.has_value()) << "v2 migration failed";
+    expect(1.5 == optional_result.value().at(1).weight);
+    expect("id8" == optional_result.value().at(1).name);
+
+    std::vector<MigrationV1> v1_vec{{1}};
+    expect(true == picklejar::deep_copy_vector_to_file<5>(
+                       v1_vec, "migration.data",
+                       [](const MigrationV1 &) { return sizeof(int); },
+                       [](auto &ofs_output_file, const MigrationV1 &object,
+                          size_t /*element_size*/) {
+                         return picklejar::write_object_to_stream(
+                             object.id, ofs_output_file);
+                       }));
+    std::vector<MigrationV3> unknown_result{};
+    expect(false == picklejar::deep_read_vector_with_migrations_from_file(
+                        unknown_result, "migration.data", registry)
+                        .has_value())
+        << "an unregistered version should fail";
+  };
+}
@@ -0,0 +1,87 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <cstddef>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+struct ParallelRecord {
+  std::uint64_t id{0};
+  double value{0};
+  int constructed_marker{7};
+};
+
+inline void picklejartests_parallel() {
+#if defined(PICKLEJAR_HAS_POSIX_IO)
+  // a bit over 3 chunks of util::parallel_read_chunk_size
+  std::vector<ParallelRecord> records(700'001);
+  for (size_t i{0}; i < records.size(); ++i)
+    records[i] = {std::uint64_t(i), double(i) / 2, -1};
+
+  "parallel_read_trivially_copyable_file"_test = [&] {
+    expect(true == picklejar::write_vector_to_file(records, "parallel.data"));
+    for (const size_t thread_count : {1, 4, 0}) {
+      auto optional_result =
+          picklejar::read_vector_from_file_parallel<ParallelRecord>(
+              "parallel.data", thread_count);
+      expect(true == optional_result.has_value())
+          << "thread count:" << thread_count;
+      expect(records.size() == optional_result.value().size());
+      bool records_match{true};
+      for (size_t i{0}; i < records.size() && records_match; ++i) {
+        records_match = optional_result.value()[i].id == records[i].id &&
+                        optional_result.value()[i].value == records[i].value &&
+                        optional_result.value()[i].constructed_marker == -1;
+      }
+      expect(true == records_match) << "thread count:" << thread_count;
+    }
+    expect(false == picklejar::read_vector_from_file_parallel<ParallelRecord>(
+                        "parallel_missing.data")
+                        .has_value());
+  };
+
+  "parallel_read_with_manipulate_bytes_lambda"_test = [&] {
+    expect(true == picklejar::write_vector_to_file(records, "parallel.data"));
+    auto optional_result =
+        picklejar::read_vector_from_file_parallel<ParallelRecord>(
+            "parallel.data", 4,
+            [](ParallelRecord &instance,
+               std::array<char, sizeof(ParallelRecord)>
+                   &valid_bytes_blank_instance_copy,
+               std::array<char, sizeof(ParallelRecord)> &bytes_from_file) {
+              // everything from the file except the marker, which keeps the
+              // value of the default constructed instance
+              std::memcpy(&instance, bytes_from_file.data(),
+                          sizeof(ParallelRecord));
+              std::memcpy(&instance.constructed_marker,
+                          valid_bytes_blank_instance_copy.data() +
+                              offsetof(ParallelRecord, constructed_marker),
+                          sizeof(int));
+            });
+    expect(true == optional_result.has_value());
+    expect(records.size() == optional_result.value().size());
+    bool records_match{true};
+    for (size_t i{0}; i < records.size() && records_match; ++i) {
+      records_match = optional_result.value()[i].id == records[i].id &&
+                      optional_result.value()[i].constructed_marker == 7;
+    }
+    expect(true == records_match);
+  };
+#endif
+}
@@ -0,0 +1,141 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <cstring>
+#include <deque>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+inline void picklejartests_pipeline() {
+  std::vector<std::string> strings{};
+  for (size_t i{0}; i < 10'000; ++i)
+    strings.push_back(std::to_string(i) + std::string(i % 40, 'p'));
+  auto &&string_size_getter = [](const std::string &string_element) {
+    return picklejar::sizeof_unversioned(string_element);
+  };
+  auto &&string_writer = [](auto &sink, const std::string &string_element,
+                            size_t /*element_size*/) {
+    return picklejar::write_string(string_element, sink);
+  };
+  auto &&string_view_reader = [](std::vector<std::string> &_result,
+                                 picklejar::ByteSpanWithCounter &element_bytes) {
+    auto optional_string = picklejar::read_string(element_bytes);
+    if (!optional_string) return false;
+    _result.push_back(optional_string.value());
+    return true;
+  };
+
+  "pipelined_file_read_with_decode_workers"_test = [&] {
+    expect(true == picklejar::deep_copy_vector_to_file<1>(
+                       strings, "pipeline.data", string_size_getter,
+                       string_writer));
+    // tiny blocks and batches so elements straddle both and the rings fill up
+    for (const size_t decode_workers : {0, 1, 3}) {
+      std::vector<std::string> result{"already here"};
+      auto optional_result = picklejar::deep_read_vector_pipelined_from_file<1>(
+          result, "pipeline.data", string_view_reader,
+          picklejar::PipelineOptions{1000, 512, decode_workers, 2});
+      expect(true == optional_result.has_value())
+          << "decode workers:" << decode_workers;
+      expect(strings.size() + 1 == optional_result.value().size());
+      expect(true == std::equal(strings.begin(), strings.end(),
+                                optional_result.value().begin() + 1))
+          << "the output has to keep the file order";
+    }
+    std::vector<std::string> default_result{};
+    auto optional_default_result =
+        picklejar::deep_read_vector_pipelined_from_file<1>(
+            default_result, "pipeline.data", string_view_reader);
+    expect(true == optional_default_result.has_value());
+    expect(true == (strings == optional_default_result.value()));
+
+    std::vector<std::string> mismatch_result{};
+    expect(false == picklejar::deep_read_vector_pipelined_from_file<2>(
+                        mismatch_result, "pipeline.data", string_view_reader)
+                        .has_value());
+  };
+
+  "pipelined_source_read_with_copying_lambda"_test = [&] {
+    auto optional_buffer = picklejar::deep_copy_vector_to_buffer<0>(
+        strings, string_size_getter, string_writer);
+    expect(true == optional_buffer.has_value());
+    optional_buffer.value().set_counter(0);
+    std::deque<std::string> result{};
+    auto optional_result = picklejar::deep_read_vector_pipelined_from_source(
+        result, optional_buffer.value(),
+        [](std::deque<std::string> &_result,
+           picklejar::ByteVectorWithCounter &element_bytes) {
+          auto optional_string = picklejar::read_string(element_bytes);
+          if (!optional_string) return false;
+          _result.push_back(optional_string.value());
+          return true;
+        },
+        picklejar::PipelineOptions{4096, 4096, 2, 4});
+    expect(true == optional_result.has_value());
+    expect(true == std::equal(strings.begin(), strings.end(),
+                              optional_result.value().begin(),
+                              optional_result.value().end()));
+
+    // a failing lambda stops every stage
+    std::vector<std::string> failed_result{};
+    size_t calls{0};
+    expect(false == picklejar::deep_read_vector_pipelined_from_source(
+                        failed_result, optional_buffer.value(),
+                        [&](std::vector<std::string> &,
+                            picklejar::ByteSpanWithCounter &) {
+                          return ++calls < 100;
+                        })
+                        .has_value());
+  };
+
+  "pipelined_read_with_trailing_bytes_and_corrupt_count"_test = [&] {
+    const std::vector<std::string> few_strings(strings.begin(),
+                                               strings.begin() + 200);
+    auto optional_buffer = picklejar::deep_copy_vector_to_buffer<1>(
+        few_strings, string_size_getter, string_writer);
+    expect(true == optional_buffer.has_value());
+    auto &buffer = optional_buffer.value();
+    // the I/O stage has to stop once the framing stage is done
+    buffer.byte_data.resize(buffer.size() + 100'000, 'x');
+    for (const size_t decode_workers : {0, 2}) {
+      buffer.set_counter(0);
+      std::vector<std::string> result{};
+      auto optional_result = picklejar::deep_read_vector_pipelined_from_source<1>(
+          result, buffer, string_view_reader,
+          picklejar::PipelineOptions{64, 64, decode_workers, 2});
+      expect(true == optional_result.has_value())
+          << "decode workers:" << decode_workers;
+      expect(true == (few_strings == optional_result.value()));
+    }
+
+    const size_t corrupt_count{size_t{1} << 61U};
+    std::memcpy(buffer.byte_data.data() + sizeof(size_t), &corrupt_count,
+                sizeof(size_t));
+    buffer.byte_data.resize(buffer.size() - 100'000);
+    for (const size_t decode_workers : {0, 2}) {
+      buffer.set_counter(0);
+      std::vector<std::string> result{};
+      expect(false == picklejar::deep_read_vector_pipelined_from_source<1>(
+                          result, buffer, string_view_reader,
+                          picklejar::PipelineOptions{64, 64, decode_workers, 2})
+                          .has_value())
+          << "decode workers:" << decode_workers;
+    }
+  };
+}
@@ -0,0 +1,85 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <map>
+#include <memory_resource>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+inline void picklejartests_pmr() {
+  "pmr_map_from_buffer_uses_only_the_arena"_test = [] {
+    const std::map<std::string, int> map_input{
+        {"a key that is too long for the small string buffer", 1},
+        {"another key that is too long for the small string buffer", 2}};
+    picklejar::ByteVectorWithCounter byte_vector_with_counter{
+        picklejar::sizeof_map(map_input)};
+    expect(true ==
+           picklejar::write_map_to_buffer(map_input, byte_vector_with_counter));
+    byte_vector_with_counter.set_counter(0);
+
+    // the arena can't ask for more memory, any allocation from the default
+    // resource would have to come from somewhere else
+    std::array<std::byte, 4096> arena_storage{};
+    std::pmr::monotonic_buffer_resource arena{arena_storage.data(),
+                                              arena_storage.size(),
+                                              std::pmr::null_memory_resource()};
+    std::pmr::map<std::pmr::string, int> result{&arena};
+    auto optional_result =
+        picklejar::read_map_from_buffer(result, byte_vector_with_counter);
+    expect(true == optional_result.has_value());
+    expect(2 == optional_result.value().size());
+    const auto &first_key = optional_result.value().begin()->first;
+    expect(true == (first_key.get_allocator().resource() == &arena))
+        << "the keys should be built with the map's memory resource";
+    expect(true == (std::string_view{first_key} ==
+                    std::string_view{map_input.begin()->first}));
+  };
+
+  "pmr_vector_and_strings_from_arena"_test = [] {
+    const std::vector<int> int_vec{1, 2, 3, 4, 5};
+    expect(true == picklejar::write_vector_to_file(int_vec, "pmr.data"));
+    expect(5 * sizeof(int) == picklejar::arena_size_for_file("pmr.data"));
+    auto arena = picklejar::make_arena_for_file("pmr.data");
+    auto optional_vector =
+        picklejar::read_pmr_vector_from_file<int>("pmr.data", &arena);
+    expect(true == optional_vector.has_value());
+    expect(true == (optional_vector.value().get_allocator().resource() ==
+                    &arena));
+    expect(true == std::equal(int_vec.begin(), int_vec.end(),
+                              optional_vector.value().begin(),
+                              optional_vector.value().end()));
+
+    picklejar::ByteVectorWithCounter byte_vector_with_counter{
+        picklejar::sizeof_unversioned(std::string_view{"pooled string"})};
+    expect(true == picklejar::write_string("pooled string",
+                                           byte_vector_with_counter));
+    byte_vector_with_counter.set_counter(0);
+    auto optional_string =
+        picklejar::read_string(byte_vector_with_counter, &arena);
+    expect(true == optional_string.has_value());
+    expect("pooled string" == optional_string.value());
+    expect(true ==
+           (optional_string.value().get_allocator().resource() == &arena));
+
+    picklejar::StringPool string_pool{&arena};
+    expect(true == (string_pool.intern("interned") ==
+                    string_pool.intern(std::string{"interned"})));
+    expect(1 == string_pool.size());
+  };
+}
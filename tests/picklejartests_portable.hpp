@@ -0,0 +1,112 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <cstdint>
+#include <numeric>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+inline void picklejartests_portable() {
+  "byteswap_array_matches_scalar"_test = [] {
+    auto &&check_swap = []<class Type>(Type /*tag*/) {
+      // 37 elements so we go through the SIMD lanes and the scalar tail
+      std::vector<Type> values(37);
+      std::iota(std::begin(values), std::end(values), Type{1});
+      auto swapped = values;
+      picklejar::util::byteswap_array(swapped.data(), swapped.size());
+      for (size_t i{0}; i < values.size(); ++i) {
+        expect(picklejar::util::byteswap_scalar(values[i]) == swapped[i])
+            << "byteswap_array differs from byteswap_scalar at " << i
+            << " for sizeof " << sizeof(Type);
+      }
+      picklejar::util::byteswap_array(swapped.data(), swapped.size());
+      expect(true == (values == swapped)) << "swapping twice is not identity";
+    };
+    check_swap(std::uint16_t{});
+    check_swap(std::uint32_t{});
+    check_swap(std::uint64_t{});
+    expect(std::uint32_t{0x04030201} ==
+           picklejar::util::byteswap_scalar(std::uint32_t{0x01020304}));
+  };
+
+  "portable_vector_file"_test = [] {
+    std::vector<double> double_vec{0.5, 1.5, 2.5, 3.5};
+    expect(true == picklejar::write_vector_to_file_portable(double_vec,
+                                                             "portable.data"));
+    auto optional_read_vector =
+        picklejar::read_vector_from_file_portable<double>("portable.data");
+    expect(true == optional_read_vector.has_value());
+    expect(true == (optional_read_vector.value() == double_vec))
+        << "portable file roundtrip failed";
+  };
+
+  "portable_vector_buffer_and_size_header"_test = [] {
+    std::vector<std::int32_t> int_vec{-1, 2, -3, 4};
+    picklejar::ByteVectorWithCounter byte_vector_with_counter(
+        sizeof(picklejar::portable_size_type) +
+        int_vec.size() * sizeof(std::int32_t));
+    expect(true == picklejar::write_size_portable(int_vec.size(),
+                                                  byte_vector_with_counter));
+    expect(sizeof(std::uint64_t) == byte_vector_with_counter.byte_counter.value())
+        << "portable size headers should always be 8 bytes";
+    expect(true == picklejar::write_vector_to_buffer_portable(
+                       int_vec, byte_vector_with_counter));
+    // the first byte of the little endian encoding of -1 is 0xff
+    expect(char(0xff) == byte_vector_with_counter.byte_data.at(8));
+
+    byte_vector_with_counter.set_counter(0);
+    auto optional_size =
+        picklejar::read_size_portable(byte_vector_with_counter);
+    expect(int_vec.size() == optional_size.value());
+    std::vector<std::int32_t> read_vec{};
+    auto optional_read_vector =
+        picklejar::read_vector_from_buffer_portable<std::int32_t>(
+            read_vec, byte_vector_with_counter);
+    expect(true == optional_read_vector.has_value());
+    expect(true == (optional_read_vector.value() == int_vec));
+  };
+
+  "portable_deep_copy_file"_test = [] {
+    std::vector<std::int64_t> int_vec{10, 20, 30};
+    expect(true ==
+           picklejar::deep_copy_vector_to_file_portable<1>(
+               int_vec, "portable_deep.data",
+               [](const std::int64_t &) { return sizeof(std::int64_t); },
+               [](auto &ofs_output_file, const std::int64_t &object,
+                  size_t /*element_size*/) {
+                 return picklejar::write_object_to_stream_portable(
+                     object, ofs_output_file);
+               }));
+    std::vector<std::int64_t> result{};
+    auto optional_result = picklejar::deep_read_vector_from_file_portable<1>(
+        result, "portable_deep.data",
+        [](auto &_result,
+           picklejar::ByteVectorWithCounter &byte_vector_with_counter) {
+          auto optional_value =
+              picklejar::read_object_from_buffer_portable<std::int64_t>(
+                  byte_vector_with_counter);
+          if (!optional_value) return false;
+          _result.push_back(optional_value.value());
+          return true;
+        });
+    expect(true == optional_result.has_value());
+    expect(true == (optional_result.value() == int_vec))
+        << "portable deep copy roundtrip failed";
+  };
+}
@@ -0,0 +1,138 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <map>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+struct ProjectedRecord {
+  int id{};
+  std::string name{};
+  std::map<int, double> attributes{};
+  double score{};
+};
+
+inline void picklejartests_projection() {
+  // small elements are skipped with ignore(), the big map with a seek
+  std::vector<ProjectedRecord> record_vec{
+      {1, "first", {{1, 0.5}, {2, 1.5}}, 10.0},
+      {2, "", {}, 20.0},
+      {3, "third", {}, 30.0}};
+  for (int i{0}; i < 5000; ++i) {
+    record_vec.at(2).attributes.emplace(i, double(i) / 2);
+  }
+  auto &&record_size_getter = [](const ProjectedRecord &record) {
+    return sizeof(int) + picklejar::sizeof_unversioned(record.name) +
+           picklejar::sizeof_map(record.attributes) + sizeof(double);
+  };
+  auto &&record_writer = [](auto &buffer_or_stream,
+                            const ProjectedRecord &record,
+                            size_t /*element_size*/) {
+    if constexpr (std::same_as<std::remove_cvref_t<decltype(buffer_or_stream)>,
+                               std::ofstream>) {
+      return picklejar::write_object_to_stream(record.id, buffer_or_stream) &&
+             picklejar::write_string(record.name, buffer_or_stream) &&
+             picklejar::write_map(record.attributes, buffer_or_stream) &&
+             picklejar::write_object_to_stream(record.score,
+                                               buffer_or_stream);
+    } else {
+      return buffer_or_stream.write(record.id) &&
+             picklejar::write_string(record.name, buffer_or_stream) &&
+             picklejar::write_map(record.attributes, buffer_or_stream) &&
+             buffer_or_stream.write(record.score);
+    }
+  };
+  auto &&read_id = [](std::vector<int> &ids,
+                      picklejar::ByteSpanWithCounter &projected_bytes) {
+    if (projected_bytes.size() != sizeof(int)) return false;
+    auto optional_fields = picklejar::read_frame<int>(projected_bytes);
+    if (!optional_fields) return false;
+    ids.push_back(std::get<0>(optional_fields.value()));
+    return true;
+  };
+
+  "projection_from_file_reads_only_leading_fields"_test = [&] {
+    expect(true == picklejar::deep_copy_vector_to_file<2>(
+                       record_vec, "projection.data", record_size_getter,
+                       record_writer));
+    std::vector<int> ids{};
+    auto optional_ids = picklejar::deep_read_vector_projection_from_file<2>(
+        ids, "projection.data", picklejar::frame_size<int>(), read_id);
+    expect(true == optional_ids.has_value());
+    expect(true == (std::vector<int>{1, 2, 3} == optional_ids.value()));
+
+    // the stream is left right after the vector
+    std::ofstream ofs_output_file("projection.data", std::ios::binary);
+    picklejar::write_vector_deep_copy<2>(record_vec, ofs_output_file,
+                                         record_size_getter, record_writer);
+    expect(true == picklejar::write_object_to_stream(42, ofs_output_file));
+    ofs_output_file.close();
+    std::ifstream ifs_input_file("projection.data", std::ios::binary);
+    std::vector<int> stream_ids{};
+    expect(true == picklejar::deep_read_vector_projection_from_stream<2>(
+                       stream_ids, ifs_input_file, picklejar::frame_size<int>(),
+                       read_id)
+                       .has_value());
+    expect(42 == picklejar::read_object_from_stream<int>(ifs_input_file));
+  };
+
+  "projection_from_buffer_skips_nested_objects"_test = [&] {
+    auto optional_buffer = picklejar::deep_copy_vector_to_buffer<1>(
+        record_vec, record_size_getter, record_writer);
+    expect(true == optional_buffer.has_value());
+    optional_buffer.value().set_counter(0);
+    std::vector<int> ids{};
+    auto optional_ids = picklejar::deep_read_vector_projection_from_buffer<1>(
+        ids, optional_buffer.value(), picklejar::frame_size<int>(), read_id);
+    expect(true == optional_ids.has_value());
+    expect(3 == optional_ids.value().back());
+    expect(0 == optional_buffer.value().size_remaining());
+
+    // a trailing field after the nested string and map, reached by skipping
+    // them with their size headers
+    optional_buffer.value().set_counter(0);
+    std::vector<std::pair<std::string_view, double>> names_and_scores{};
+    auto optional_names_and_scores =
+        picklejar::deep_read_vector_projection_from_buffer<1>(
+            names_and_scores, optional_buffer.value(),
+            std::numeric_limits<size_t>::max(),
+            [](auto &_result,
+               picklejar::ByteSpanWithCounter &projected_bytes) {
+              if (!projected_bytes.advance_counter(sizeof(int))) return false;
+              auto optional_name = picklejar::read_sized_object_view(
+                  projected_bytes);
+              if (!optional_name ||
+                  !picklejar::skip_deep_copy_vector(projected_bytes))
+                return false;
+              auto optional_score =
+                  picklejar::read_object_from_buffer<double>(projected_bytes);
+              if (!optional_score) return false;
+              auto &&name_bytes = optional_name.value().byte_data;
+              _result.emplace_back(
+                  std::string_view{name_bytes.data(), name_bytes.size()},
+                  optional_score.value());
+              return true;
+            });
+    expect(true == optional_names_and_scores.has_value());
+    expect(3 == optional_names_and_scores.value().size());
+    expect("third" == optional_names_and_scores.value().at(2).first);
+    expect(30.0 == optional_names_and_scores.value().at(2).second);
+    expect(20.0 == optional_names_and_scores.value().at(1).second);
+  };
+}
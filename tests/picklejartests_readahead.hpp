@@ -0,0 +1,99 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <numeric>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+inline void picklejartests_readahead() {
+  std::vector<std::string> strings{};
+  for (size_t i{0}; i < 5'000; ++i)
+    strings.push_back(std::string(i % 300, char('a' + i % 26)));
+  auto &&string_size_getter = [](const std::string &string_element) {
+    return picklejar::sizeof_unversioned(string_element);
+  };
+  auto &&string_writer = [](auto &sink, const std::string &string_element,
+                            size_t /*element_size*/) {
+    return picklejar::write_string(string_element, sink);
+  };
+  auto &&string_view_reader = [](std::vector<std::string> &_result,
+                                 picklejar::ByteSpanWithCounter &element_bytes) {
+    auto optional_string = picklejar::read_string(element_bytes);
+    if (!optional_string) return false;
+    _result.push_back(optional_string.value());
+    return true;
+  };
+
+  "buffer_view_prefetch_distances"_test = [&] {
+    auto optional_buffer = picklejar::deep_copy_vector_to_buffer<1>(
+        strings, string_size_getter, string_writer);
+    expect(true == optional_buffer.has_value());
+    auto &buffer = optional_buffer.value();
+    buffer.set_counter(0);
+    // bigger than the number of elements too, the prefetcher stops at the end
+    for (const size_t prefetch_distance : {0, 1, 16, 10'000}) {
+      auto view = buffer.get_remaining_bytes_as_span_with_counter();
+      view.set_counter(0);
+      std::vector<std::string> result{};
+      auto optional_result = picklejar::deep_read_vector_from_buffer_view<1>(
+          result, view, string_view_reader,
+          picklejar::ReadaheadOptions{prefetch_distance, 0});
+      expect(true == optional_result.has_value())
+          << "prefetch distance:" << prefetch_distance;
+      expect(true == (strings == optional_result.value()));
+      expect(view.size() == view.byte_counter.value());
+    }
+  };
+
+#if defined(PICKLEJAR_HAS_POSIX_IO)
+  "mapped_file_and_fd_source_readahead"_test = [&] {
+    expect(true == picklejar::deep_copy_vector_to_file<1>(
+                       strings, "readahead.data", string_size_getter,
+                       string_writer));
+    // a window smaller than the file so it is advised more than once
+    std::vector<std::string> result{};
+    auto optional_result = picklejar::deep_read_vector_from_mapped_file<1>(
+        result, "readahead.data", string_view_reader,
+        picklejar::ReadaheadOptions{4, 64 << 10});
+    expect(true == optional_result.has_value());
+    expect(true == (strings == optional_result.value()));
+
+    std::vector<std::string> missing_result{};
+    expect(false == picklejar::deep_read_vector_from_mapped_file<1>(
+                        missing_result, "readahead_missing.data",
+                        string_view_reader)
+                        .has_value());
+
+    std::vector<std::uint32_t> numbers(1'000'000);
+    std::iota(numbers.begin(), numbers.end(), std::uint32_t{1});
+    expect(true == picklejar::write_vector_to_file(numbers, "readahead.data"));
+    picklejar::FdSource source{"readahead.data"};
+    source.set_readahead_window(size_t{4} << 20);
+    std::uint32_t number{0};
+    bool numbers_match{true};
+    for (size_t i{0}; i < numbers.size() && numbers_match; ++i) {
+      numbers_match = source.read(reinterpret_cast<char *>(&number),
+                                  sizeof(number)) &&
+                      number == numbers[i];
+    }
+    expect(true == numbers_match);
+    expect(0 == source.size_remaining());
+  };
+#endif
+}
@@ -0,0 +1,233 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <map>
+#include <numeric>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+// a sink/source of our own, it only needs the members in SINK SOURCE
+struct MemorySinkSource {
+  std::vector<char> bytes{};
+  size_t read_position{0};
+
+  auto write(const char *object_bytes, size_t size) -> bool {
+    bytes.insert(bytes.end(), object_bytes, object_bytes + size);
+    return true;
+  }
+  auto read(char *destination, size_t size) -> bool {
+    if (size > size_remaining()) return false;
+    std::memcpy(destination, bytes.data() + read_position, size);
+    read_position += size;
+    return true;
+  }
+  [[nodiscard]] auto position() const -> size_t {
+    return read_position > 0 ? read_position : bytes.size();
+  }
+  [[nodiscard]] auto size_remaining() const -> size_t {
+    return bytes.size() - read_position;
+  }
+};
+
+static_assert(picklejar::PickleJarSink<std::ofstream>);
+static_assert(picklejar::PickleJarSink<picklejar::CFileSink>);
+static_assert(picklejar::PickleJarSink<MemorySinkSource>);
+static_assert(picklejar::PickleJarSizedSource<picklejar::CFileSource>);
+static_assert(picklejar::PickleJarSizedSource<MemorySinkSource>);
+static_assert(
+    picklejar::PickleJarContiguousSource<picklejar::ByteSpanWithCounter>);
+static_assert(!picklejar::PickleJarContiguousSource<std::ifstream>);
+static_assert(!picklejar::PickleJarContiguousSource<picklejar::CFileSource>);
+
+inline void picklejartests_sinksource() {
+  const std::vector<std::string> string_vec{"pickle", "", "jar"};
+  auto &&string_size_getter = [](const std::string &string_element) {
+    return picklejar::sizeof_unversioned(string_element);
+  };
+  auto &&string_writer = [](auto &sink, const std::string &string_element,
+                            size_t /*element_size*/) {
+    return picklejar::write_string(string_element, sink);
+  };
+  auto &&string_reader = [](std::vector<std::string> &_result,
+                            picklejar::ByteVectorWithCounter &element_bytes) {
+    auto optional_string = picklejar::read_string(element_bytes);
+    if (!optional_string) return false;
+    _result.push_back(optional_string.value());
+    return true;
+  };
+
+  "cfile_sink_and_source"_test = [&] {
+    const std::vector<int> int_vec{1, 2, 3, 4, 5};
+    {
+      picklejar::CFileSink sink{"sinksource.data", 1 << 20};
+      expect(true == sink.good());
+      expect(true == picklejar::deep_copy_vector_to_sink<1>(
+                         string_vec, sink, string_size_getter, string_writer));
+      expect(true == picklejar::write_string("tail", sink));
+      expect(true == picklejar::write_vector_to_sink(int_vec, sink));
+      expect(true == sink.close());
+    }
+    picklejar::CFileSource source{"sinksource.data", 1 << 20};
+    std::vector<std::string> string_result{};
+    auto optional_string_result = picklejar::deep_read_vector_from_source<1>(
+        string_result, source, string_reader);
+    expect(true == optional_string_result.has_value());
+    expect(true == (string_vec == optional_string_result.value()));
+    expect("tail" == picklejar::read_string(source).value());
+    std::vector<int> int_result{};
+    auto optional_int_result =
+        picklejar::read_vector_from_source<int>(int_result, source);
+    expect(true == optional_int_result.has_value());
+    expect(true == (int_vec == optional_int_result.value()));
+    expect(0 == source.size_remaining());
+    expect(false == picklejar::read_string(source).has_value())
+        << "reading past the end should fail";
+
+    // a corrupt string size fails before the string is allocated
+    const std::vector<size_t> corrupt_size{size_t{1} << 60U, 0};
+    expect(true ==
+           picklejar::write_vector_to_file(corrupt_size, "sinksource.data"));
+    picklejar::CFileSource corrupt_source{"sinksource.data", 1 << 20};
+    expect(false == picklejar::read_string(corrupt_source).has_value());
+    std::ifstream ifs_input_file("sinksource.data", std::ios::binary);
+    std::pmr::monotonic_buffer_resource arena{};
+    expect(false == picklejar::read_string(ifs_input_file, &arena).has_value());
+  };
+
+  "custom_sink_source_and_existing_formats"_test = [&] {
+    MemorySinkSource sink_source{};
+    const std::map<int, std::string> id_names{{2, "two"}, {1, "one"}};
+    expect(true == picklejar::write_map<1>(id_names, sink_source));
+    expect(true == picklejar::deep_copy_vector_to_sink(
+                       string_vec, sink_source, string_size_getter,
+                       string_writer));
+    // the bytes are the same as the ones written to a buffer
+    picklejar::ByteVectorWithCounter map_buffer{
+        picklejar::sizeof_map<1>(id_names)};
+    expect(true == picklejar::write_map_to_buffer<1>(id_names, map_buffer));
+    expect(true == std::equal(map_buffer.byte_data.begin(),
+                              map_buffer.byte_data.end(),
+                              sink_source.bytes.begin()));
+
+    picklejar::ByteVectorWithCounter read_buffer{sink_source.bytes.begin(),
+                                                 sink_source.bytes.end()};
+    std::map<int, std::string> map_result{};
+    auto optional_map_result =
+        picklejar::read_map_from_buffer<1>(map_result, read_buffer);
+    expect(true == optional_map_result.has_value());
+    expect("two" == optional_map_result.value().at(2));
+
+    sink_source.read_position = read_buffer.byte_counter.value();
+    std::vector<std::string> string_result{};
+    auto optional_string_result = picklejar::deep_read_vector_from_source(
+        string_result, sink_source, string_reader);
+    expect(true == optional_string_result.has_value());
+    expect(true == (string_vec == optional_string_result.value()));
+  };
+
+#if defined(PICKLEJAR_HAS_POSIX_IO)
+  "fd_sink_and_disjoint_range_sources"_test = [&] {
+    // bigger than the 1 MiB buffer so both the buffered and the direct
+    // pread/pwrite paths are used
+    std::vector<std::uint64_t> big_vec(300'000);
+    std::iota(big_vec.begin(), big_vec.end(), std::uint64_t{7});
+    {
+      picklejar::FdSink sink{"sinksource_fd.data"};
+      expect(true == picklejar::deep_copy_vector_to_sink<1>(
+                         string_vec, sink, string_size_getter, string_writer));
+      expect(true == picklejar::write_vector_to_sink(big_vec, sink));
+      expect(true == sink.close());
+    }
+    picklejar::FdSource source{"sinksource_fd.data"};
+    std::vector<std::string> string_result{};
+    auto optional_string_result = picklejar::deep_read_vector_from_source<1>(
+        string_result, source, string_reader);
+    expect(true == optional_string_result.has_value());
+    expect(true == (string_vec == optional_string_result.value()));
+    const size_t strings_size = source.position();
+    std::vector<std::uint64_t> big_result{};
+    auto optional_big_result =
+        picklejar::read_vector_from_source<std::uint64_t>(big_result, source);
+    expect(true == optional_big_result.has_value());
+    expect(true == (big_vec == optional_big_result.value()));
+
+    // two sources over disjoint halves of the vector share one descriptor,
+    // reading them interleaved works because each one has its own offset
+    const int fd = ::open("sinksource_fd.data", O_RDONLY);
+    expect(fd >= 0);
+    const size_t half_size = big_vec.size() / 2 * sizeof(std::uint64_t);
+    picklejar::FdSource first_half{fd, 0, off_t(strings_size), half_size};
+    picklejar::FdSource second_half{fd, 0, off_t(strings_size + half_size)};
+    std::uint64_t first_value{0};
+    std::uint64_t second_value{0};
+    for (size_t i{0}; i < big_vec.size() / 2; ++i) {
+      if (!first_half.read(reinterpret_cast<char *>(&first_value),
+                           sizeof(first_value)) ||
+          !second_half.read(reinterpret_cast<char *>(&second_value),
+                            sizeof(second_value)) ||
+          first_value != big_vec[i] ||
+          second_value != big_vec[i + big_vec.size() / 2]) {
+        expect(false) << "range reads failed at" << i;
+        break;
+      }
+    }
+    expect(0 == first_half.size_remaining());
+    expect(0 == second_half.size_remaining());
+    ::close(fd);
+  };
+
+  "direct_io_vector_and_deep_file"_test = [&] {
+    // not a multiple of the 64 KiB chunks, so the last direct read is short
+    std::vector<std::uint64_t> big_vec(100'003);
+    std::iota(big_vec.begin(), big_vec.end(), std::uint64_t{3});
+    expect(true ==
+           picklejar::write_vector_to_file(big_vec, "sinksource_direct.data"));
+    for (const bool use_direct_io : {true, false}) {
+      const picklejar::DirectReadOptions options{size_t{64} << 10,
+                                                 use_direct_io};
+      std::vector<std::uint64_t> big_result{};
+      auto optional_big_result =
+          picklejar::read_vector_from_file_direct<std::uint64_t>(
+              big_result, "sinksource_direct.data", options);
+      expect(true == optional_big_result.has_value())
+          << "direct read failed, use_direct_io:" << use_direct_io;
+      expect(true == (big_vec == optional_big_result.value()));
+    }
+    picklejar::DirectFileSource fallback_source{"sinksource_direct.data",
+                                                {4096, false}};
+    expect(false == fallback_source.used_direct_io());
+    expect(big_vec.size() * sizeof(std::uint64_t) ==
+           fallback_source.size_remaining());
+
+    std::vector<std::string> many_strings{};
+    for (size_t i{0}; i < 2'000; ++i)
+      many_strings.push_back(std::string(i % 37, char('a' + i % 26)));
+    expect(true == picklejar::deep_copy_vector_to_file<1>(
+                       many_strings, "sinksource_direct.data",
+                       string_size_getter, string_writer));
+    // one block per chunk, so elements straddle chunk boundaries
+    std::vector<std::string> string_result{};
+    auto optional_string_result =
+        picklejar::deep_read_vector_from_file_direct<1>(
+            string_result, "sinksource_direct.data", string_reader, {1});
+    expect(true == optional_string_result.has_value());
+    expect(true == (many_strings == optional_string_result.value()));
+  };
+#endif
+}
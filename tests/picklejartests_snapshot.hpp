@@ -0,0 +1,103 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <atomic>
+#include <thread>
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+inline void picklejartests_snapshot() {
+#if defined(PICKLEJAR_HAS_POSIX_IO)
+  std::vector<std::string> strings{};
+  for (size_t i{0}; i < 3'000; ++i)
+    strings.push_back(std::to_string(i) + std::string(i % 20, 's'));
+  auto &&string_size_getter = [](const std::string &string_element) {
+    return picklejar::sizeof_unversioned(string_element);
+  };
+  auto &&string_writer = [](auto &sink, const std::string &string_element,
+                            size_t /*element_size*/) {
+    return picklejar::write_string(string_element, sink);
+  };
+  auto &&string_view_reader = [](std::vector<std::string> &_result,
+                                 picklejar::ByteSpanWithCounter &element_bytes) {
+    auto optional_string = picklejar::read_string(element_bytes);
+    if (!optional_string) return false;
+    _result.push_back(optional_string.value());
+    return true;
+  };
+
+  "snapshot_shared_by_reader_threads"_test = [&] {
+    expect(true == picklejar::deep_copy_vector_to_file<1>(
+                       strings, "snapshot.data", string_size_getter,
+                       string_writer));
+    std::optional<picklejar::Snapshot> optional_snapshot{};
+    {
+      auto optional_original = picklejar::make_snapshot_from_file<1>(
+          "snapshot.data");
+      expect(true == optional_original.has_value());
+      // the copy shares the mapping and keeps it alive
+      optional_snapshot = optional_original;
+    }
+    const picklejar::Snapshot &snapshot = optional_snapshot.value();
+    expect(strings.size() == snapshot.size());
+
+    std::atomic<size_t> mismatches{0};
+    std::vector<std::thread> readers{};
+    for (size_t reader{0}; reader < 8; ++reader) {
+      readers.emplace_back([&, reader] {
+        auto cursor = snapshot.cursor();
+        std::vector<std::string> result{};
+        auto optional_result = picklejar::deep_read_vector_from_snapshot(
+            result, cursor, strings.size(), string_view_reader);
+        if (!optional_result || optional_result.value() != strings)
+          ++mismatches;
+        // random access from the same cursor, in a different order per thread
+        for (size_t i{reader}; i < strings.size(); i += 97) {
+          auto optional_element = cursor.element(strings.size() - 1 - i);
+          auto optional_string =
+              optional_element ? picklejar::read_string(optional_element.value())
+                               : std::optional<std::string>{};
+          if (!optional_string ||
+              optional_string.value() != strings[strings.size() - 1 - i])
+            ++mismatches;
+        }
+      });
+    }
+    for (auto &reader : readers) reader.join();
+    expect(0 == mismatches.load());
+
+    auto cursor = snapshot.cursor(strings.size() - 2);
+    expect(true == cursor.next().has_value());
+    expect(true == cursor.next().has_value());
+    expect(false == cursor.next().has_value()) << "past the last element";
+    expect(false == snapshot.element(strings.size()).has_value());
+  };
+
+  "snapshot_rejects_bad_files"_test = [&] {
+    expect(true == picklejar::deep_copy_vector_to_file<1>(
+                       strings, "snapshot.data", string_size_getter,
+                       string_writer));
+    expect(false ==
+           picklejar::make_snapshot_from_file<2>("snapshot.data").has_value());
+    expect(false == picklejar::make_snapshot_from_file<1>(
+                        "snapshot_missing.data")
+                        .has_value());
+  };
+#endif
+}
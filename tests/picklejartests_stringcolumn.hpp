@@ -0,0 +1,141 @@
+#include <boost/ut.hpp>
+/*
+
+  Copyright 2021 Pedro Tomas Guillen
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+*/
+#include <picklejar.hpp>
+
+using namespace boost::ut;
+
+inline void picklejartests_stringcolumn() {
+  "varint_round_trip"_test = [] {
+    std::array<char, picklejar::util::max_varint_size> varint_bytes{};
+    for (std::uint64_t value :
+         {std::uint64_t{0}, std::uint64_t{127}, std::uint64_t{128},
+          std::uint64_t{300}, std::numeric_limits<std::uint64_t>::max()}) {
+      const size_t encoded_size =
+          picklejar::util::encode_varint(value, varint_bytes.data());
+      expect(picklejar::util::varint_size(value) == encoded_size);
+      const char *current = varint_bytes.data();
+      auto optional_value = picklejar::util::decode_varint(
+          current, varint_bytes.data() + encoded_size);
+      expect(true == optional_value.has_value());
+      expect(value == optional_value.value());
+      expect(true == (current == varint_bytes.data() + encoded_size));
+    }
+    const char *truncated = varint_bytes.data();
+    expect(false == picklejar::util::decode_varint(truncated,
+                                                   varint_bytes.data() + 1)
+                        .has_value())
+        << "a truncated varint should fail";
+  };
+
+  "string_column_buffer_shares_dictionary"_test = [] {
+    std::vector<std::string> status_column{};
+    for (size_t i{0}; i < 1000; ++i) {
+      status_column.emplace_back(i % 3 == 0   ? "FILLED"
+                                 : i % 3 == 1 ? "CANCELLED"
+                                              : "PARTIALLY_FILLED");
+    }
+    auto optional_buffer =
+        picklejar::write_string_column_to_buffer<2>(status_column);
+    expect(true == optional_buffer.has_value());
+    expect(0 == optional_buffer.value().size_remaining())
+        << "the plan should size the buffer exactly";
+    expect(optional_buffer.value().size() < 1000 + 128)
+        << "each element should take a single byte";
+
+    optional_buffer.value().set_counter(0);
+    std::vector<std::string_view> result{};
+    auto optional_result = picklejar::read_string_column_from_buffer<2>(
+        result, optional_buffer.value());
+    expect(true == optional_result.has_value());
+    expect(1000 == optional_result.value().size());
+    expect(true == std::equal(status_column.begin(), status_column.end(),
+                              optional_result.value().begin()));
+    expect(true == (optional_result.value().at(0).data() ==
+                    optional_result.value().at(3).data()))
+        << "equal elements should share the dictionary characters";
+    expect(0 == optional_buffer.value().size_remaining());
+  };
+
+  "string_column_file_with_pool"_test = [] {
+    const std::vector<std::string_view> symbol_column{"AAPL", "MSFT", "AAPL",
+                                                      "", "MSFT"};
+    expect(true == picklejar::write_string_column_to_file(symbol_column,
+                                                          "stringcolumn.data"));
+    picklejar::StringPool string_pool{};
+    std::vector<std::string_view> result{};
+    auto optional_result = picklejar::read_string_column_from_file(
+        result, "stringcolumn.data", string_pool);
+    expect(true == optional_result.has_value());
+    expect(true == (symbol_column == optional_result.value()));
+    expect(3 == string_pool.size());
+
+    std::vector<std::string_view> second_result{};
+    auto optional_second_result = picklejar::read_string_column_from_file(
+        second_result, "stringcolumn.data", string_pool);
+    expect(true == optional_second_result.has_value());
+    expect(3 == string_pool.size())
+        << "reading the same file again shouldn't grow the pool";
+    expect(true == (optional_second_result.value().at(1).data() ==
+                    optional_result.value().at(1).data()));
+  };
+
+  "string_column_file_rejects_forged_sizes"_test = [] {
+    const std::vector<std::string_view> symbol_column{"AAPL", "MSFT", "AAPL",
+                                                      "", "MSFT"};
+    expect(true == picklejar::write_string_column_to_file(symbol_column,
+                                                          "stringcolumn.data"));
+    std::ifstream ifs_input_file("stringcolumn.data", std::ios::binary);
+    const std::vector<char> file_bytes{
+        std::istreambuf_iterator<char>(ifs_input_file),
+        std::istreambuf_iterator<char>()};
+    ifs_input_file.close();
+    auto &&read_forged = [&](size_t offset, size_t forged_size,
+                             size_t file_size) {
+      std::vector<char> forged_bytes(file_bytes.begin(),
+                                     file_bytes.begin() + long(file_size));
+      if (offset + sizeof(size_t) <= file_size)
+        std::memcpy(forged_bytes.data() + offset, &forged_size,
+                    sizeof(size_t));
+      std::ofstream ofs_output_file("stringcolumn.data", std::ios::binary);
+      ofs_output_file.write(forged_bytes.data(), long(forged_bytes.size()));
+      ofs_output_file.close();
+      picklejar::StringPool string_pool{};
+      std::vector<std::string_view> result{};
+      return picklejar::read_string_column_from_file(
+                 result, "stringcolumn.data", string_pool)
+          .has_value();
+    };
+    // [dictionary size][size][bytes]...[element count][indices size][indices]
+    const size_t indices_size_offset =
+        file_bytes.size() - symbol_column.size() - sizeof(size_t);
+    expect(false == read_forged(0, size_t{1} << 61U, file_bytes.size()))
+        << "dictionary size";
+    expect(false == read_forged(sizeof(size_t), size_t{1} << 61U,
+                                file_bytes.size()))
+        << "dictionary string size";
+    expect(false == read_forged(indices_size_offset, size_t{1} << 61U,
+                                file_bytes.size()))
+        << "indices size";
+    expect(false == read_forged(file_bytes.size(), 0, file_bytes.size() - 3))
+        << "truncated file";
+    expect(true == read_forged(indices_size_offset, symbol_column.size(),
+                               file_bytes.size()))
+        << "the untouched file should still read";
+  };
+}